@@ -0,0 +1,766 @@
+/*
+ * ezcb_bench.c - Micro-benchmarks for ezcb.h
+ *
+ * Built once per configuration flavor by bench/Makefile. Each run prints
+ * one record per measurement, as CSV (default) or JSON Lines (--json):
+ *
+ *   flavor,bench,triggers,callbacks,name_len,collide_pct,ops,ns_per_op
+ *
+ * Options:
+ *   --json        Emit JSON Lines instead of CSV
+ *   --no-header   Omit the CSV header line
+ *   --quick       Shorter measurement windows (for smoke runs)
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#define EZCB_IMPLEMENTATION
+#include "ezcb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_FLAVOR
+    #define BENCH_FLAVOR "default"
+#endif
+
+#define BENCH_MAX_TRIGGERS      4096
+#define BENCH_MAX_NAME          64
+
+/* Names whose low hash bits match land in the same bucket at any table size up to this */
+#define BENCH_COLLIDE_MASK      1023u
+
+/****************************************************************
+ * Harness
+ ****************************************************************/
+
+static bool bench_json = false;
+static double bench_min_ns = 20e6;
+
+static volatile uintptr_t bench_sink;
+
+static char bench_names[BENCH_MAX_TRIGGERS][BENCH_MAX_NAME];
+
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void bench_report(
+    const char* bench,
+    size_t triggers,
+    size_t callbacks,
+    size_t name_len,
+    unsigned collide_pct,
+    size_t ops,
+    double ns
+)
+{
+    double per_op = ops ? ns / (double) ops : 0.0;
+
+    if (bench_json)
+    {
+        printf("{\"flavor\":\"%s\",\"bench\":\"%s\",\"triggers\":%zu,\"callbacks\":%zu,"
+               "\"name_len\":%zu,\"collide_pct\":%u,\"ops\":%zu,\"ns_per_op\":%.2f}\n",
+               BENCH_FLAVOR, bench, triggers, callbacks, name_len, collide_pct, ops, per_op);
+    }
+    else
+    {
+        printf("%s,%s,%zu,%zu,%zu,%u,%zu,%.2f\n",
+               BENCH_FLAVOR, bench, triggers, callbacks, name_len, collide_pct, ops, per_op);
+    }
+}
+
+static ezcb_result_t bench_cb(void* ctx, void* data)
+{
+    bench_sink += (uintptr_t) ctx + (uintptr_t) data;
+    return EZCB_CONTINUE;
+}
+
+/*
+ * Fill bench_names[0..count) with distinct names of exactly name_len
+ * characters. collide_pct percent of them are chosen so that their hashes
+ * agree in the low bits, which puts them in one bucket.
+ */
+static void bench_make_names(
+    size_t count,
+    size_t name_len,
+    unsigned collide_pct
+)
+{
+    size_t colliding = count * collide_pct / 100;
+    unsigned long serial = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char* name = bench_names[i];
+
+        for (;;)
+        {
+            char digits[24];
+            int n = snprintf(digits, sizeof(digits), "%lu", serial++);
+
+            memset(name, 'n', name_len);
+            memcpy(name + name_len - (size_t) n, digits, (size_t) n);
+            name[name_len] = '\0';
+
+            if (i >= colliding) break;
+            if ((ezcb_hash(name) & BENCH_COLLIDE_MASK) == 0) break;
+        }
+    }
+}
+
+static void bench_setup(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    ezcb_init();
+
+    for (size_t t = 0; t < triggers; t++)
+    {
+        for (size_t c = 0; c < callbacks; c++)
+        {
+            if (ezcb_register(bench_names[t], (uint8_t) c, bench_cb, (void*)(uintptr_t) c) != 0)
+            {
+                fprintf(stderr, "ezcb_bench: registration failed (%zu triggers, %zu callbacks)\n",
+                        triggers, callbacks);
+                exit(1);
+            }
+        }
+    }
+}
+
+/****************************************************************
+ * Benchmarks
+ ****************************************************************/
+
+/* ezcb_trigger() ns/op, cycling through every trigger name */
+static void bench_trigger(
+    size_t triggers,
+    size_t callbacks,
+    size_t name_len,
+    unsigned collide_pct
+)
+{
+    bench_make_names(triggers, name_len, collide_pct);
+    bench_setup(triggers, callbacks);
+
+    size_t ops = 0;
+    size_t rounds = 1024;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t r = 0; r < rounds; r++)
+        {
+            ezcb_trigger(bench_names[r % triggers], NULL);
+        }
+        ops += rounds;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report("trigger", triggers, callbacks, name_len, collide_pct, ops, elapsed);
+    ezcb_deinit();
+}
+
+/* EZCB_TRIGGER_LIT() ns/op: one 16-character literal among `triggers` names */
+static void bench_trigger_lit(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, callbacks);
+
+    for (size_t c = 0; c < callbacks; c++)
+    {
+        (void) ezcb_register("bench.literal.16", (uint8_t) c, bench_cb, (void*)(uintptr_t) c);
+    }
+
+    size_t ops = 0;
+    size_t rounds = 1024;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t r = 0; r < rounds; r++)
+        {
+            EZCB_TRIGGER_LIT("bench.literal.16", NULL);
+        }
+        ops += rounds;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report("trigger_lit", triggers + 1, callbacks, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+
+/* ezcb_trigger_h() ns/op on pre-resolved handles */
+static void bench_trigger_h(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    static ezcb_handle_t handles[BENCH_MAX_TRIGGERS];
+
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, callbacks);
+
+    for (size_t t = 0; t < triggers; t++)
+    {
+        handles[t] = ezcb_resolve(bench_names[t]);
+    }
+
+    size_t ops = 0;
+    size_t rounds = 1024;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t r = 0; r < rounds; r++)
+        {
+            ezcb_trigger_h(handles[r % triggers], NULL);
+        }
+        ops += rounds;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report("trigger_h", triggers, callbacks, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+
+/* ezcb_register() ns/op from an empty dispatcher, including table growth */
+static void bench_register(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    bench_make_names(triggers, 16, 0);
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        double start = bench_now_ns();
+        bench_setup(triggers, callbacks);
+        elapsed += bench_now_ns() - start;
+        ops += triggers * callbacks;
+
+        ezcb_deinit();
+    }
+
+    bench_report("register", triggers, callbacks, 16, 0, ops, elapsed);
+}
+
+/* ezcb_unregister() ns/op for exact (trigger, fn, ctx) matches */
+static void bench_unregister(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    bench_make_names(triggers, 16, 0);
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        bench_setup(triggers, callbacks);
+
+        double start = bench_now_ns();
+        for (size_t t = 0; t < triggers; t++)
+        {
+            for (size_t c = 0; c < callbacks; c++)
+            {
+                ezcb_unregister(bench_names[t], bench_cb, (void*)(uintptr_t) c);
+            }
+        }
+        elapsed += bench_now_ns() - start;
+        ops += triggers * callbacks;
+
+        ezcb_deinit();
+    }
+
+    bench_report("unregister", triggers, callbacks, 16, 0, ops, elapsed);
+}
+
+/* ezcb_unregister(NULL, NULL, ctx) ns/op, one owner object per callback */
+static void bench_unregister_ctx(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    static char owners[BENCH_MAX_TRIGGERS * 16];
+
+    bench_make_names(triggers, 16, 0);
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        ezcb_init();
+
+        for (size_t t = 0; t < triggers; t++)
+        {
+            for (size_t c = 0; c < callbacks; c++)
+            {
+                (void) ezcb_register(bench_names[t], (uint8_t) c, bench_cb, &owners[t * callbacks + c]);
+            }
+        }
+
+        double start = bench_now_ns();
+        for (size_t i = 0; i < triggers * callbacks; i++)
+        {
+            ezcb_unregister(NULL, NULL, &owners[i]);
+        }
+        elapsed += bench_now_ns() - start;
+        ops += triggers * callbacks;
+
+        ezcb_deinit();
+    }
+
+    bench_report("unregister_ctx", triggers, callbacks, 16, 0, ops, elapsed);
+}
+
+/* ezcb_register_many() and ezcb_unregister_many() ns per callback, same records as bench_setup() */
+static void bench_many(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    static ezcb_reg_t regs[BENCH_MAX_TRIGGERS * 16];
+
+    bench_make_names(triggers, 16, 0);
+
+    size_t n = 0;
+    for (size_t t = 0; t < triggers; t++)
+    {
+        for (size_t c = 0; c < callbacks; c++)
+        {
+            regs[n].trigger = bench_names[t];
+            regs[n].fn = bench_cb;
+            regs[n].ctx = (void*)(uintptr_t) c;
+            regs[n].priority = (uint8_t) c;
+            n++;
+        }
+    }
+
+    size_t ops = 0;
+    double reg_ns = 0;
+    double unreg_ns = 0;
+
+    while (reg_ns < bench_min_ns)
+    {
+        double start = bench_now_ns();
+        ezcb_init();
+        if (ezcb_register_many(regs, n) != 0)
+        {
+            fprintf(stderr, "ezcb_bench: bulk registration failed (%zu callbacks)\n", n);
+            exit(1);
+        }
+        double mid = bench_now_ns();
+        ezcb_unregister_many(regs, n);
+        unreg_ns += bench_now_ns() - mid;
+        reg_ns += mid - start;
+        ops += n;
+
+        ezcb_deinit();
+    }
+
+    bench_report("register_many", triggers, callbacks, 16, 0, ops, reg_ns);
+    bench_report("unregister_many", triggers, callbacks, 16, 0, ops, unreg_ns);
+}
+
+/* ezcb_restore() ns per callback, from a snapshot of the records bench_setup() makes */
+static void bench_restore(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    static uint8_t blob[BENCH_MAX_TRIGGERS * (16 + 16 * 8 + 17) + 64];
+    ezcb_symbol_t symbols[16];
+
+    for (size_t c = 0; c < callbacks; c++)
+    {
+        symbols[c].fn = bench_cb;
+        symbols[c].ctx = (void*)(uintptr_t) c;
+    }
+
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, callbacks);
+    size_t size = ezcb_snapshot(blob, sizeof(blob), symbols, callbacks);
+    ezcb_deinit();
+
+    if (size == 0 || size > sizeof(blob))
+    {
+        fprintf(stderr, "ezcb_bench: snapshot failed (%zu callbacks)\n", triggers * callbacks);
+        exit(1);
+    }
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        double start = bench_now_ns();
+        ezcb_init();
+        if (ezcb_restore(blob, size, symbols, callbacks) != 0)
+        {
+            fprintf(stderr, "ezcb_bench: restore failed (%zu callbacks)\n", triggers * callbacks);
+            exit(1);
+        }
+        elapsed += bench_now_ns() - start;
+        ops += triggers * callbacks;
+
+        ezcb_deinit();
+    }
+
+    bench_report("restore", triggers, callbacks, 16, 0, ops, elapsed);
+}
+
+#ifndef EZCB_NO_MALLOC
+/* Slowest single ezcb_register() while growing to `triggers` entries; ns, averaged over rounds */
+static void bench_register_worst(
+    size_t triggers
+)
+{
+    bench_make_names(triggers, 16, 0);
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        double worst = 0;
+        ezcb_init();
+
+        for (size_t t = 0; t < triggers; t++)
+        {
+            double start = bench_now_ns();
+            int r = ezcb_register(bench_names[t], 0, bench_cb, NULL);
+            double ns = bench_now_ns() - start;
+
+            if (r != 0)
+            {
+                fprintf(stderr, "ezcb_bench: registration failed (%zu triggers)\n", triggers);
+                exit(1);
+            }
+            if (ns > worst) worst = ns;
+        }
+
+        ezcb_deinit();
+        elapsed += worst;
+        ops++;
+
+        /* Rounds are cheap to time but not to run; stop after a few */
+        if (ops >= 64) break;
+    }
+
+    bench_report("register_worst", triggers, 1, 16, 0, ops, elapsed);
+}
+
+/* One ezcb_resize() of a table holding `triggers` entries; ns per resize */
+static void bench_resize(
+    size_t triggers
+)
+{
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, 1);
+
+    size_t ops = 0;
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t i = 0; i < EZCB_SHARDS; i++)
+        {
+            ezcb_shard_t* s = &ezcb_default.shards[i];
+
+            ezcb_lock(s);
+            size_t buckets = EZCB_LOAD(s->buckets);
+
+            double start = bench_now_ns();
+            int r = ezcb_resize(s, buckets * 2);
+            elapsed += bench_now_ns() - start;
+
+            if (r == 0) (void) ezcb_resize(s, buckets);
+#ifdef EZCB_REHASH
+            /* Untimed: the moves belong to the registrations that follow a resize */
+            ezcb_rehash_step(s, SIZE_MAX);
+#endif
+            ezcb_unlock(s);
+            ops++;
+        }
+
+        /* Lets lock-free builds free the retired tables */
+        ezcb_synchronize();
+    }
+
+    bench_report("resize", triggers, 1, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+#endif  /* EZCB_NO_MALLOC */
+
+#ifdef EZCB_ENABLE_ISR
+/* Queue throughput: ezcb_trigger_isr() + ezcb_dispatch(), ns per event */
+static void bench_dispatch(
+    size_t triggers,
+    size_t callbacks,
+    bool batch
+)
+{
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, callbacks);
+
+    size_t ops = 0;
+    size_t next = 0;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        size_t queued = 0;
+        while (ezcb_trigger_isr(bench_names[next % triggers], NULL) == 0)
+        {
+            next++;
+            queued++;
+        }
+
+        if (batch)
+        {
+            while (ezcb_dispatch_batch(EZCB_EVENT_QUEUE_SIZE) > 0) {}
+        }
+        else
+        {
+            ezcb_dispatch();
+        }
+
+        ops += queued;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report(batch ? "dispatch_batch" : "dispatch", triggers, callbacks, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+
+/* Payload ring throughput: ezcb_trigger_isr_copy() of 16 bytes + ezcb_dispatch(), ns per event */
+static void bench_dispatch_copy(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    static ezcb_handle_t handles[BENCH_MAX_TRIGGERS];
+    uint32_t payload[4] = { 0 };
+
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, callbacks);
+
+    for (size_t t = 0; t < triggers; t++)
+    {
+        handles[t] = ezcb_resolve(bench_names[t]);
+    }
+
+    size_t ops = 0;
+    size_t next = 0;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        size_t queued = 0;
+        while (ezcb_trigger_isr_copy(handles[next % triggers], payload, sizeof payload) == 0)
+        {
+            payload[0] = (uint32_t) next++;
+            queued++;
+        }
+
+        ezcb_dispatch();
+
+        ops += queued;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report("dispatch_copy", triggers, callbacks, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+#endif  /* EZCB_ENABLE_ISR */
+
+#ifdef EZCB_ENABLE_PATTERNS
+/* ezcb_trigger() ns/op on names that only "*" pattern callbacks match */
+static void bench_pattern(
+    size_t triggers,
+    size_t callbacks
+)
+{
+    bench_make_names(triggers, 16, 0);
+    ezcb_init();
+
+    for (size_t c = 0; c < callbacks; c++)
+    {
+        if (ezcb_register_pattern("*", (uint8_t) c, bench_cb, (void*)(uintptr_t) c) != 0)
+        {
+            fprintf(stderr, "ezcb_bench: pattern registration failed (%zu callbacks)\n", callbacks);
+            exit(1);
+        }
+    }
+
+    size_t ops = 0;
+    size_t rounds = 1024;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t r = 0; r < rounds; r++)
+        {
+            ezcb_trigger(bench_names[r % triggers], NULL);
+        }
+        ops += rounds;
+        elapsed = bench_now_ns() - start;
+    }
+
+    bench_report("pattern", triggers, callbacks, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+#endif  /* EZCB_ENABLE_PATTERNS */
+
+#ifdef EZCB_ENABLE_EXECUTOR
+/* ezcb_post() from this thread until the executor has run it all; ns per event */
+static void bench_post(
+    size_t triggers,
+    size_t workers
+)
+{
+    bench_make_names(triggers, 16, 0);
+    bench_setup(triggers, 1);
+
+    if (ezcb_executor_start(workers) != 0)
+    {
+        fprintf(stderr, "ezcb_bench: executor failed to start (%zu workers)\n", workers);
+        exit(1);
+    }
+
+    size_t ops = 0;
+    size_t rounds = 1024;
+    double start = bench_now_ns();
+    double elapsed = 0;
+
+    while (elapsed < bench_min_ns)
+    {
+        for (size_t r = 0; r < rounds; r++)
+        {
+            while (ezcb_post(bench_names[r % triggers], NULL) != 0) {}
+        }
+        ezcb_executor_wait();
+
+        ops += rounds;
+        elapsed = bench_now_ns() - start;
+    }
+
+    /* The callbacks column carries the worker count */
+    bench_report("post", triggers, workers, 16, 0, ops, elapsed);
+    ezcb_deinit();
+}
+#endif  /* EZCB_ENABLE_EXECUTOR */
+
+/****************************************************************
+ * Main
+ ****************************************************************/
+
+int main(int argc, char** argv)
+{
+    bool header = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0) bench_json = true;
+        else if (strcmp(argv[i], "--no-header") == 0) header = false;
+        else if (strcmp(argv[i], "--quick") == 0) bench_min_ns = 1e6;
+        else
+        {
+            fprintf(stderr, "usage: %s [--json] [--no-header] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (header && !bench_json)
+    {
+        printf("flavor,bench,triggers,callbacks,name_len,collide_pct,ops,ns_per_op\n");
+    }
+
+    static const size_t trigger_counts[] = { 1, 16, 256 };
+    static const size_t callback_counts[] = { 1, 4, 16 };
+    static const size_t name_lens[] = { 4, 16, 48 };
+    static const unsigned collide_pcts[] = { 0, 25, 100 };
+
+    #define BENCH_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+    for (size_t t = 0; t < BENCH_COUNT(trigger_counts); t++)
+    {
+        for (size_t c = 0; c < BENCH_COUNT(callback_counts); c++)
+        {
+            bench_trigger(trigger_counts[t], callback_counts[c], 16, 0);
+        }
+    }
+
+    for (size_t l = 0; l < BENCH_COUNT(name_lens); l++)
+    {
+        bench_trigger(16, 1, name_lens[l], 0);
+    }
+
+    for (size_t p = 0; p < BENCH_COUNT(collide_pcts); p++)
+    {
+        bench_trigger(256, 1, 16, collide_pcts[p]);
+    }
+
+    for (size_t t = 0; t < BENCH_COUNT(trigger_counts); t++)
+    {
+        bench_trigger_lit(trigger_counts[t], 4);
+        bench_trigger_h(trigger_counts[t], 4);
+        bench_register(trigger_counts[t], 4);
+        bench_unregister(trigger_counts[t], 4);
+        bench_unregister_ctx(trigger_counts[t], 4);
+        bench_many(trigger_counts[t], 4);
+        bench_restore(trigger_counts[t], 4);
+    }
+
+#ifndef EZCB_NO_MALLOC
+    bench_resize(16);
+    bench_resize(256);
+    bench_register_worst(256);
+    bench_register_worst(4096);
+#endif
+
+#ifdef EZCB_ENABLE_ISR
+    for (size_t t = 0; t < BENCH_COUNT(trigger_counts); t++)
+    {
+        bench_dispatch(trigger_counts[t], 1, false);
+        bench_dispatch(trigger_counts[t], 1, true);
+        bench_dispatch_copy(trigger_counts[t], 1);
+    }
+#endif
+
+#ifdef EZCB_ENABLE_PATTERNS
+    for (size_t t = 0; t < BENCH_COUNT(trigger_counts); t++)
+    {
+        bench_pattern(trigger_counts[t], 4);
+    }
+#endif
+
+#ifdef EZCB_ENABLE_EXECUTOR
+    bench_post(16, 1);
+    bench_post(16, 4);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,525 @@
+/*
+ * ezcb_stress.c - Contention stress test for the thread-safe modes of ezcb.h
+ *
+ * Built once per locking flavor by bench/Makefile (`make stress`, and
+ * `make stress-tsan` for ThreadSanitizer builds). For each producer count
+ * from 1, doubling up to --threads, it runs two measurements:
+ *
+ *   trigger      producers call ezcb_trigger()
+ *   trigger_isr  producers call ezcb_trigger_isr(); one thread dispatches
+ *
+ * while --churn threads register one-shot callbacks on the same triggers
+ * and unregister them again. Each measurement prints one record, as CSV
+ * (default) or JSON Lines (--json):
+ *
+ *   flavor,bench,producers,churn,ops,ops_per_sec,churn_per_sec,drops,p50_ns,p99_ns,p999_ns,max_ns
+ *
+ * ops counts producer calls and the percentiles are the time one call
+ * took, the clock reads included; drops counts ezcb_trigger_isr() calls
+ * that found the queue full. Afterwards every callback run is checked
+ * against the calls that reached the dispatcher, and every one-shot must
+ * have either run or been unregistered, exactly once. A mismatch exits
+ * with status 1.
+ *
+ * Options:
+ *   --json         Emit JSON Lines instead of CSV
+ *   --no-header    Omit the CSV header line
+ *   --quick        Shorter measurements (for smoke and sanitizer runs)
+ *   --threads N    Largest producer count (default: online CPUs, at least 2)
+ *   --churn M      Churn threads (default 1)
+ *   --ms T         Milliseconds per measurement (default 200)
+ *
+ * Threads are POSIX threads so ThreadSanitizer sees them being created.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#define EZCB_IMPLEMENTATION
+#include "ezcb.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef BENCH_FLAVOR
+    #define BENCH_FLAVOR "default"
+#endif
+
+#ifndef EZCB_THREAD_SAFE
+    #error "ezcb_stress.c needs EZCB_THREAD_SAFE"
+#endif
+
+#define STRESS_TRIGGERS         64
+#define STRESS_CALLBACKS        4       /* Persistent callbacks per trigger */
+#define STRESS_MAX_THREADS      256
+
+/* Latency histogram: 2^STRESS_SUB_BITS buckets per power of two of nanoseconds */
+#define STRESS_SUB_BITS         3
+#define STRESS_BUCKETS          ((33 - STRESS_SUB_BITS) << STRESS_SUB_BITS)
+
+/****************************************************************
+ * Harness
+ ****************************************************************/
+
+static bool stress_json = false;
+static unsigned stress_ms = 200;
+
+static char stress_names[STRESS_TRIGGERS][16];
+
+static atomic_bool stress_stop;
+
+/* Callback runs, counted per thread and summed when each thread exits */
+static _Thread_local uint64_t stress_local_calls;
+static atomic_uint_least64_t stress_calls;
+
+typedef struct stress_hist
+{
+    uint64_t count;
+    uint32_t max;
+    uint64_t buckets[STRESS_BUCKETS];
+} stress_hist_t;
+
+typedef struct stress_producer
+{
+    pthread_t thread;
+    bool isr;
+    uint32_t seed;
+    uint64_t ops;
+    uint64_t drops;
+    stress_hist_t hist;
+} stress_producer_t;
+
+typedef struct stress_churn
+{
+    pthread_t thread;
+    uint32_t seed;
+    uint64_t registered;
+    uint64_t removed;
+    atomic_uint_least64_t fired;    /* Bumped by whichever thread runs the one-shot */
+} stress_churn_t;
+
+static stress_producer_t stress_producers[STRESS_MAX_THREADS];
+static stress_churn_t stress_churns[STRESS_MAX_THREADS];
+
+static uint64_t stress_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t stress_rand(
+    uint32_t* state
+)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static size_t stress_bucket(
+    uint32_t v
+)
+{
+    if (v < (1u << STRESS_SUB_BITS)) return v;
+
+    unsigned top = 0;
+    while (v >> top >> 1) top++;
+
+    unsigned shift = top - STRESS_SUB_BITS;
+    return ((size_t)(shift + 1) << STRESS_SUB_BITS) | ((v >> shift) & ((1u << STRESS_SUB_BITS) - 1));
+}
+
+/* Highest value counted by a bucket */
+static uint32_t stress_bucket_high(
+    size_t bucket
+)
+{
+    if (bucket + 1 >= STRESS_BUCKETS) return UINT32_MAX;
+
+    size_t next = bucket + 1;
+    if (next < (1u << STRESS_SUB_BITS)) return (uint32_t) bucket;
+
+    unsigned top = (unsigned)(next >> STRESS_SUB_BITS) + STRESS_SUB_BITS - 1;
+    uint32_t sub = (uint32_t)(next & ((1u << STRESS_SUB_BITS) - 1));
+    return ((1u << top) | (sub << (top - STRESS_SUB_BITS))) - 1;
+}
+
+static void stress_hist_add(
+    stress_hist_t* h,
+    uint64_t ns
+)
+{
+    uint32_t v = ns > UINT32_MAX ? UINT32_MAX : (uint32_t) ns;
+
+    h->count++;
+    h->buckets[stress_bucket(v)]++;
+    if (v > h->max) h->max = v;
+}
+
+static void stress_hist_merge(
+    stress_hist_t* into,
+    const stress_hist_t* h
+)
+{
+    into->count += h->count;
+    if (h->max > into->max) into->max = h->max;
+    for (size_t b = 0; b < STRESS_BUCKETS; b++)
+    {
+        into->buckets[b] += h->buckets[b];
+    }
+}
+
+static uint32_t stress_hist_percentile(
+    const stress_hist_t* h,
+    double q
+)
+{
+    uint64_t rank = (uint64_t)(q * (double) h->count);
+    uint64_t seen = 0;
+
+    if (rank < 1) rank = 1;
+
+    for (size_t b = 0; b < STRESS_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen < rank) continue;
+
+        uint32_t high = stress_bucket_high(b);
+        return high < h->max ? high : h->max;
+    }
+    return h->max;
+}
+
+static void stress_report(
+    const char* bench,
+    size_t producers,
+    size_t churn,
+    uint64_t ops,
+    uint64_t churn_ops,
+    uint64_t drops,
+    uint64_t ns,
+    const stress_hist_t* h
+)
+{
+    double secs = (double) ns / 1e9;
+    double rate = secs > 0 ? (double) ops / secs : 0.0;
+    double churn_rate = secs > 0 ? (double) churn_ops / secs : 0.0;
+    uint32_t p50 = stress_hist_percentile(h, 0.50);
+    uint32_t p99 = stress_hist_percentile(h, 0.99);
+    uint32_t p999 = stress_hist_percentile(h, 0.999);
+
+    if (stress_json)
+    {
+        printf("{\"flavor\":\"%s\",\"bench\":\"%s\",\"producers\":%zu,\"churn\":%zu,\"ops\":%llu,"
+               "\"ops_per_sec\":%.0f,\"churn_per_sec\":%.0f,\"drops\":%llu,\"p50_ns\":%u,"
+               "\"p99_ns\":%u,\"p999_ns\":%u,\"max_ns\":%u}\n",
+               BENCH_FLAVOR, bench, producers, churn, (unsigned long long) ops, rate, churn_rate,
+               (unsigned long long) drops, p50, p99, p999, h->max);
+    }
+    else
+    {
+        printf("%s,%s,%zu,%zu,%llu,%.0f,%.0f,%llu,%u,%u,%u,%u\n",
+               BENCH_FLAVOR, bench, producers, churn, (unsigned long long) ops, rate, churn_rate,
+               (unsigned long long) drops, p50, p99, p999, h->max);
+    }
+    fflush(stdout);
+}
+
+static void stress_flush_calls(void)
+{
+    atomic_fetch_add_explicit(&stress_calls, stress_local_calls, memory_order_relaxed);
+    stress_local_calls = 0;
+}
+
+static ezcb_result_t stress_cb(void* ctx, void* data)
+{
+    (void) ctx;
+    (void) data;
+    stress_local_calls++;
+    return EZCB_CONTINUE;
+}
+
+static ezcb_result_t stress_once_cb(void* ctx, void* data)
+{
+    (void) data;
+    stress_churn_t* c = ctx;
+    atomic_fetch_add_explicit(&c->fired, 1, memory_order_relaxed);
+    return EZCB_CONTINUE;
+}
+
+/****************************************************************
+ * Threads
+ ****************************************************************/
+
+static void* stress_producer_main(void* arg)
+{
+    stress_producer_t* p = arg;
+
+    while (!atomic_load_explicit(&stress_stop, memory_order_relaxed))
+    {
+        const char* name = stress_names[stress_rand(&p->seed) % STRESS_TRIGGERS];
+        uint64_t start = stress_now_ns();
+
+#ifdef EZCB_ENABLE_ISR
+        if (p->isr)
+        {
+            /* A full queue gives the dispatcher a turn */
+            if (ezcb_trigger_isr(name, NULL) != 0)
+            {
+                p->drops++;
+                sched_yield();
+            }
+        }
+        else
+#endif
+        {
+            ezcb_trigger(name, NULL);
+        }
+
+        stress_hist_add(&p->hist, stress_now_ns() - start);
+        p->ops++;
+    }
+
+    stress_flush_calls();
+    return NULL;
+}
+
+/* Register a one-shot on a random trigger, then take it back unless it already ran */
+static void* stress_churn_main(void* arg)
+{
+    stress_churn_t* c = arg;
+
+    while (!atomic_load_explicit(&stress_stop, memory_order_relaxed))
+    {
+        const char* name = stress_names[stress_rand(&c->seed) % STRESS_TRIGGERS];
+
+        if (ezcb_register_once(name, STRESS_CALLBACKS, stress_once_cb, c) != 0)
+        {
+            fprintf(stderr, "ezcb_stress: ezcb_register_once() failed\n");
+            exit(1);
+        }
+        c->registered++;
+
+        sched_yield();
+
+        c->removed += (uint64_t) ezcb_unregister(name, stress_once_cb, c);
+    }
+    return NULL;
+}
+
+#ifdef EZCB_ENABLE_ISR
+static void* stress_dispatch_main(void* arg)
+{
+    (void) arg;
+
+    while (!atomic_load_explicit(&stress_stop, memory_order_relaxed))
+    {
+        ezcb_dispatch();
+        sched_yield();
+    }
+
+    stress_flush_calls();
+    return NULL;
+}
+#endif
+
+static void stress_start(
+    pthread_t* t,
+    void* (*fn)(void*),
+    void* arg
+)
+{
+    if (pthread_create(t, NULL, fn, arg) != 0)
+    {
+        fprintf(stderr, "ezcb_stress: pthread_create() failed\n");
+        exit(1);
+    }
+}
+
+/****************************************************************
+ * Measurements
+ ****************************************************************/
+
+static void stress_run(
+    bool isr,
+    size_t producers,
+    size_t churn
+)
+{
+    static stress_hist_t hist;
+#ifdef EZCB_ENABLE_ISR
+    pthread_t dispatcher;
+#endif
+
+    memset(&hist, 0, sizeof(hist));
+    atomic_store(&stress_calls, 0);
+    atomic_store(&stress_stop, false);
+
+    uint64_t start = stress_now_ns();
+
+    for (size_t i = 0; i < churn; i++)
+    {
+        stress_churn_t* c = &stress_churns[i];
+        c->seed = 0x9e3779b9u * (uint32_t)(i + 1) | 1;
+        c->registered = 0;
+        c->removed = 0;
+        atomic_store(&c->fired, 0);
+        stress_start(&c->thread, stress_churn_main, c);
+    }
+
+#ifdef EZCB_ENABLE_ISR
+    if (isr) stress_start(&dispatcher, stress_dispatch_main, NULL);
+#endif
+
+    for (size_t i = 0; i < producers; i++)
+    {
+        stress_producer_t* p = &stress_producers[i];
+        memset(p, 0, sizeof(*p));
+        p->isr = isr;
+        p->seed = 0x85ebca6bu * (uint32_t)(i + 1) | 1;
+        stress_start(&p->thread, stress_producer_main, p);
+    }
+
+    struct timespec pause = { (time_t)(stress_ms / 1000), (long)(stress_ms % 1000) * 1000000L };
+    nanosleep(&pause, NULL);
+    atomic_store(&stress_stop, true);
+
+    uint64_t ops = 0;
+    uint64_t drops = 0;
+    uint64_t churn_ops = 0;
+
+    for (size_t i = 0; i < producers; i++)
+    {
+        stress_producer_t* p = &stress_producers[i];
+        pthread_join(p->thread, NULL);
+        ops += p->ops;
+        drops += p->drops;
+        stress_hist_merge(&hist, &p->hist);
+    }
+
+    for (size_t i = 0; i < churn; i++)
+    {
+        pthread_join(stress_churns[i].thread, NULL);
+    }
+
+    uint64_t elapsed = stress_now_ns() - start;
+
+#ifdef EZCB_ENABLE_ISR
+    if (isr)
+    {
+        pthread_join(dispatcher, NULL);
+
+        /* Run what is still queued */
+        ezcb_dispatch();
+        stress_flush_calls();
+    }
+#endif
+
+    bool ok = true;
+    uint64_t expected = (ops - drops) * STRESS_CALLBACKS;
+    uint64_t calls = atomic_load(&stress_calls);
+
+    if (calls != expected)
+    {
+        fprintf(stderr, "ezcb_stress: %s: %llu callback runs, expected %llu\n", BENCH_FLAVOR,
+                (unsigned long long) calls, (unsigned long long) expected);
+        ok = false;
+    }
+
+    for (size_t i = 0; i < churn; i++)
+    {
+        stress_churn_t* c = &stress_churns[i];
+        uint64_t fired = atomic_load(&c->fired);
+
+        churn_ops += c->registered;
+        if (fired + c->removed != c->registered)
+        {
+            fprintf(stderr, "ezcb_stress: %s: %llu one-shots registered, %llu ran, %llu unregistered\n",
+                    BENCH_FLAVOR, (unsigned long long) c->registered, (unsigned long long) fired,
+                    (unsigned long long) c->removed);
+            ok = false;
+        }
+    }
+
+    stress_report(isr ? "trigger_isr" : "trigger", producers, churn, ops, churn_ops, drops, elapsed, &hist);
+
+    if (!ok) exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bool header = true;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = cpus > 2 ? (size_t) cpus : 2;
+    size_t churn = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0) stress_json = true;
+        else if (strcmp(argv[i], "--no-header") == 0) header = false;
+        else if (strcmp(argv[i], "--quick") == 0) stress_ms = 20;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = (size_t) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--churn") == 0 && i + 1 < argc) churn = (size_t) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) stress_ms = (unsigned) atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--json] [--no-header] [--quick] [--threads N] [--churn M] [--ms T]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (threads < 1 || threads > STRESS_MAX_THREADS || churn > STRESS_MAX_THREADS)
+    {
+        fprintf(stderr, "ezcb_stress: --threads must be 1 to %d and --churn at most %d\n",
+                STRESS_MAX_THREADS, STRESS_MAX_THREADS);
+        return 2;
+    }
+
+    if (header && !stress_json)
+    {
+        printf("flavor,bench,producers,churn,ops,ops_per_sec,churn_per_sec,drops,p50_ns,p99_ns,p999_ns,max_ns\n");
+    }
+
+    for (size_t t = 0; t < STRESS_TRIGGERS; t++)
+    {
+        snprintf(stress_names[t], sizeof(stress_names[t]), "stress.%zu", t);
+    }
+
+    ezcb_init();
+
+    for (size_t t = 0; t < STRESS_TRIGGERS; t++)
+    {
+        for (size_t c = 0; c < STRESS_CALLBACKS; c++)
+        {
+            if (ezcb_register(stress_names[t], (uint8_t) c, stress_cb, (void*)(uintptr_t)(c + 1)) != 0)
+            {
+                fprintf(stderr, "ezcb_stress: registration failed\n");
+                return 1;
+            }
+        }
+    }
+
+    for (size_t n = 1;; n *= 2)
+    {
+        if (n > threads) n = threads;
+
+        stress_run(false, n, churn);
+#ifdef EZCB_ENABLE_ISR
+        stress_run(true, n, churn);
+#endif
+
+        if (n == threads) break;
+    }
+
+    ezcb_deinit();
+    return 0;
+}
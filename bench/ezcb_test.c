@@ -0,0 +1,869 @@
+/*
+ * ezcb_test.c - Regression tests for ezcb.h
+ *
+ * Built once per configuration flavor by bench/Makefile (`make test`).
+ * Each test prints one line, "flavor,test,ok" or "flavor,test,FAIL", and
+ * every failed check is reported on stderr with its line. The program
+ * exits with status 1 if any check failed.
+ *
+ * Tests that need a feature are only compiled into the flavors that have
+ * it. They may look at the implementation's internals, such as a shard's
+ * pool, where the public API cannot tell a regression apart.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef EZCB_NO_MALLOC
+/* Every allocation of the dispatcher, counted */
+static atomic_long test_allocs;     /* Calls to malloc or realloc of NULL */
+static atomic_long test_blocks;     /* Blocks currently allocated */
+
+static void* test_malloc(
+    size_t n
+)
+{
+    void* p = malloc(n);
+    if (p)
+    {
+        atomic_fetch_add(&test_allocs, 1);
+        atomic_fetch_add(&test_blocks, 1);
+    }
+    return p;
+}
+
+static void* test_realloc(
+    void* p,
+    size_t n
+)
+{
+    if (!p) return test_malloc(n);
+    return realloc(p, n);
+}
+
+static void test_free(
+    void* p
+)
+{
+    if (p) atomic_fetch_sub(&test_blocks, 1);
+    free(p);
+}
+
+#define EZCB_MALLOC(n)          test_malloc(n)
+#define EZCB_REALLOC(p, n)      test_realloc((p), (n))
+#define EZCB_FREE(p)            test_free(p)
+#endif  /* EZCB_NO_MALLOC */
+
+#define EZCB_IMPLEMENTATION
+#include "ezcb.h"
+
+#ifdef EZCB_THREAD_SAFE
+    #include <pthread.h>
+#endif
+
+#ifndef BENCH_FLAVOR
+    #define BENCH_FLAVOR "default"
+#endif
+
+/****************************************************************
+ * Harness
+ ****************************************************************/
+
+static unsigned test_failed;        /* Failed checks of the running test */
+static unsigned test_failures;      /* Failed tests */
+
+#define TEST_CHECK(cond)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "ezcb_test: %s: line %d: %s\n", BENCH_FLAVOR, __LINE__, #cond); \
+            test_failed++;                                                          \
+        }                                                                           \
+    } while (0)
+
+static void test_run(
+    const char* name,
+    void (*fn)(void)
+)
+{
+    test_failed = 0;
+
+#ifndef EZCB_NO_MALLOC
+    long blocks = atomic_load(&test_blocks);
+#endif
+    fn();
+    ezcb_deinit();
+#ifndef EZCB_NO_MALLOC
+    TEST_CHECK(atomic_load(&test_blocks) == blocks);    /* Deinit frees everything */
+#endif
+
+    printf("%s,%s,%s\n", BENCH_FLAVOR, name, test_failed ? "FAIL" : "ok");
+    if (test_failed) test_failures++;
+}
+
+static ezcb_result_t test_count(
+    void* ctx,
+    void* data
+)
+{
+    (void) data;
+    (*(unsigned*) ctx)++;
+    return EZCB_CONTINUE;
+}
+
+#ifdef EZCB_STATIC_HANDLERS
+static unsigned test_static_calls;
+
+EZCB_STATIC_HANDLER("test.static", 0, test_count, &test_static_calls);
+
+#define TEST_STATIC_ENTRIES     1   /* Names of the static handlers above */
+#endif
+
+/* Trigger entries of the default instance, over all shards, but those of static handlers */
+static size_t test_entries(void)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        count += ezcb_default.shards[i].count;
+    }
+#ifdef EZCB_STATIC_HANDLERS
+    if (ezcb_default.ready) count -= TEST_STATIC_ENTRIES;
+#endif
+    return count;
+}
+
+/****************************************************************
+ * Tests
+ ****************************************************************/
+
+static void test_basic(void)
+{
+    unsigned a = 0;
+    unsigned b = 0;
+
+    TEST_CHECK(ezcb_register("test.basic", 1, test_count, &a) == 0);
+    TEST_CHECK(ezcb_register_once("test.basic", 0, test_count, &b) == 0);
+
+    ezcb_trigger("test.basic", NULL);
+    ezcb_trigger("test.basic", NULL);
+    TEST_CHECK(a == 2 && b == 1);
+
+    TEST_CHECK(ezcb_unregister("test.basic", test_count, &a) == 1);
+    ezcb_trigger("test.basic", NULL);
+    TEST_CHECK(a == 2);
+}
+
+/* Unregisters itself from the trigger named by ctx */
+static ezcb_result_t test_unregister_self(
+    void* ctx,
+    void* data
+)
+{
+    (void) data;
+    (void) ezcb_unregister((const char*) ctx, test_unregister_self, ctx);
+    return EZCB_CONTINUE;
+}
+
+#ifndef EZCB_NO_MALLOC
+/* Table sizes of the default instance, over all shards */
+static size_t test_buckets(void)
+{
+    size_t buckets = 0;
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        buckets += EZCB_LOAD(ezcb_default.shards[i].buckets);
+    }
+    return buckets;
+}
+#endif
+
+/*
+ * Entries left without callbacks are freed, so ever new names registered
+ * and dropped again keep the footprint flat and the static pool from
+ * running out. Every other name is too long to be stored inline. Old
+ * tables still being drained come and go, so the footprint is compared
+ * after ezcb_compact(), which finishes them.
+ */
+static void test_entry_reuse(void)
+{
+    static char self[] = "test.self";
+    unsigned calls = 0;
+#ifndef EZCB_NO_MALLOC
+    long blocks = 0;
+#endif
+
+    for (int i = 0; i < 10000; i++)
+    {
+        char name[48];
+        snprintf(name, sizeof(name), i % 2 ? "test.reuse.%d" : "test.reuse.with.a.longer.name.%d", i);
+
+        int r = ezcb_register(name, 0, test_count, &calls);
+        if (r == 0 && ezcb_unregister(name, test_count, &calls) != 1) r = -1;
+        if (r != 0 || test_entries() != 0)
+        {
+            TEST_CHECK(r == 0 && test_entries() == 0);
+            break;
+        }
+#ifndef EZCB_NO_MALLOC
+        if (i == 1000)
+        {
+            ezcb_compact();
+            blocks = atomic_load(&test_blocks);
+        }
+#endif
+    }
+#ifndef EZCB_NO_MALLOC
+    ezcb_compact();
+    TEST_CHECK(atomic_load(&test_blocks) == blocks);
+
+    /* After a peak, tables shrink back as entries go, and ezcb_compact() returns the entry pools */
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < 4096; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "test.peak.%d", i);
+            TEST_CHECK(ezcb_register(name, 0, test_count, &calls) == 0);
+        }
+        TEST_CHECK(test_entries() == 4096);
+        TEST_CHECK(test_buckets() >= 4096);
+
+        /* One by one, then all at once */
+        if (round == 0)
+        {
+            for (int i = 0; i < 4096; i++)
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "test.peak.%d", i);
+                TEST_CHECK(ezcb_unregister(name, test_count, &calls) == 1);
+            }
+        }
+        else
+        {
+            TEST_CHECK(ezcb_unregister(NULL, test_count, &calls) == 4096);
+        }
+        TEST_CHECK(test_entries() == 0);
+        TEST_CHECK(test_buckets() == 16 * EZCB_SHARDS);
+    }
+    ezcb_compact();
+    TEST_CHECK(atomic_load(&test_blocks) == blocks);
+
+    /* A reserved table stays until ezcb_compact() */
+    TEST_CHECK(ezcb_reserve(4096) == 0);
+    size_t reserved = test_buckets();
+    TEST_CHECK(ezcb_register("test.reserved", 0, test_count, &calls) == 0);
+    TEST_CHECK(ezcb_unregister("test.reserved", test_count, &calls) == 1);
+    TEST_CHECK(test_buckets() == reserved);
+    ezcb_compact();
+    TEST_CHECK(test_buckets() == 16 * EZCB_SHARDS);
+#endif
+
+    /* A one-shot its trigger consumed, or a callback dropping itself, frees the entry as well */
+    TEST_CHECK(ezcb_register_once("test.once", 0, test_count, &calls) == 0);
+    ezcb_trigger("test.once", NULL);
+    TEST_CHECK(ezcb_register("test.self", 0, test_unregister_self, self) == 0);
+    ezcb_trigger(self, NULL);
+    TEST_CHECK(calls == 1);
+    TEST_CHECK(test_entries() == 0);
+
+    /* A handle keeps its entry, callbacks or not */
+    ezcb_handle_t h = ezcb_resolve("test.handle");
+    TEST_CHECK(h != NULL);
+    TEST_CHECK(ezcb_register_h(h, 0, test_count, &calls) == 0);
+    TEST_CHECK(ezcb_unregister("test.handle", test_count, &calls) == 1);
+    ezcb_trigger_h(h, NULL);
+    TEST_CHECK(test_entries() == 1);
+    TEST_CHECK(ezcb_register_h(h, 0, test_count, &calls) == 0);
+    ezcb_trigger("test.handle", NULL);
+    TEST_CHECK(calls == 2);
+}
+
+/*
+ * Bulk registration grows each shard's table at most once, to its final
+ * size, and registers every record or none; bulk unregistration frees the
+ * entries it empties.
+ */
+static void test_bulk(void)
+{
+    static char names[200][24];
+    static ezcb_reg_t regs[2 * 200];
+    unsigned a = 0;
+    unsigned b = 0;
+
+    for (int i = 0; i < 200; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "test.bulk.%d", i);
+        regs[2 * i] = (ezcb_reg_t){ names[i], test_count, &a, 1 };
+        regs[2 * i + 1] = (ezcb_reg_t){ names[i], test_count, &b, 0 };
+    }
+
+#ifdef EZCB_ENABLE_STATS
+    ezcb_init();
+    ezcb_stats_t before;
+    ezcb_stats_get(&before);
+#endif
+    TEST_CHECK(ezcb_register_many(regs, 400) == 0);
+    TEST_CHECK(test_entries() == 200);
+#ifdef EZCB_ENABLE_STATS
+    ezcb_stats_t after;
+    ezcb_stats_get(&after);
+    TEST_CHECK(after.resizes - before.resizes <= EZCB_SHARDS);
+    TEST_CHECK(after.callbacks == 400);
+#endif
+
+    ezcb_trigger("test.bulk.7", NULL);
+    TEST_CHECK(a == 1 && b == 1);
+
+    TEST_CHECK(ezcb_unregister_many(regs, 400) == 400);
+    TEST_CHECK(test_entries() == 0);
+    ezcb_trigger("test.bulk.7", NULL);
+    TEST_CHECK(a == 1 && b == 1);
+
+#ifdef EZCB_NO_MALLOC
+    /* More names than the static pool holds: nothing is registered */
+    static char more[EZCB_MAX_TRIGGERS + 1][24];
+    static ezcb_reg_t over[EZCB_MAX_TRIGGERS + 1];
+
+    for (int i = 0; i <= EZCB_MAX_TRIGGERS; i++)
+    {
+        snprintf(more[i], sizeof(more[i]), "test.over.%d", i);
+        over[i] = (ezcb_reg_t){ more[i], test_count, &a, 0 };
+    }
+    TEST_CHECK(ezcb_register_many(over, EZCB_MAX_TRIGGERS + 1) != 0);
+    TEST_CHECK(test_entries() == 0);
+#endif
+}
+
+/*
+ * A blob is only written, or sized, when every callback has a symbol, and
+ * a restore rejects one whose names do not match their stored length or
+ * hash, which would make entries no lookup can reach.
+ */
+static void test_snapshot(void)
+{
+    static uint8_t blob[256];
+    unsigned a = 0;
+    unsigned b = 0;
+    ezcb_symbol_t syms[] = { { test_count, &a }, { test_count, &b } };
+
+    TEST_CHECK(ezcb_register("test.snap.a", 1, test_count, &a) == 0);
+    TEST_CHECK(ezcb_register("test.snap.b", 0, test_count, &b) == 0);
+
+    /* Sizing and writing both fail with b missing */
+    TEST_CHECK(ezcb_snapshot(NULL, 0, syms, 1) == 0);
+    TEST_CHECK(ezcb_snapshot(blob, sizeof(blob), syms, 1) == 0);
+
+    size_t size = ezcb_snapshot(NULL, 0, syms, 2);
+    TEST_CHECK(size != 0 && size <= sizeof(blob));
+    TEST_CHECK(ezcb_snapshot(blob, sizeof(blob), syms, 2) == size);
+    if (size == 0 || size > sizeof(blob)) return;
+
+    ezcb_deinit();
+
+    /* Each field of the first trigger record in turn, and a byte of its name */
+    ezcb_blob_trigger_t t;
+    memcpy(&t, blob + sizeof(ezcb_blob_hdr_t), sizeof(t));
+
+    for (int field = 0; field < 3; field++)
+    {
+        uint8_t bad[sizeof(blob)];
+        ezcb_blob_trigger_t u = t;
+
+        memcpy(bad, blob, size);
+        if (field == 0) u.hash ^= 1;
+        if (field == 1) u.len--;
+        memcpy(bad + sizeof(ezcb_blob_hdr_t), &u, sizeof(u));
+        if (field == 2) bad[t.name] ^= 0x20;
+
+        TEST_CHECK(ezcb_restore(bad, size, syms, 2) != 0);
+        TEST_CHECK(test_entries() == 0);
+    }
+
+    TEST_CHECK(ezcb_restore(blob, size, syms, 2) == 0);
+    ezcb_trigger("test.snap.a", NULL);
+    ezcb_trigger("test.snap.b", NULL);
+    TEST_CHECK(a == 1 && b == 1);
+}
+
+#ifdef EZCB_ENABLE_ISR
+typedef struct test_payloads
+{
+    unsigned calls;
+    unsigned bad;                   /* Copies that did not arrive intact */
+} test_payloads_t;
+
+/* A payload is its length, then that many bytes of the round it was queued in */
+static ezcb_result_t test_payload(
+    void* ctx,
+    void* data
+)
+{
+    test_payloads_t* t = (test_payloads_t*) ctx;
+    const unsigned char* p = (const unsigned char*) data;
+
+    for (unsigned i = 1; i <= p[0]; i++)
+    {
+        if (p[i] != p[p[0]]) t->bad++;
+    }
+    t->calls++;
+    return EZCB_CONTINUE;
+}
+
+/*
+ * Queue and payload ring positions wrap around their index width many
+ * times over; with EZCB_EVENT_INDEX_BITS=8 that is every few rounds.
+ */
+static void test_isr_wrap(void)
+{
+    unsigned calls = 0;
+    test_payloads_t payloads = { 0, 0 };
+
+    TEST_CHECK(ezcb_register("test.isr", 0, test_count, &calls) == 0);
+    ezcb_handle_t h = ezcb_resolve("test.isr");
+    ezcb_handle_t copy = ezcb_resolve("test.isr.copy");
+    TEST_CHECK(h != NULL && copy != NULL);
+    TEST_CHECK(ezcb_register_h(copy, 0, test_payload, &payloads) == 0);
+
+    for (unsigned round = 0; round < 1000; round++)
+    {
+        unsigned char buf[48];
+        unsigned len = 1 + round % 40;
+
+        buf[0] = (unsigned char) len;
+        memset(buf + 1, (int)(round & 0xFF), len);
+
+        TEST_CHECK(ezcb_trigger_isr("test.isr", NULL) == 0);
+        TEST_CHECK(ezcb_trigger_isr_h(h, NULL) == 0);
+        TEST_CHECK(ezcb_trigger_isr_copy(copy, buf, len + 1) == 0);
+        TEST_CHECK(ezcb_trigger_isr_copy(copy, buf, len + 1) == 0);
+        ezcb_dispatch();
+    }
+    TEST_CHECK(calls == 2000);
+    TEST_CHECK(payloads.calls == 2000);
+    TEST_CHECK(payloads.bad == 0);
+}
+
+/* Records each batch it is called with, a digit per payload */
+static ezcb_result_t test_batch(
+    void* ctx,
+    void** data,
+    size_t n
+)
+{
+    char* order = (char*) ctx;
+    size_t len = strlen(order);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        order[len++] = (char)('0' + (int)(intptr_t) data[i]);
+    }
+    order[len++] = '|';
+    order[len] = '\0';
+    return EZCB_CONTINUE;
+}
+
+/*
+ * Batched dispatch groups events queued by name and by handle into one
+ * run of their trigger, in queue order, and fires a group with a handle
+ * event in it through that handle, without looking the name up.
+ */
+static void test_isr_batch_handle(void)
+{
+    char order[32] = "";
+
+    TEST_CHECK(ezcb_register_batch("test.batch", 0, test_batch, order) == 0);
+    ezcb_handle_t h = ezcb_resolve("test.batch");
+    TEST_CHECK(h != NULL);
+
+    TEST_CHECK(ezcb_trigger_isr("test.batch", (void*) 1) == 0);
+    TEST_CHECK(ezcb_trigger_isr_h(h, (void*) 2) == 0);
+    TEST_CHECK(ezcb_trigger_isr("test.batch", (void*) 3) == 0);
+    TEST_CHECK(ezcb_dispatch_batch(EZCB_EVENT_QUEUE_SIZE) == 3);
+    TEST_CHECK(strcmp(order, "123|") == 0);
+
+    /* With its hash changed no lookup finds the entry, so only the handle reaches it */
+    order[0] = '\0';
+    h->hash ^= 1;
+    TEST_CHECK(ezcb_trigger_isr_h(h, (void*) 4) == 0);
+    TEST_CHECK(ezcb_trigger_isr_h(h, (void*) 5) == 0);
+    TEST_CHECK(ezcb_dispatch_batch(EZCB_EVENT_QUEUE_SIZE) == 2);
+    h->hash ^= 1;
+    TEST_CHECK(strcmp(order, "45|") == 0);
+}
+#endif  /* EZCB_ENABLE_ISR */
+
+#ifdef EZCB_STATIC_HANDLERS
+/*
+ * Static handlers need no registration, so the first trigger links them,
+ * whichever path it takes. ezcb_deinit() of an unused instance does not
+ * set it up just to tear it down.
+ */
+static void test_static_literal(void)
+{
+    long allocs = atomic_load(&test_allocs);
+    ezcb_deinit();
+    TEST_CHECK(!ezcb_default.ready);
+    TEST_CHECK(atomic_load(&test_allocs) == allocs);
+
+    test_static_calls = 0;
+    EZCB_TRIGGER_LIT("test.static", NULL);
+    TEST_CHECK(ezcb_default.ready);
+    TEST_CHECK(test_static_calls == 1);
+    EZCB_TRIGGER_LIT("test.static", NULL);
+    TEST_CHECK(test_static_calls == 2);
+}
+#endif  /* EZCB_STATIC_HANDLERS */
+
+#if defined(EZCB_LOCK_SHARDS) && EZCB_LOCK_SHARDS > 1
+/*
+ * Calls that take every shard lock must fail from a callback, which holds
+ * its own shard. Two callbacks on different shards taking them at once
+ * used to deadlock, so both threads meet inside their callbacks before
+ * either tries.
+ */
+typedef struct test_lock_all
+{
+    pthread_barrier_t* barrier;
+    const char* name;
+    int many;
+    int unmany;
+    int pattern;
+    int unpattern;
+    size_t snapshot;
+} test_lock_all_t;
+
+static ezcb_result_t test_lock_all_cb(
+    void* ctx,
+    void* data
+)
+{
+    test_lock_all_t* t = (test_lock_all_t*) ctx;
+    ezcb_reg_t reg = { t->name, test_lock_all_cb, t, 0 };
+    ezcb_symbol_t sym = { test_lock_all_cb, t };
+
+    (void) data;
+    pthread_barrier_wait(t->barrier);
+
+    t->many = ezcb_register_many(&reg, 1);
+    t->unmany = ezcb_unregister_many(&reg, 1);
+#ifdef EZCB_ENABLE_PATTERNS
+    t->pattern = ezcb_register_pattern("test.*", 0, test_lock_all_cb, t);
+    t->unpattern = ezcb_unregister_pattern(NULL, NULL, NULL);
+#endif
+    t->snapshot = ezcb_snapshot(NULL, 0, &sym, 1);
+    return EZCB_CONTINUE;
+}
+
+static void* test_lock_all_main(
+    void* arg
+)
+{
+    test_lock_all_t* t = (test_lock_all_t*) arg;
+    ezcb_trigger(t->name, NULL);
+    return NULL;
+}
+
+static void test_lock_all_in_callback(void)
+{
+    /* Two names on different shards */
+    char names[2][16] = { "test.0" };
+    ezcb_shard_t* first = ezcb_resolve(names[0])->shard;
+
+    for (unsigned i = 1;; i++)
+    {
+        snprintf(names[1], sizeof(names[1]), "test.%u", i);
+        if (ezcb_resolve(names[1])->shard != first) break;
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, 2);
+
+    test_lock_all_t t[2];
+    memset(t, 0, sizeof(t));
+
+    for (int i = 0; i < 2; i++)
+    {
+        t[i].barrier = &barrier;
+        t[i].name = names[i];
+        TEST_CHECK(ezcb_register(names[i], 0, test_lock_all_cb, &t[i]) == 0);
+    }
+
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_create(&threads[i], NULL, test_lock_all_main, &t[i]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    for (int i = 0; i < 2; i++)
+    {
+        TEST_CHECK(t[i].many < 0);
+        TEST_CHECK(t[i].unmany == 1);       /* The callback itself, one trigger at a time */
+#ifdef EZCB_ENABLE_PATTERNS
+        TEST_CHECK(t[i].pattern < 0);
+        TEST_CHECK(t[i].unpattern < 0);
+#endif
+        TEST_CHECK(t[i].snapshot == 0);
+    }
+
+    /* Outside a callback they work as before */
+    unsigned n = 0;
+    ezcb_reg_t reg = { names[0], test_count, &n, 0 };
+    TEST_CHECK(ezcb_register_many(&reg, 1) == 0);
+    ezcb_trigger(names[0], NULL);
+    TEST_CHECK(n == 1);
+    TEST_CHECK(ezcb_unregister_many(&reg, 1) == 1);
+}
+#endif  /* EZCB_LOCK_SHARDS */
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+/* Unregistering by ctx finds every link while the link table is being drained into a grown one */
+static void test_index_rehash(void)
+{
+    static char objs[2000];
+    unsigned calls = 0;
+    bool draining = false;
+
+    for (size_t i = 0; i < 2000; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "test.%zu", i % 16);
+
+        TEST_CHECK(ezcb_register(name, 0, test_count, &calls) == 0);
+        TEST_CHECK(ezcb_register(name, 1, test_count, &objs[i]) == 0);
+        if (ezcb_default.shards[0].old_refs) draining = true;
+
+        /* Every third object goes again at once, moved over or not */
+        if (i % 3 == 0) TEST_CHECK(ezcb_unregister(NULL, NULL, &objs[i]) == 1);
+    }
+    TEST_CHECK(draining);
+
+    int removed = 0;
+    for (size_t i = 0; i < 2000; i++)
+    {
+        removed += ezcb_unregister(NULL, NULL, &objs[i]);
+    }
+    TEST_CHECK(removed == 2000 - 667);
+    TEST_CHECK(ezcb_unregister(NULL, test_count, NULL) == 2000);
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+#ifdef EZCB_ENABLE_PATTERNS
+/* Appends its tag to the running order, and lets a payload of 1 stop there */
+typedef struct test_tag
+{
+    char tag;
+    char* order;
+} test_tag_t;
+
+static ezcb_result_t test_tagged(
+    void* ctx,
+    void* data
+)
+{
+    test_tag_t* t = (test_tag_t*) ctx;
+    size_t len = strlen(t->order);
+
+    t->order[len] = t->tag;
+    t->order[len + 1] = '\0';
+    return data ? EZCB_STOP : EZCB_CONTINUE;
+}
+
+#if EZCB_SHARDS == 1
+static test_tag_t* test_unpattern_target;
+
+static ezcb_result_t test_unpattern(
+    void* ctx,
+    void* data
+)
+{
+    (void) ctx;
+    (void) data;
+    (void) ezcb_unregister_pattern(NULL, test_tagged, test_unpattern_target);
+    return EZCB_CONTINUE;
+}
+#endif
+
+/*
+ * Triggering names that only patterns match runs their callbacks in
+ * priority order without creating an entry per name.
+ */
+static void test_pattern_unknown(void)
+{
+    char order[16] = "";
+    test_tag_t a = { 'a', order };
+    test_tag_t b = { 'b', order };
+    test_tag_t c = { 'c', order };
+    test_tag_t d = { 'd', order };
+
+    TEST_CHECK(ezcb_register_pattern("test.*", 1, test_tagged, &a) == 0);
+    TEST_CHECK(ezcb_register_pattern("test.#", 2, test_tagged, &b) == 0);
+    TEST_CHECK(ezcb_register_pattern("#", 0, test_tagged, &c) == 0);
+    TEST_CHECK(ezcb_register_pattern("other.*", 3, test_tagged, &d) == 0);
+
+    ezcb_trigger("test.first", NULL);
+    TEST_CHECK(strcmp(order, "bac") == 0);
+
+    /* A callback that stops a payload drops it for the rest */
+    order[0] = '\0';
+    ezcb_trigger("test.stopped", order);
+    TEST_CHECK(strcmp(order, "b") == 0);
+
+    long blocks = atomic_load(&test_blocks);
+    for (int i = 0; i < 10000; i++)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "test.%d", i);
+
+        order[0] = '\0';
+        ezcb_trigger(name, NULL);
+        if (strcmp(order, "bac") != 0) break;
+    }
+    TEST_CHECK(strcmp(order, "bac") == 0);
+    TEST_CHECK(atomic_load(&test_blocks) == blocks);
+    TEST_CHECK(test_entries() == 0);
+
+    /* An entry made for a handle still gets copies of the same callbacks */
+    ezcb_handle_t h = ezcb_resolve("test.handle");
+    TEST_CHECK(h != NULL);
+    order[0] = '\0';
+    ezcb_trigger_h(h, NULL);
+    TEST_CHECK(strcmp(order, "bac") == 0);
+    TEST_CHECK(test_entries() == 1);
+
+#if EZCB_SHARDS == 1
+    /* One unregistered by an earlier callback of the same trigger is skipped (sharded, that call fails) */
+    test_unpattern_target = &a;
+    TEST_CHECK(ezcb_register_pattern("test.*", 5, test_unpattern, NULL) == 0);
+    order[0] = '\0';
+    ezcb_trigger("test.last", NULL);
+    TEST_CHECK(strcmp(order, "bc") == 0);
+#endif
+}
+/*
+ * An entry left with nothing but the copies of a pattern's callbacks is
+ * freed like an empty one, as triggering its name runs the pattern anyway.
+ */
+static void test_pattern_copies(void)
+{
+    char order[16] = "";
+    unsigned calls = 0;
+    test_tag_t p = { 'p', order };
+
+    TEST_CHECK(ezcb_register_pattern("test.*", 0, test_tagged, &p) == 0);
+    ezcb_trigger("test.copy", NULL);
+    TEST_CHECK(strcmp(order, "p") == 0);
+    ezcb_compact();
+    long blocks = atomic_load(&test_blocks);
+
+    /* The new entry takes a copy of the pattern's callback next to its own */
+    TEST_CHECK(ezcb_register("test.copy", 1, test_count, &calls) == 0);
+    TEST_CHECK(test_entries() == 1);
+    order[0] = '\0';
+    ezcb_trigger("test.copy", NULL);
+    TEST_CHECK(calls == 1 && strcmp(order, "p") == 0);
+
+    TEST_CHECK(ezcb_unregister("test.copy", test_count, &calls) == 1);
+    TEST_CHECK(test_entries() == 0);
+    ezcb_compact();
+    TEST_CHECK(atomic_load(&test_blocks) == blocks);
+
+    order[0] = '\0';
+    ezcb_trigger("test.copy", NULL);
+    TEST_CHECK(calls == 1 && strcmp(order, "p") == 0);
+}
+#endif  /* EZCB_ENABLE_PATTERNS */
+
+#ifdef EZCB_FANOUT
+static atomic_uint test_parallel_calls;
+
+static ezcb_result_t test_parallel(
+    void* ctx,
+    void* data
+)
+{
+    (void) ctx;
+    (void) data;
+    atomic_fetch_add(&test_parallel_calls, 1);
+    return EZCB_CONTINUE;
+}
+
+/*
+ * Fanning out reuses the executor's groups instead of allocating one per
+ * trigger. Queued helpers each hold their group, so the first round
+ * grows the free list to as many as are out at once.
+ */
+static void test_fanout_reuse(void)
+{
+    TEST_CHECK(ezcb_executor_start(2) == 0);
+
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_CHECK(ezcb_register_parallel("test.fanout", 0, test_parallel, (void*)(intptr_t) i, true) == 0);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        ezcb_trigger("test.fanout", NULL);
+    }
+    ezcb_executor_wait();
+    long allocs = atomic_load(&test_allocs);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        ezcb_trigger("test.fanout", NULL);
+    }
+    ezcb_executor_wait();
+
+    /* A few more groups if more helpers queue at once than the first time round */
+    TEST_CHECK(atomic_load(&test_allocs) - allocs < 100);
+    TEST_CHECK(atomic_load(&test_parallel_calls) == 4 * 2000);
+    ezcb_executor_stop();
+}
+#endif  /* EZCB_FANOUT */
+
+/****************************************************************
+ * Main
+ ****************************************************************/
+
+int main(void)
+{
+    test_run("basic", test_basic);
+    test_run("entry_reuse", test_entry_reuse);
+    test_run("bulk", test_bulk);
+    test_run("snapshot", test_snapshot);
+#ifdef EZCB_ENABLE_ISR
+    test_run("isr_wrap", test_isr_wrap);
+    test_run("isr_batch_handle", test_isr_batch_handle);
+#endif
+#ifdef EZCB_STATIC_HANDLERS
+    test_run("static_literal", test_static_literal);
+#endif
+#if defined(EZCB_LOCK_SHARDS) && EZCB_LOCK_SHARDS > 1
+    test_run("lock_all_in_callback", test_lock_all_in_callback);
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    test_run("index_rehash", test_index_rehash);
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    test_run("pattern_unknown", test_pattern_unknown);
+    test_run("pattern_copies", test_pattern_copies);
+#endif
+#ifdef EZCB_FANOUT
+    test_run("fanout_reuse", test_fanout_reuse);
+#endif
+
+    return test_failures ? 1 : 0;
+}
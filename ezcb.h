@@ -37,12 +37,153 @@
 /* Disable dynamic allocation */
 // #define EZCB_NO_MALLOC
 
+/* Allocator for dynamic mode; define all three to replace malloc, realloc and free */
+// #define EZCB_MALLOC(n)           my_malloc(n)
+// #define EZCB_REALLOC(p, n)       my_realloc(p, n)
+// #define EZCB_FREE(p)             my_free(p)
+
 /* Enable thread-safety using mutex */
 // #define EZCB_THREAD_SAFE
 
+/* Recursive shard mutex; define all five to replace the C11 mtx_t (pthreads are used under ThreadSanitizer) */
+// #define EZCB_MUTEX_T             my_mutex_t
+// #define EZCB_MUTEX_INIT(m)       my_mutex_init(&(m))
+// #define EZCB_MUTEX_LOCK(m)       my_mutex_lock(&(m))
+// #define EZCB_MUTEX_UNLOCK(m)     my_mutex_unlock(&(m))
+// #define EZCB_MUTEX_DESTROY(m)    my_mutex_destroy(&(m))
+
 /* Enable ISR-safe deferred triggering */
 // #define EZCB_ENABLE_ISR
 
+/* Collapse repeated deferred triggers of a handle into its pending one (needs EZCB_ENABLE_ISR or EZCB_ENABLE_EXECUTOR) */
+// #define EZCB_ENABLE_COALESCING
+
+/* Lock-free ezcb_trigger() using epoch-based reclamation (needs EZCB_THREAD_SAFE) */
+// #define EZCB_LOCK_FREE_TRIGGER
+
+/* Split the dispatcher into N independently locked shards (needs EZCB_THREAD_SAFE) */
+// #define EZCB_LOCK_SHARDS 8
+
+/* Collect dispatch statistics and enable pre/post-dispatch hooks */
+// #define EZCB_ENABLE_STATS
+
+/* Latency histograms per trigger and for the ISR queue, and a per-callback timing hook (needs EZCB_ENABLE_STATS) */
+// #define EZCB_ENABLE_LATENCY
+
+/* Open-addressed trigger table with inline hash fingerprints (needs dynamic allocation) */
+// #define EZCB_OPEN_ADDRESSING
+
+/* Worker pool running ezcb_post() triggers off the caller's thread (needs EZCB_THREAD_SAFE) */
+// #define EZCB_ENABLE_EXECUTOR
+
+/* Link-time callback registration with EZCB_STATIC_HANDLER() (needs GCC or Clang) */
+// #define EZCB_STATIC_HANDLERS
+
+/* Pattern subscriptions such as "sensor.*" or "sensor.#" (needs dynamic allocation) */
+// #define EZCB_ENABLE_PATTERNS
+
+/* Reverse indices by fn and ctx, and registration tokens (needs dynamic allocation) */
+// #define EZCB_ENABLE_REVERSE_INDEX
+
+/* Use the portable scalar name compare and fingerprint scan even where SSE2 or NEON is available */
+// #define EZCB_NO_SIMD
+
+/* Replace the trigger name hash; called as uint32_t EZCB_HASH_FN(const char* name, size_t length) */
+// #define EZCB_HASH_FN(name, length)   my_hash(name, length)
+
+/* Free-running uint32_t clock for ezcb_dispatch_budget() and latencies (default microseconds from timespec_get or clock) */
+// #define EZCB_TICKS()             my_cycle_counter()
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    #ifndef EZCB_THREAD_SAFE
+        #error "EZCB_LOCK_FREE_TRIGGER requires EZCB_THREAD_SAFE"
+    #endif
+    #ifdef EZCB_NO_MALLOC
+        #error "EZCB_LOCK_FREE_TRIGGER requires dynamic allocation"
+    #endif
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_LOCK_SHARDS
+    #ifndef EZCB_THREAD_SAFE
+        #error "EZCB_LOCK_SHARDS requires EZCB_THREAD_SAFE"
+    #endif
+    #ifdef EZCB_NO_MALLOC
+        #error "EZCB_LOCK_SHARDS requires dynamic allocation"
+    #endif
+    #ifdef EZCB_LOCK_FREE_TRIGGER
+        #error "EZCB_LOCK_SHARDS and EZCB_LOCK_FREE_TRIGGER are mutually exclusive"
+    #endif
+    #if EZCB_LOCK_SHARDS < 1 || EZCB_LOCK_SHARDS > 256
+        #error "EZCB_LOCK_SHARDS must be between 1 and 256"
+    #endif
+#endif  /* EZCB_LOCK_SHARDS */
+
+#if defined(EZCB_OPEN_ADDRESSING) && defined(EZCB_NO_MALLOC)
+    #error "EZCB_OPEN_ADDRESSING requires dynamic allocation"
+#endif
+
+#if defined(EZCB_ENABLE_PATTERNS) && defined(EZCB_NO_MALLOC)
+    #error "EZCB_ENABLE_PATTERNS requires dynamic allocation"
+#endif
+
+#if defined(EZCB_ENABLE_REVERSE_INDEX) && defined(EZCB_NO_MALLOC)
+    #error "EZCB_ENABLE_REVERSE_INDEX requires dynamic allocation"
+#endif
+
+#ifdef EZCB_ENABLE_EXECUTOR
+    #ifndef EZCB_THREAD_SAFE
+        #error "EZCB_ENABLE_EXECUTOR requires EZCB_THREAD_SAFE"
+    #endif
+    #ifdef EZCB_NO_MALLOC
+        #error "EZCB_ENABLE_EXECUTOR requires dynamic allocation"
+    #endif
+    #ifndef EZCB_EXECUTOR_QUEUE_SIZE
+        #define EZCB_EXECUTOR_QUEUE_SIZE 256
+    #endif
+    #if EZCB_EXECUTOR_QUEUE_SIZE < 1 || (EZCB_EXECUTOR_QUEUE_SIZE & (EZCB_EXECUTOR_QUEUE_SIZE - 1)) != 0
+        #error "EZCB_EXECUTOR_QUEUE_SIZE must be a power of two"
+    #endif
+#endif  /* EZCB_ENABLE_EXECUTOR */
+
+#ifndef EZCB_NO_MALLOC
+    #ifndef EZCB_INLINE_TRIGGER_LENGTH
+        #define EZCB_INLINE_TRIGGER_LENGTH 16
+    #endif
+    #ifndef EZCB_REHASH_STEP
+        #define EZCB_REHASH_STEP 4
+    #endif
+    #if EZCB_REHASH_STEP < 1
+        #error "EZCB_REHASH_STEP must be at least 1"
+    #endif
+    #if defined(EZCB_MALLOC) || defined(EZCB_REALLOC) || defined(EZCB_FREE)
+        #if !defined(EZCB_MALLOC) || !defined(EZCB_REALLOC) || !defined(EZCB_FREE)
+            #error "EZCB_MALLOC, EZCB_REALLOC and EZCB_FREE must be defined together"
+        #endif
+    #endif
+#endif  /* EZCB_NO_MALLOC */
+
+#if defined(EZCB_ENABLE_COALESCING) && !defined(EZCB_ENABLE_ISR) && !defined(EZCB_ENABLE_EXECUTOR)
+    #error "EZCB_ENABLE_COALESCING requires EZCB_ENABLE_ISR or EZCB_ENABLE_EXECUTOR"
+#endif
+
+#ifdef EZCB_ENABLE_LATENCY
+    #ifndef EZCB_ENABLE_STATS
+        #error "EZCB_ENABLE_LATENCY requires EZCB_ENABLE_STATS"
+    #endif
+    /* Histogram buckets per power of two, as a power of two */
+    #ifndef EZCB_LATENCY_PRECISION
+        #define EZCB_LATENCY_PRECISION 2
+    #endif
+    #if EZCB_LATENCY_PRECISION < 0 || EZCB_LATENCY_PRECISION > 4
+        #error "EZCB_LATENCY_PRECISION must be between 0 and 4"
+    #endif
+    #define EZCB_LATENCY_BUCKETS ((33 - EZCB_LATENCY_PRECISION) << EZCB_LATENCY_PRECISION)
+#endif  /* EZCB_ENABLE_LATENCY */
+
+#if defined(EZCB_STATIC_HANDLERS) && !defined(__GNUC__)
+    #error "EZCB_STATIC_HANDLERS requires GCC or Clang"
+#endif
+
 #ifdef EZCB_NO_MALLOC
     #ifndef EZCB_MAX_BUCKETS
         #define EZCB_MAX_BUCKETS 32
@@ -50,16 +191,56 @@
     #ifndef EZCB_MAX_NODES
         #define EZCB_MAX_NODES 64
     #endif
+    #ifndef EZCB_MAX_TRIGGERS
+        #define EZCB_MAX_TRIGGERS 32
+    #endif
     #ifndef EZCB_MAX_TRIGGER_LENGTH
         #define EZCB_MAX_TRIGGER_LENGTH 32
     #endif
+    #ifndef EZCB_MAX_CONTEXTS
+        #define EZCB_MAX_CONTEXTS 0
+    #endif
+    #ifndef EZCB_MAX_STATIC_HANDLERS
+        #define EZCB_MAX_STATIC_HANDLERS 32
+    #endif
+    #if EZCB_MAX_BUCKETS < 1 || (EZCB_MAX_BUCKETS & (EZCB_MAX_BUCKETS - 1)) != 0
+        #error "EZCB_MAX_BUCKETS must be a power of two"
+    #endif
 #endif  /* EZCB_NO_MALLOC */
 
-/* Event queue size for ISR support */
+/* Event queue size and index width for ISR support */
 #ifdef EZCB_ENABLE_ISR
     #ifndef EZCB_EVENT_QUEUE_SIZE
         #define EZCB_EVENT_QUEUE_SIZE 16
     #endif
+    #ifndef EZCB_EVENT_INDEX_BITS
+        #define EZCB_EVENT_INDEX_BITS 32
+    #endif
+    #if EZCB_EVENT_INDEX_BITS != 8 && EZCB_EVENT_INDEX_BITS != 16 && \
+        EZCB_EVENT_INDEX_BITS != 32 && EZCB_EVENT_INDEX_BITS != 64
+        #error "EZCB_EVENT_INDEX_BITS must be 8, 16, 32 or 64"
+    #endif
+    #if EZCB_EVENT_QUEUE_SIZE < 2 || (EZCB_EVENT_QUEUE_SIZE & (EZCB_EVENT_QUEUE_SIZE - 1)) != 0
+        #error "EZCB_EVENT_QUEUE_SIZE must be a power of two (at least 2)"
+    #endif
+    #if EZCB_EVENT_INDEX_BITS < 64 && EZCB_EVENT_QUEUE_SIZE > (1ULL << (EZCB_EVENT_INDEX_BITS - 1))
+        #error "EZCB_EVENT_QUEUE_SIZE must not exceed half the range of EZCB_EVENT_INDEX_BITS"
+    #endif
+    /* Event priorities, each with its own queue of EZCB_EVENT_QUEUE_SIZE events */
+    #ifndef EZCB_EVENT_PRIORITIES
+        #define EZCB_EVENT_PRIORITIES 1
+    #endif
+    #if EZCB_EVENT_PRIORITIES < 1 || EZCB_EVENT_PRIORITIES > 256
+        #error "EZCB_EVENT_PRIORITIES must be between 1 and 256"
+    #endif
+    /* Bytes of ring holding the payloads copied by ezcb_trigger_isr_copy() */
+    #ifndef EZCB_PAYLOAD_RING_SIZE
+        #define EZCB_PAYLOAD_RING_SIZE 256
+    #endif
+    #if EZCB_PAYLOAD_RING_SIZE < 64 || (EZCB_PAYLOAD_RING_SIZE & (EZCB_PAYLOAD_RING_SIZE - 1)) != 0
+        #error "EZCB_PAYLOAD_RING_SIZE must be a power of two (at least 64)"
+    #endif
+    /* Its units must not exceed half the range of EZCB_EVENT_INDEX_BITS; checked along with ezcb_rec_t */
 #endif  /* EZCB_ENABLE_ISR */
 
 /****************************************************************
@@ -91,6 +272,236 @@ typedef ezcb_result_t (*ezcb_fn_t)(
     void* data
 );
 
+/**
+ * @brief Batch callback function type.
+ *
+ * Receives every pending payload for its trigger in one call when events
+ * are drained with ezcb_dispatch_batch(); a direct ezcb_trigger() passes a
+ * single payload. Returning EZCB_STOP halts the remaining callbacks for
+ * the whole batch.
+ *
+ * @param ctx   User‑defined context pointer associated with the registration.
+ * @param data  Array of data pointers, in the order they were triggered.
+ * @param n     Number of entries in data (at least 1).
+ *
+ * @return EZCB_CONTINUE to keep processing callbacks, or EZCB_STOP to halt.
+ */
+typedef ezcb_result_t (*ezcb_batch_fn_t)(
+    void* ctx,
+    void** data,
+    size_t n
+);
+
+/**
+ * @brief One registration for ezcb_register_many() and ezcb_unregister_many().
+ */
+typedef struct ezcb_reg
+{
+    const char* trigger;
+    ezcb_fn_t fn;
+    void* ctx;
+    uint8_t priority;
+} ezcb_reg_t;
+
+/**
+ * @brief One callback ezcb_snapshot() and ezcb_restore() can name.
+ *
+ * A blob stores an index into a table of these in place of each
+ * callback's fn and ctx. A batch callback is listed cast to ezcb_fn_t.
+ */
+typedef struct ezcb_symbol
+{
+    ezcb_fn_t fn;
+    void* ctx;
+} ezcb_symbol_t;
+
+/****************************************************************
+ * Handle
+ ****************************************************************/
+
+/**
+ * @brief Opaque handle to a resolved trigger.
+ *
+ * Returned by ezcb_resolve(). A handle refers directly to the interned
+ * trigger entry, so the *_h() variants skip hashing and comparing the
+ * trigger name. Handles remain valid across table resizes, until
+ * ezcb_deinit() (or ezcb_destroy() for their instance) is called: an
+ * entry a handle was returned for is kept even while it has no callbacks.
+ */
+typedef struct ezcb_entry* ezcb_handle_t;
+
+/**
+ * @brief One registration, returned by ezcb_register_token().
+ *
+ * Names a single callback record, so ezcb_unregister_token() removes it
+ * without matching fn and ctx or looking up the trigger. A NULL handle
+ * means the registration failed. The token is valid until its record is
+ * removed by any means.
+ */
+typedef struct ezcb_token
+{
+    ezcb_handle_t handle;
+    uint32_t id;
+} ezcb_token_t;
+
+/****************************************************************
+ * Instance
+ ****************************************************************/
+
+/**
+ * @brief Opaque dispatcher instance.
+ *
+ * Returned by ezcb_create(). Each instance has its own trigger table,
+ * locks, statistics and ISR queue, and is driven through the *_ex()
+ * functions. The functions without a suffix use a built-in default
+ * instance. A handle belongs to the instance that resolved it, so the
+ * *_h() functions need no instance argument.
+ */
+typedef struct ezcb_ctx ezcb_ctx_t;
+
+/****************************************************************
+ * Trigger name hash
+ ****************************************************************/
+
+#ifndef EZCB_HASH_FN
+/*
+ * MurmurHash3 (x86, 32-bit, seed 0) over the name's bytes taken four at a
+ * time in little-endian order, so the value is the same on every target.
+ * The steps are inline functions so EZCB_HASH_LIT() can spell out the same
+ * computation over a literal, which an optimizing compiler folds.
+ */
+static inline uint32_t ezcb_hash_fold_(
+    uint32_t h,
+    uint32_t word,
+    bool full
+)
+{
+    word *= 0xCC9E2D51U;
+    word = (word << 15) | (word >> 17);
+    word *= 0x1B873593U;
+    h ^= word;
+
+    /* A partial last word (or none, which is 0) is mixed in without the block step */
+    if (full)
+    {
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xE6546B64U;
+    }
+    return h;
+}
+
+static inline uint32_t ezcb_hash_final_(
+    uint32_t h,
+    size_t length
+)
+{
+    h ^= (uint32_t) length;
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Byte i of literal s, 0 from its terminator on; the index stays in bounds either way */
+#define EZCB_HASH_BYTE_(s, i)                                                   \
+    ((i) + 1 < sizeof(s) ? (uint32_t)(uint8_t)(s)[(i) + 1 < sizeof(s) ? (i) : 0] : 0U)
+
+#define EZCB_HASH_WORD_(s, k)                                                   \
+    (EZCB_HASH_BYTE_(s, 4 * (k))           | EZCB_HASH_BYTE_(s, 4 * (k) + 1) << 8 | \
+     EZCB_HASH_BYTE_(s, 4 * (k) + 2) << 16 | EZCB_HASH_BYTE_(s, 4 * (k) + 3) << 24)
+
+/* Words past the last are 0 and not full, which leaves h unchanged */
+#define EZCB_HASH_STEP_(s, k, h)                                                \
+    ezcb_hash_fold_((h), EZCB_HASH_WORD_(s, k), 4 * (k) + 4 < sizeof(s))
+
+#define EZCB_HASH_STEP4_(s, k, h)                                               \
+    EZCB_HASH_STEP_(s, (k) + 3, EZCB_HASH_STEP_(s, (k) + 2,                     \
+    EZCB_HASH_STEP_(s, (k) + 1, EZCB_HASH_STEP_(s, k, h))))
+
+/**
+ * @brief Hash of a string literal trigger name, as ezcb computes it.
+ *
+ * Expands to the hash computation unrolled over the literal, which the
+ * compiler folds to a constant when optimizing. Pass the result to
+ * ezcb_trigger_hashed(), or use EZCB_TRIGGER_LIT(). Literals may be up to
+ * 63 characters long; a longer one, or anything but a literal, fails to
+ * compile. Not available with EZCB_HASH_FN.
+ *
+ * @param s           String literal.
+ */
+#define EZCB_HASH_LIT(s)                                                        \
+    ezcb_hash_final_(                                                            \
+        EZCB_HASH_STEP4_(s, 12, EZCB_HASH_STEP4_(s, 8,                          \
+        EZCB_HASH_STEP4_(s, 4, EZCB_HASH_STEP4_(s, 0, 0U)))),                   \
+        sizeof("" s "") - 1 + 0 * sizeof(char[sizeof(s) <= 64 ? 1 : -1]))
+
+/**
+ * @brief Trigger a string literal name with its hash computed at build time.
+ *
+ * Same as ezcb_trigger(s, data). With EZCB_HASH_FN the name is hashed at
+ * run time as usual.
+ *
+ * @param s           String literal trigger name.
+ * @param data        Caller‑supplied data passed to callbacks.
+ */
+#define EZCB_TRIGGER_LIT(s, data)                                               \
+    ezcb_trigger_hashed((s), sizeof(s) - 1, EZCB_HASH_LIT(s), (data))
+#else
+#define EZCB_TRIGGER_LIT(s, data)   ezcb_trigger((s), (data))
+#endif  /* EZCB_HASH_FN */
+
+#ifdef EZCB_STATIC_HANDLERS
+/****************************************************************
+ * Static handlers
+ ****************************************************************/
+
+/**
+ * @brief Link-time registration record, emitted by EZCB_STATIC_HANDLER().
+ */
+typedef struct ezcb_static
+{
+    const char* trigger;
+    ezcb_fn_t fn;
+    void* ctx;
+    uint8_t priority;
+} ezcb_static_t;
+
+#ifdef __APPLE__
+    #define EZCB_STATIC_SECTION     "__DATA_CONST,ezcb_static"
+#else
+    #define EZCB_STATIC_SECTION     "ezcb_static"
+#endif
+
+#define EZCB_STATIC_CAT_(a, b)      a##b
+#define EZCB_STATIC_CAT(a, b)       EZCB_STATIC_CAT_(a, b)
+
+/**
+ * @brief Register a callback for the default instance at link time.
+ * Define EZCB_STATIC_HANDLERS for implementation.
+ *
+ * Use at file scope. The record is const data in the ezcb_static linker
+ * section, so it costs no RAM of its own. ezcb_init() attaches every
+ * record to its trigger; without it, the first ezcb_register(),
+ * ezcb_resolve(), ezcb_trigger(), EZCB_TRIGGER_LIT() or ezcb_dispatch()
+ * on the default instance does, so call ezcb_init() before starting threads. Triggers
+ * run the records merged with the runtime callbacks by priority. On a tie
+ * a static handler runs before a runtime one; between static handlers the
+ * order follows the link and is unspecified. Static handlers cannot be
+ * unregistered.
+ *
+ * @param trigger     Trigger name (must outlive the program, e.g. a literal).
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ */
+#define EZCB_STATIC_HANDLER(trigger, priority, fn, ctx)                             \
+    static const ezcb_static_t EZCB_STATIC_CAT(ezcb_static_, __COUNTER__)           \
+        __attribute__((used, section(EZCB_STATIC_SECTION), aligned(sizeof(void*)))) \
+        = { (trigger), (fn), (ctx), (priority) }
+#endif  /* EZCB_STATIC_HANDLERS */
+
 /****************************************************************
  * Public API
  ****************************************************************/
@@ -107,7 +518,7 @@ void ezcb_init(void);
  * @brief Deinitialize the EZCB callback system and release resources.
  *
  * Frees all internal memory used by the callback system. In malloc mode,
- * all dynamically allocated nodes and the hash table are released. In
+ * all trigger entries, callback arrays and the hash table are released. In
  * static‑allocation mode, the internal tables and free lists are reset.
  *
  * After calling this function, the system returns to an uninitialized
@@ -156,6 +567,26 @@ int ezcb_register_once(
     void* ctx
 );
 
+/**
+ * @brief Register a batch callback for a given trigger.
+ *
+ * Same as ezcb_register(), but the callback takes all payloads that
+ * ezcb_dispatch_batch() collected for the trigger at once.
+ *
+ * @param trigger     Null‑terminated trigger name.
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Batch callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ * 
+ * @return 0 on success, negative value on allocation or insertion failure.
+ */
+int ezcb_register_batch(
+    const char* trigger,
+    uint8_t priority,
+    ezcb_batch_fn_t fn,
+    void* ctx
+);
+
 /**
  * @brief Unregister callbacks using wildcard matching.
  *
@@ -169,6 +600,10 @@ int ezcb_register_once(
  *   ezcb_unregister(NULL, fn, ctx);         // remove fn+ctx pair
  *   ezcb_unregister(NULL, NULL, NULL);      // remove EVERYTHING
  *
+ * A NULL trigger visits every trigger, unless EZCB_ENABLE_REVERSE_INDEX
+ * is defined and fn or ctx is given: then only the triggers holding a
+ * callback with that ctx (or else that fn) are visited.
+ *
  * @param trigger  Trigger name to match, or NULL for wildcard.
  * @param fn       Function pointer to match, or NULL for wildcard.
  * @param ctx      Context pointer to match, or NULL for wildcard.
@@ -182,450 +617,8732 @@ int ezcb_unregister(
 );
 
 /**
- * @brief Trigger all callbacks registered under a given name.
+ * @brief Unregister batch callbacks using wildcard matching.
  *
- * Executes callbacks in priority order. If a callback returns
- * EZCB_STOP, remaining callbacks for that trigger are skipped.
+ * Same as ezcb_unregister(), for callbacks added with
+ * ezcb_register_batch().
  *
- * @param trigger     Trigger name to fire.
- * @param data        Caller‑supplied data passed to callbacks.
+ * @param trigger  Trigger name to match, or NULL for wildcard.
+ * @param fn       Batch function pointer to match, or NULL for wildcard.
+ * @param ctx      Context pointer to match, or NULL for wildcard.
+ *
+ * @return Number of removed callbacks.
  */
-void ezcb_trigger(
+int ezcb_unregister_batch(
     const char* trigger,
-    void* data
+    ezcb_batch_fn_t fn,
+    void* ctx
 );
 
 /**
- * @brief Queue a trigger event from an ISR context.
+ * @brief Register many callbacks under one lock.
  *
- * Adds a trigger event to the ISR‑safe queue. The event will be
- * processed later by ezcb_dispatch(). Non‑blocking and safe for ISR use.
- * Define EZCB_ENABLE_ISR for implementation.
+ * Same as calling ezcb_register() for each record in order, but the table
+ * is grown at most once per shard for all the new triggers, and each
+ * trigger's new callbacks are merged into its array in one pass. Either
+ * every record is registered or, on failure, none is.
  *
- * @param trigger     Trigger name to enqueue.
- * @param data        Caller‑supplied data pointer.
- * 
- * @return 0 on success, negative value if the queue is full.
+ * With EZCB_LOCK_SHARDS this takes every shard lock in turn, which a
+ * callback holding its own shard cannot do without risking a deadlock;
+ * called from a callback, it fails and registers nothing.
+ *
+ * @param regs  Records to register; none may have a NULL trigger or fn.
+ * @param n     Number of records.
+ *
+ * @return 0 on success, negative value on allocation failure or, with
+ *         EZCB_LOCK_SHARDS, when called from a callback.
  */
-int  ezcb_trigger_isr(
-    const char* trigger,
-    void* data
+int ezcb_register_many(
+    const ezcb_reg_t* regs,
+    size_t n
 );
 
 /**
- * @brief Dispatch queued ISR trigger events.
- * Define EZCB_ENABLE_ISR for implementation.
+ * @brief Unregister many callbacks under one lock.
+ *
+ * Same as calling ezcb_unregister() with each record's trigger, fn and
+ * ctx; priority is ignored, and fn and ctx may be NULL for wildcard. Each
+ * trigger's array is compacted once, after every record was matched.
+ * With EZCB_LOCK_SHARDS, a call from a callback cannot take every shard
+ * lock and unregisters the records one at a time instead.
  *
- * Processes all pending events queued by ezcb_trigger_isr().
- * Should be called from the main loop or a safe execution context.
+ * @param regs  Records to match; none may have a NULL trigger.
+ * @param n     Number of records.
+ *
+ * @return Number of removed callbacks.
  */
-void ezcb_dispatch(void);
+int ezcb_unregister_many(
+    const ezcb_reg_t* regs,
+    size_t n
+);
 
-#endif  /* EZCB_H */
+/**
+ * @brief Write the registered callbacks into a flat blob.
+ *
+ * The blob holds every trigger with callbacks, its hash and its records in
+ * priority order, each naming its fn and ctx by index into symbols. It
+ * uses offsets only, so it can be written to a file and mapped back at
+ * any address, but only a build with the same hash function and byte
+ * order can read it. Triggers without callbacks, and pattern, static and
+ * removed callbacks, are left out. Must not be called from a callback;
+ * with EZCB_LOCK_SHARDS such a call returns 0.
+ *
+ * @param buf       Where to write the blob, or NULL to only get its size.
+ * @param size      Bytes available at buf.
+ * @param symbols   Every fn/ctx pair registered.
+ * @param nsymbols  Number of symbols.
+ *
+ * @return Size of the blob, which was written if it fits in size; 0, for
+ *         a size query too, if a callback is missing from symbols or the
+ *         blob would pass 4 GiB.
+ */
+size_t ezcb_snapshot(
+    void* buf,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+);
 
-/****************************************************************
- * Implementation
- ****************************************************************/
-#ifdef EZCB_IMPLEMENTATION
+/**
+ * @brief Register the callbacks of a blob from ezcb_snapshot().
+ *
+ * Same as registering each of them in the blob's order, but without
+ * hashing a name or sorting a record: each table is grown once, and each
+ * trigger's array is sized once and filled in one pass, as with
+ * ezcb_register_many(). Registrations already present are kept. The
+ * blob is only read and may be released afterwards; it need not be
+ * aligned. Either every callback is registered or none is, and as with
+ * ezcb_register_many() none is when called from a callback with
+ * EZCB_LOCK_SHARDS.
+ *
+ * @param blob      Blob written by ezcb_snapshot().
+ * @param size      Bytes available at blob.
+ * @param symbols   Table the blob's indices refer to.
+ * @param nsymbols  Number of symbols.
+ *
+ * @return 0 on success, negative value for a malformed or foreign blob
+ *         (one whose names do not match their stored length or hash
+ *         included) or on allocation failure.
+ */
+int ezcb_restore(
+    const void* blob,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+);
 
-#include <string.h>
-#ifndef EZCB_NO_MALLOC
-    #include <stdlib.h>
-#endif
+/**
+ * @brief Register a callback and return a token for it.
+ * Define EZCB_ENABLE_REVERSE_INDEX for implementation.
+ *
+ * Same as ezcb_register(), but the returned token names this one record
+ * for ezcb_unregister_token().
+ *
+ * @param trigger     Null‑terminated trigger name.
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ *
+ * @return Token of the registration; its handle is NULL on failure.
+ */
+ezcb_token_t ezcb_register_token(
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
 
-#ifdef EZCB_THREAD_SAFE
-    #include <threads.h>
-    
-    #define EZCB_MUTEX_INIT(m)      mtx_init(&(m), mtx_plain | mtx_recursive)
-    #define EZCB_MUTEX_LOCK(m)      mtx_lock(&(m))
-    #define EZCB_MUTEX_UNLOCK(m)    mtx_unlock(&(m))
-    #define EZCB_MUTEX_DESTROY(m)   mtx_destroy(&(m))
-#else
-    #define EZCB_MUTEX_INIT(m)
-    #define EZCB_MUTEX_LOCK(m)
-    #define EZCB_MUTEX_UNLOCK(m)
-    #define EZCB_MUTEX_DESTROY(m)
-#endif
+/**
+ * @brief Unregister the callback a token names.
+ * Define EZCB_ENABLE_REVERSE_INDEX for implementation.
+ *
+ * Only searches the callbacks of the token's trigger. Other records with
+ * the same fn and ctx are left alone. Works on the token's own instance.
+ *
+ * @param token  Token from ezcb_register_token().
+ *
+ * @return 1 if the callback was removed, 0 if it was already gone.
+ */
+int ezcb_unregister_token(
+    ezcb_token_t token
+);
 
-/****************************************************************
+/**
+ * @brief Register a callback for every trigger matching a pattern.
+ * Define EZCB_ENABLE_PATTERNS for implementation.
+ *
+ * Patterns are dot-separated like the trigger names they match. A "*"
+ * segment matches any one segment, and a final "#" matches any number of
+ * trailing segments, none included: "sensor.#" matches "sensor" and
+ * "sensor.imu.accel". A trigger that has an entry, because it has
+ * callbacks of its own or was resolved to a handle, keeps a copy of each
+ * matching pattern callback next to its own, so firing it never consults
+ * the patterns. Any other name is matched against them each time it is
+ * triggered and their callbacks run without creating an entry, so names
+ * that are only ever triggered take no memory; such fires reach the
+ * ezcb_set_hooks() hooks but not the per-trigger statistics.
+ *
+ * With EZCB_LOCK_SHARDS this takes every shard lock in turn, so it fails
+ * when called from a callback, which already holds one.
+ *
+ * @param pattern     Null‑terminated pattern ("#" only as the last segment).
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ *
+ * @return 0 on success, negative value on an invalid pattern, allocation
+ *         failure or, with EZCB_LOCK_SHARDS, a call from a callback.
+ */
+int ezcb_register_pattern(
+    const char* pattern,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Unregister pattern callbacks using wildcard matching.
+ * Define EZCB_ENABLE_PATTERNS for implementation.
+ *
+ * Same as ezcb_unregister(), for callbacks added with
+ * ezcb_register_pattern(); the pattern must be spelled as registered.
+ * ezcb_unregister() with a NULL trigger removes pattern callbacks as
+ * well, but ezcb_unregister() on a trigger name never does. Like
+ * ezcb_register_pattern(), it fails from a callback with EZCB_LOCK_SHARDS.
+ *
+ * @param pattern  Pattern to match, or NULL for wildcard.
+ * @param fn       Function pointer to match, or NULL for wildcard.
+ * @param ctx      Context pointer to match, or NULL for wildcard.
+ *
+ * @return Number of removed pattern callbacks, or a negative value for a
+ *         call from a callback with EZCB_LOCK_SHARDS.
+ */
+int ezcb_unregister_pattern(
+    const char* pattern,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Trigger all callbacks registered under a given name.
+ *
+ * Executes callbacks in priority order. If a callback returns
+ * EZCB_STOP, remaining callbacks for that trigger are skipped.
+ *
+ * Callbacks may register and unregister callbacks, this trigger's
+ * included. One unregistered meanwhile is not called afterwards; one
+ * registered meanwhile is not called by the trigger in progress.
+ *
+ * @param trigger     Trigger name to fire.
+ * @param data        Caller‑supplied data passed to callbacks.
+ */
+void ezcb_trigger(
+    const char* trigger,
+    void* data
+);
+
+/**
+ * @brief Trigger all callbacks registered under a name with a known hash.
+ *
+ * Same as ezcb_trigger(), but skips hashing and measuring the name. The
+ * hash must be the one ezcb computes: from EZCB_HASH_LIT(), or from
+ * EZCB_HASH_FN when it is defined. Debug builds check both values.
+ *
+ * @param trigger     Trigger name to fire.
+ * @param length      strlen(trigger).
+ * @param hash        Hash of the trigger name.
+ * @param data        Caller‑supplied data passed to callbacks.
+ */
+void ezcb_trigger_hashed(
+    const char* trigger,
+    size_t length,
+    uint32_t hash,
+    void* data
+);
+
+/**
+ * @brief Resolve a trigger name to a handle.
+ *
+ * Interns the trigger name (creating its entry if it does not exist yet)
+ * and returns a handle that can be passed to the *_h() variants. Resolving
+ * the same name again returns the same handle. The entry then stays until
+ * ezcb_deinit(), where other entries go with their last callback.
+ *
+ * @param trigger     Null‑terminated trigger name.
+ *
+ * @return Trigger handle, or NULL on allocation failure.
+ */
+ezcb_handle_t ezcb_resolve(
+    const char* trigger
+);
+
+/**
+ * @brief Register a callback for a resolved trigger.
+ *
+ * Same as ezcb_register(), but takes a handle from ezcb_resolve().
+ *
+ * @param handle      Trigger handle.
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ *
+ * @return 0 on success, negative value on allocation or insertion failure.
+ */
+int ezcb_register_h(
+    ezcb_handle_t handle,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Register a one‑shot callback for a resolved trigger.
+ *
+ * Same as ezcb_register_once(), but takes a handle from ezcb_resolve().
+ *
+ * @param handle      Trigger handle.
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ *
+ * @return 0 on success, negative value on allocation or insertion failure.
+ */
+int ezcb_register_once_h(
+    ezcb_handle_t handle,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Trigger all callbacks registered under a resolved trigger.
+ *
+ * Same as ezcb_trigger(), but takes a handle from ezcb_resolve() and
+ * dispatches directly to the trigger's callback list.
+ *
+ * @param handle      Trigger handle.
+ * @param data        Caller‑supplied data passed to callbacks.
+ */
+void ezcb_trigger_h(
+    ezcb_handle_t handle,
+    void* data
+);
+
+/**
+ * @brief Wait for in‑flight triggers to finish.
+ *
+ * Returns once every ezcb_trigger() call that was running when this
+ * function was entered has returned. With EZCB_LOCK_FREE_TRIGGER, a
+ * trigger already in progress may still invoke a callback that was just
+ * unregistered; call this before releasing the callback's context. Must
+ * not be called from within a callback.
+ */
+void ezcb_synchronize(void);
+
+/**
+ * @brief Pre-size the trigger table for a known load.
+ *
+ * Grows the table so that up to `triggers` distinct trigger names can be
+ * registered without a resize. With EZCB_LOCK_SHARDS the count is spread
+ * evenly over the shards. Freeing entries does not shrink a table below
+ * the reserved size, until ezcb_compact(). With EZCB_NO_MALLOC only checks
+ * the count against EZCB_MAX_TRIGGERS.
+ *
+ * @param triggers  Number of trigger names expected.
+ * @return 0 on success, -1 on allocation failure or too many triggers.
+ */
+int ezcb_reserve(
+    size_t triggers
+);
+
+/**
+ * @brief Give memory left over by past peaks back to the allocator.
+ *
+ * Trims each callback array to its length, shrinks tables to what their
+ * entries need and releases pool chunks that hold no live object, entries
+ * freed with their last callback included. Handles stay valid. Callback
+ * arrays and tables also shrink on their own as callbacks and entries are
+ * removed, a table not below the size ezcb_reserve() asked for; this
+ * packs them fully and drops that reservation. With
+ * EZCB_LOCK_FREE_TRIGGER, memory still waiting for readers to leave is
+ * not counted; call ezcb_synchronize() first to include it. Does nothing
+ * with EZCB_NO_MALLOC, whose static pools are always packed.
+ */
+void ezcb_compact(void);
+
+/**
+ * @brief Queue a trigger event from an ISR context.
+ *
+ * Adds a trigger event to the ISR‑safe queue. The event will be
+ * processed later by ezcb_dispatch(). Non‑blocking and safe for ISR use;
+ * any number of ISRs and threads may enqueue concurrently. Same as
+ * ezcb_trigger_isr_prio() with priority 0.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * @param trigger     Trigger name to enqueue.
+ * @param data        Caller‑supplied data pointer.
+ * 
+ * @return 0 on success, negative value if the queue is full.
+ */
+int  ezcb_trigger_isr(
+    const char* trigger,
+    void* data
+);
+
+/**
+ * @brief Queue a trigger event at a priority from an ISR context.
+ *
+ * Each of the EZCB_EVENT_PRIORITIES priorities has its own queue. The
+ * dispatch functions always take the next event from the highest
+ * priority that has one, so an event queued here overtakes every pending
+ * event of a lower priority; within a priority events stay in order.
+ * Priorities at or above EZCB_EVENT_PRIORITIES use the highest one.
+ * Non‑blocking and safe for ISR use.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * @param trigger     Trigger name to enqueue.
+ * @param data        Caller‑supplied data pointer.
+ * @param priority    Event priority (higher is dispatched first).
+ *
+ * @return 0 on success, negative value if that priority's queue is full.
+ */
+int  ezcb_trigger_isr_prio(
+    const char* trigger,
+    void* data,
+    uint8_t priority
+);
+
+/**
+ * @brief Queue a trigger event with a copy of its payload from an ISR context.
+ *
+ * Copies len bytes from buf into the instance's payload ring, next to the
+ * handle, so the caller's buffer can be reused as soon as this returns.
+ * When the event is dispatched, callbacks get a pointer to the copy,
+ * aligned to 8 bytes, as their data; it is valid until they return. The
+ * event goes to the handle's instance. Payload events are dispatched after
+ * the pointer events queued by ezcb_trigger_isr(), in their own order.
+ * Non‑blocking and safe for ISR use from any number of contexts.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * @param handle      Trigger handle from ezcb_resolve().
+ * @param buf         Payload to copy (may be NULL when len is 0).
+ * @param len         Payload size in bytes.
+ *
+ * @return 0 on success, negative value if the ring has no room for it.
+ */
+int  ezcb_trigger_isr_copy(
+    ezcb_handle_t handle,
+    const void* buf,
+    size_t len
+);
+
+/**
+ * @brief Queue a resolved trigger event from an ISR context.
+ *
+ * Same as ezcb_trigger_isr(), but takes a handle from ezcb_resolve(), so
+ * dispatch needs no lookup, and queues it for the handle's instance. With
+ * EZCB_ENABLE_COALESCING and a handle passed to ezcb_coalesce(), an event
+ * already pending for the handle takes the new data instead of a second
+ * slot. Non‑blocking and safe for ISR use.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * @param handle      Trigger handle.
+ * @param data        Caller‑supplied data pointer.
+ *
+ * @return 0 on success, negative value if the queue is full.
+ */
+int  ezcb_trigger_isr_h(
+    ezcb_handle_t handle,
+    void* data
+);
+
+/**
+ * @brief Make a trigger's deferred events coalesce.
+ * Define EZCB_ENABLE_COALESCING for implementation.
+ *
+ * While an event queued with ezcb_trigger_isr_h() or ezcb_post_h() on the
+ * handle is still pending, further ones only replace its data, so the
+ * callbacks run once with the latest data however often the trigger was
+ * queued in between. Events queued by name are not coalesced. With
+ * min_ticks, dispatch also waits until that many EZCB_TICKS() have passed
+ * since the trigger's last coalesced run and keeps the event pending until
+ * then; ezcb_post_h() has no interval. Call it right after resolving,
+ * before the handle is queued.
+ *
+ * @param handle      Trigger handle.
+ * @param min_ticks   Minimum EZCB_TICKS() between dispatched runs, or 0.
+ */
+void ezcb_coalesce(
+    ezcb_handle_t handle,
+    uint32_t min_ticks
+);
+
+/**
+ * @brief Dispatch queued ISR trigger events.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * Processes all pending events queued by ezcb_trigger_isr() and then
+ * those queued by ezcb_trigger_isr_copy(). Should be called from the main
+ * loop or a safe execution context, and from only one context at a time
+ * (the queues have a single consumer).
+ */
+void ezcb_dispatch(void);
+
+/**
+ * @brief Dispatch queued ISR trigger events in batches.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * Takes up to max_events pending events (at most EZCB_EVENT_QUEUE_SIZE)
+ * off the queue and groups them by trigger. Each distinct trigger is
+ * looked up once, or not at all when one of its events was queued with
+ * ezcb_trigger_isr_h(), and its callbacks run over the whole group: a batch
+ * callback is called once with every payload, a plain callback once per
+ * payload. A payload stopped by a plain callback is not passed to the
+ * callbacks after it; EZCB_STOP from a batch callback ends the group.
+ *
+ * Callbacks see events in order within a trigger, but each callback runs
+ * over the whole group before the next one starts. Events queued by
+ * ezcb_trigger_isr_copy() count toward max_events too and are taken once
+ * the pointer events run out; a run of them on the same handle is one
+ * group.
+ *
+ * @param max_events  Maximum number of events to take off the queue.
+ *
+ * @return Number of events dispatched.
+ */
+size_t ezcb_dispatch_batch(
+    size_t max_events
+);
+
+/**
+ * @brief Dispatch queued ISR trigger events within a budget.
+ * Define EZCB_ENABLE_ISR for implementation.
+ *
+ * Dispatches events one by one, highest priority first, until none is
+ * left, max_events have run or max_ticks of EZCB_TICKS() have passed
+ * since the call began. The clock is read after each event, so at least
+ * one pending event runs and a slow callback can overrun the budget.
+ * Events queued by ezcb_trigger_isr_copy() come after those of every
+ * priority. Same single-consumer rule as ezcb_dispatch().
+ *
+ * @param max_events  Maximum number of events to dispatch.
+ * @param max_ticks   Time budget in EZCB_TICKS() units, or 0 for none.
+ *
+ * @return Number of events dispatched.
+ */
+size_t ezcb_dispatch_budget(
+    size_t max_events,
+    uint32_t max_ticks
+);
+
+/****************************************************************
+ * Executor
+ ****************************************************************/
+
+/**
+ * @brief Start a pool of worker threads for ezcb_post().
+ * Define EZCB_ENABLE_EXECUTOR for implementation.
+ *
+ * Each worker owns a queue of EZCB_EXECUTOR_QUEUE_SIZE posted triggers
+ * and, once its own queue is empty, takes work from its peers. Start the
+ * pool before other threads post, and stop it after they are done.
+ *
+ * @param workers  Number of worker threads (at least 1).
+ *
+ * @return 0 on success, negative value if already running or on failure.
+ */
+int ezcb_executor_start(
+    size_t workers
+);
+
+/**
+ * @brief Run every queued trigger, then stop and join the workers.
+ * Define EZCB_ENABLE_EXECUTOR for implementation.
+ *
+ * ezcb_post() fails from the moment this is called. Must not be called
+ * from a callback. ezcb_deinit() stops a running pool itself.
+ */
+void ezcb_executor_stop(void);
+
+/**
+ * @brief Wait until every posted trigger has finished running.
+ * Define EZCB_ENABLE_EXECUTOR for implementation.
+ *
+ * Must not be called from a callback run by the pool.
+ */
+void ezcb_executor_wait(void);
+
+/**
+ * @brief Trigger asynchronously on the executor.
+ * Define EZCB_ENABLE_EXECUTOR for implementation.
+ *
+ * Queues the trigger on the calling thread's queue (its own, for a
+ * worker) and returns; a worker fires it later as ezcb_trigger() would.
+ * Triggers posted from one thread usually run in order, but an idle
+ * worker may steal and run a later one first. The trigger string must
+ * stay valid until it has run.
+ *
+ * @param trigger     Trigger name to fire.
+ * @param data        Caller‑supplied data passed to callbacks.
+ *
+ * @return 0 on success, negative value if no pool is running or every
+ *         queue is full.
+ */
+int ezcb_post(
+    const char* trigger,
+    void* data
+);
+
+/**
+ * @brief Trigger a resolved trigger asynchronously on the executor.
+ * Define EZCB_ENABLE_EXECUTOR for implementation.
+ *
+ * Same as ezcb_post(), but takes a handle from ezcb_resolve() and uses the
+ * executor of the handle's instance. A handle passed to ezcb_coalesce()
+ * updates its task still waiting in the queue instead of adding one.
+ *
+ * @param handle      Trigger handle.
+ * @param data        Caller‑supplied data passed to callbacks.
+ *
+ * @return 0 on success, negative value if no pool is running or every
+ *         queue is full.
+ */
+int ezcb_post_h(
+    ezcb_handle_t handle,
+    void* data
+);
+
+/**
+ * @brief Register a callback that runs on the executor next to its peers.
+ * Define EZCB_ENABLE_EXECUTOR and EZCB_LOCK_FREE_TRIGGER for implementation.
+ *
+ * Same as ezcb_register(), but while a pool is running, consecutive
+ * parallel callbacks of one priority run as a group, spread over the
+ * workers and the triggering thread in no particular order. With join,
+ * the trigger waits for the whole group before it runs lower
+ * priorities, and an EZCB_STOP from any of them stops those. Without
+ * join, the trigger moves on at once and their results are ignored;
+ * ezcb_executor_wait() waits for them, and data and ctx must stay valid
+ * until then. Joined and unjoined callbacks form separate groups.
+ * Without a pool, or for several payloads from ezcb_dispatch_batch(),
+ * they run in order on the calling thread like any other callback.
+ *
+ * @param trigger     Null‑terminated trigger name.
+ * @param priority    Execution priority (higher runs first).
+ * @param fn          Callback function pointer.
+ * @param ctx         User‑supplied context pointer passed to the callback.
+ * @param join        Whether the trigger waits for the callback.
+ *
+ * @return 0 on success, negative value on allocation or insertion failure.
+ */
+int ezcb_register_parallel(
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool join
+);
+
+/****************************************************************
+ * Statistics
+ ****************************************************************/
+
+/**
+ * @brief Dispatcher-wide statistics, filled in by ezcb_stats_get().
+ *
+ * Counters are 32-bit and wrap. The average callback chain walked per
+ * fire is chain_total / fires.
+ */
+typedef struct ezcb_stats
+{
+    uint32_t triggers;          /* Interned trigger names */
+    uint32_t callbacks;         /* Registered callbacks */
+    uint32_t fires;             /* Payloads delivered to a trigger with callbacks walked */
+    uint32_t invocations;       /* Callback calls */
+    uint32_t chain_max;         /* Longest callback chain walked by one fire */
+    uint32_t chain_total;       /* Callback records walked, summed over all fires */
+    uint32_t resizes;           /* Table resizes */
+    uint32_t bucket_max;        /* Longest bucket chain (probe sequence with EZCB_OPEN_ADDRESSING) right now */
+    uint32_t queue_high_water;  /* Most events seen pending in one priority's ISR queue */
+    uint32_t queue_drops;       /* ezcb_trigger_isr*() calls rejected on a full queue */
+} ezcb_stats_t;
+
+/**
+ * @brief Per-trigger statistics, passed to an ezcb_stats_fn_t.
+ */
+typedef struct ezcb_trigger_stats
+{
+    uint32_t fires;
+    uint32_t invocations;
+    uint32_t chain_max;
+    uint32_t chain_total;
+} ezcb_trigger_stats_t;
+
+/**
+ * @brief Visitor for ezcb_stats_foreach().
+ *
+ * @param ctx      User pointer passed to ezcb_stats_foreach().
+ * @param trigger  Trigger name.
+ * @param stats    Counters for that trigger.
+ */
+typedef void (*ezcb_stats_fn_t)(
+    void* ctx,
+    const char* trigger,
+    const ezcb_trigger_stats_t* stats
+);
+
+/**
+ * @brief Dispatch hook, called before and after a trigger's callbacks run.
+ *
+ * @param ctx      User pointer passed to ezcb_set_hooks().
+ * @param trigger  Trigger name being dispatched.
+ * @param n        Number of payloads dispatched (1 unless batched).
+ */
+typedef void (*ezcb_hook_fn_t)(
+    void* ctx,
+    const char* trigger,
+    size_t n
+);
+
+/**
+ * @brief Read the dispatcher-wide statistics.
+ * Define EZCB_ENABLE_STATS for implementation.
+ *
+ * Per-trigger counters are summed and the table is scanned for its
+ * longest bucket, so this costs a walk over every trigger.
+ *
+ * @param out  Receives the statistics.
+ */
+void ezcb_stats_get(
+    ezcb_stats_t* out
+);
+
+/**
+ * @brief Visit every trigger with its statistics.
+ * Define EZCB_ENABLE_STATS for implementation.
+ *
+ * The visitor runs with the dispatcher locked and must not register or
+ * unregister callbacks.
+ *
+ * @param fn   Visitor function.
+ * @param ctx  User pointer passed to the visitor.
+ */
+void ezcb_stats_foreach(
+    ezcb_stats_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Reset all statistics counters to zero.
+ * Define EZCB_ENABLE_STATS for implementation.
+ */
+void ezcb_stats_reset(void);
+
+/**
+ * @brief Install pre/post-dispatch hooks.
+ * Define EZCB_ENABLE_STATS for implementation.
+ *
+ * pre runs before a trigger's callbacks and post after them, for every
+ * ezcb_trigger(), ezcb_trigger_h() and each group of ezcb_dispatch_batch().
+ * Either may be NULL. Set hooks before triggers start firing on other
+ * threads.
+ *
+ * @param pre   Hook called before the callbacks, or NULL.
+ * @param post  Hook called after the callbacks, or NULL.
+ * @param ctx   User pointer passed to both hooks.
+ */
+void ezcb_set_hooks(
+    ezcb_hook_fn_t pre,
+    ezcb_hook_fn_t post,
+    void* ctx
+);
+
+typedef struct ezcb_latency ezcb_latency_t;
+
+#ifdef EZCB_ENABLE_LATENCY
+/**
+ * @brief Log-bucketed latency histogram, in EZCB_TICKS().
+ *
+ * Values below 2^EZCB_LATENCY_PRECISION each have a bucket; above that,
+ * every power of two is split into 2^EZCB_LATENCY_PRECISION buckets, so
+ * a bucket is never wider than 1/2^EZCB_LATENCY_PRECISION of its values.
+ * ezcb_latency_bound() gives the lowest value of a bucket.
+ */
+struct ezcb_latency
+{
+    uint32_t count;             /* Samples */
+    uint32_t max;               /* Largest sample */
+    uint32_t buckets[EZCB_LATENCY_BUCKETS];
+};
+#endif  /* EZCB_ENABLE_LATENCY */
+
+/**
+ * @brief Visitor for ezcb_latency_foreach().
+ *
+ * @param ctx      User pointer passed to ezcb_latency_foreach().
+ * @param trigger  Trigger name.
+ * @param latency  Time its fires took, from the first callback's start to
+ *                 the last one's return.
+ */
+typedef void (*ezcb_latency_fn_t)(
+    void* ctx,
+    const char* trigger,
+    const ezcb_latency_t* latency
+);
+
+/**
+ * @brief Callback timing hook, called after each callback has run.
+ *
+ * @param ctx      User pointer passed to ezcb_set_callback_hook().
+ * @param trigger  Trigger name being dispatched.
+ * @param fn       The callback (cast to ezcb_fn_t for a batch callback).
+ * @param cb_ctx   The callback's context.
+ * @param start    EZCB_TICKS() when it was called.
+ * @param ticks    How long it ran, over every payload of the fire.
+ */
+typedef void (*ezcb_cb_hook_fn_t)(
+    void* ctx,
+    const char* trigger,
+    ezcb_fn_t fn,
+    void* cb_ctx,
+    uint32_t start,
+    uint32_t ticks
+);
+
+/**
+ * @brief Visit every trigger that has fired with its latency histogram.
+ * Define EZCB_ENABLE_LATENCY for implementation.
+ *
+ * Each fire adds one sample, read with two EZCB_TICKS() calls: a single
+ * payload, or one group of ezcb_dispatch_batch(). The visitor runs with
+ * the dispatcher locked and must not register or unregister callbacks.
+ * ezcb_stats_reset() clears the histograms.
+ *
+ * @param fn   Visitor function.
+ * @param ctx  User pointer passed to the visitor.
+ */
+void ezcb_latency_foreach(
+    ezcb_latency_fn_t fn,
+    void* ctx
+);
+
+/**
+ * @brief Read how long deferred events waited in the ISR queues.
+ * Define EZCB_ENABLE_LATENCY and EZCB_ENABLE_ISR for implementation.
+ *
+ * A sample runs from an ezcb_trigger_isr*() call to the dispatcher taking
+ * the event, over pointer and payload events alike. Producers read
+ * EZCB_TICKS() too, so it must be safe to call from an ISR.
+ *
+ * @param out  Receives the histogram.
+ */
+void ezcb_latency_queue(
+    ezcb_latency_t* out
+);
+
+/**
+ * @brief Install a hook timing every callback.
+ * Define EZCB_ENABLE_LATENCY for implementation.
+ *
+ * While a hook is installed, two more EZCB_TICKS() calls bracket each
+ * callback; pass NULL to remove it. Keep an ezcb_latency_t per callback
+ * with ezcb_latency_add() to find slow subscribers, or emit each call as
+ * a trace event. Set it before triggers start firing on other threads.
+ *
+ * @param hook  Hook, or NULL.
+ * @param ctx   User pointer passed to the hook.
+ */
+void ezcb_set_callback_hook(
+    ezcb_cb_hook_fn_t hook,
+    void* ctx
+);
+
+/**
+ * @brief Add a sample to a histogram.
+ * Define EZCB_ENABLE_LATENCY for implementation.
+ *
+ * Not atomic: a histogram shared between threads needs a lock.
+ *
+ * @param h      Histogram.
+ * @param ticks  Sample.
+ */
+void ezcb_latency_add(
+    ezcb_latency_t* h,
+    uint32_t ticks
+);
+
+/**
+ * @brief Lowest value counted by a histogram bucket.
+ * Define EZCB_ENABLE_LATENCY for implementation.
+ *
+ * @param bucket  Bucket index, below EZCB_LATENCY_BUCKETS.
+ */
+uint32_t ezcb_latency_bound(
+    size_t bucket
+);
+
+/**
+ * @brief Estimate a percentile of a histogram.
+ * Define EZCB_ENABLE_LATENCY for implementation.
+ *
+ * @param h  Histogram.
+ * @param q  Fraction of samples at or below the result, 0.0 to 1.0.
+ *
+ * @return The highest value of the bucket holding that sample, capped
+ *         at the largest sample; 0 for an empty histogram.
+ */
+uint32_t ezcb_latency_percentile(
+    const ezcb_latency_t* h,
+    double q
+);
+
+/****************************************************************
+ * Instance API
+ ****************************************************************/
+
+/**
+ * @brief Create an independent dispatcher instance.
+ *
+ * The instance is initialized and ready for use. With EZCB_NO_MALLOC it
+ * comes from a static pool of EZCB_MAX_CONTEXTS instances; in that mode,
+ * ezcb_create() and ezcb_destroy() must not race with each other.
+ *
+ * @return New instance, or NULL on allocation failure or an exhausted pool.
+ */
+ezcb_ctx_t* ezcb_create(void);
+
+/**
+ * @brief Destroy an instance created by ezcb_create().
+ *
+ * Releases everything ezcb_deinit() would for the default instance, then
+ * the instance itself. Its handles become invalid.
+ *
+ * @param inst  Instance to destroy.
+ */
+void ezcb_destroy(
+    ezcb_ctx_t* inst
+);
+
+/**
+ * @brief Instance variants of the functions above.
+ *
+ * Each behaves like the function of the same name without the _ex suffix,
+ * applied to inst instead of the default instance.
+ */
+int ezcb_register_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+int ezcb_register_once_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+int ezcb_register_batch_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_batch_fn_t fn,
+    void* ctx
+);
+
+int ezcb_unregister_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+int ezcb_unregister_batch_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    ezcb_batch_fn_t fn,
+    void* ctx
+);
+
+int ezcb_register_many_ex(
+    ezcb_ctx_t* inst,
+    const ezcb_reg_t* regs,
+    size_t n
+);
+
+int ezcb_unregister_many_ex(
+    ezcb_ctx_t* inst,
+    const ezcb_reg_t* regs,
+    size_t n
+);
+
+size_t ezcb_snapshot_ex(
+    ezcb_ctx_t* inst,
+    void* buf,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+);
+
+int ezcb_restore_ex(
+    ezcb_ctx_t* inst,
+    const void* blob,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+);
+
+/* Define EZCB_ENABLE_REVERSE_INDEX for implementation */
+ezcb_token_t ezcb_register_token_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/* Define EZCB_ENABLE_PATTERNS for implementation */
+int ezcb_register_pattern_ex(
+    ezcb_ctx_t* inst,
+    const char* pattern,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+/* Define EZCB_ENABLE_PATTERNS for implementation */
+int ezcb_unregister_pattern_ex(
+    ezcb_ctx_t* inst,
+    const char* pattern,
+    ezcb_fn_t fn,
+    void* ctx
+);
+
+void ezcb_trigger_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+);
+
+void ezcb_trigger_hashed_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    size_t length,
+    uint32_t hash,
+    void* data
+);
+
+ezcb_handle_t ezcb_resolve_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger
+);
+
+void ezcb_synchronize_ex(
+    ezcb_ctx_t* inst
+);
+
+int ezcb_reserve_ex(
+    ezcb_ctx_t* inst,
+    size_t triggers
+);
+
+void ezcb_compact_ex(
+    ezcb_ctx_t* inst
+);
+
+/* Define EZCB_ENABLE_ISR for implementation */
+int ezcb_trigger_isr_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+);
+
+/* Define EZCB_ENABLE_ISR for implementation */
+int ezcb_trigger_isr_prio_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data,
+    uint8_t priority
+);
+
+/* Define EZCB_ENABLE_ISR for implementation */
+void ezcb_dispatch_ex(
+    ezcb_ctx_t* inst
+);
+
+/* Define EZCB_ENABLE_ISR for implementation */
+size_t ezcb_dispatch_batch_ex(
+    ezcb_ctx_t* inst,
+    size_t max_events
+);
+
+/* Define EZCB_ENABLE_ISR for implementation */
+size_t ezcb_dispatch_budget_ex(
+    ezcb_ctx_t* inst,
+    size_t max_events,
+    uint32_t max_ticks
+);
+
+/* Define EZCB_ENABLE_EXECUTOR for implementation */
+int ezcb_executor_start_ex(
+    ezcb_ctx_t* inst,
+    size_t workers
+);
+
+/* Define EZCB_ENABLE_EXECUTOR for implementation */
+void ezcb_executor_stop_ex(
+    ezcb_ctx_t* inst
+);
+
+/* Define EZCB_ENABLE_EXECUTOR for implementation */
+void ezcb_executor_wait_ex(
+    ezcb_ctx_t* inst
+);
+
+/* Define EZCB_ENABLE_EXECUTOR for implementation */
+int ezcb_post_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+);
+
+/* Define EZCB_ENABLE_EXECUTOR and EZCB_LOCK_FREE_TRIGGER for implementation */
+int ezcb_register_parallel_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool join
+);
+
+/* Define EZCB_ENABLE_STATS for implementation */
+void ezcb_stats_get_ex(
+    ezcb_ctx_t* inst,
+    ezcb_stats_t* out
+);
+
+/* Define EZCB_ENABLE_STATS for implementation */
+void ezcb_stats_foreach_ex(
+    ezcb_ctx_t* inst,
+    ezcb_stats_fn_t fn,
+    void* ctx
+);
+
+/* Define EZCB_ENABLE_STATS for implementation */
+void ezcb_stats_reset_ex(
+    ezcb_ctx_t* inst
+);
+
+/* Define EZCB_ENABLE_STATS for implementation */
+void ezcb_set_hooks_ex(
+    ezcb_ctx_t* inst,
+    ezcb_hook_fn_t pre,
+    ezcb_hook_fn_t post,
+    void* ctx
+);
+
+/* Define EZCB_ENABLE_LATENCY for implementation */
+void ezcb_latency_foreach_ex(
+    ezcb_ctx_t* inst,
+    ezcb_latency_fn_t fn,
+    void* ctx
+);
+
+/* Define EZCB_ENABLE_LATENCY and EZCB_ENABLE_ISR for implementation */
+void ezcb_latency_queue_ex(
+    ezcb_ctx_t* inst,
+    ezcb_latency_t* out
+);
+
+/* Define EZCB_ENABLE_LATENCY for implementation */
+void ezcb_set_callback_hook_ex(
+    ezcb_ctx_t* inst,
+    ezcb_cb_hook_fn_t hook,
+    void* ctx
+);
+
+#endif  /* EZCB_H */
+
+/****************************************************************
+ * Implementation
+ ****************************************************************/
+#ifdef EZCB_IMPLEMENTATION
+
+#include <string.h>
+/* Little-endian cores where a word load from any address is cheap */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86) || \
+    ((defined(__aarch64__) || defined(__ARM_FEATURE_UNALIGNED)) && \
+     defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    #define EZCB_UNALIGNED_LE
+#endif
+#ifndef EZCB_NO_SIMD
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define EZCB_SSE2
+        #include <emmintrin.h>
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define EZCB_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+#ifndef EZCB_NO_MALLOC
+    #include <stdlib.h>
+
+    #ifndef EZCB_MALLOC
+        #define EZCB_MALLOC(n)          malloc(n)
+        #define EZCB_REALLOC(p, n)      realloc((p), (n))
+        #define EZCB_FREE(p)            free(p)
+    #endif
+#endif
+
+#ifdef EZCB_THREAD_SAFE
+    #include <threads.h>
+
+    #if defined(__SANITIZE_THREAD__)
+        #define EZCB_TSAN
+    #elif defined(__has_feature)
+        #if __has_feature(thread_sanitizer)
+            #define EZCB_TSAN
+        #endif
+    #endif
+
+    /* ThreadSanitizer does not intercept glibc's C11 mutexes, so it gets recursive pthread ones */
+    #if defined(EZCB_TSAN) && !defined(EZCB_MUTEX_T)
+        #include <pthread.h>
+
+        #define EZCB_MUTEX_T            pthread_mutex_t
+        #define EZCB_MUTEX_INIT(m)      ezcb_pthread_mutex_init(&(m))
+        #define EZCB_MUTEX_LOCK(m)      pthread_mutex_lock(&(m))
+        #define EZCB_MUTEX_UNLOCK(m)    pthread_mutex_unlock(&(m))
+        #define EZCB_MUTEX_DESTROY(m)   pthread_mutex_destroy(&(m))
+
+static inline void ezcb_pthread_mutex_init(
+    pthread_mutex_t* m
+)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+    #endif
+
+    #ifndef EZCB_MUTEX_T
+        #define EZCB_MUTEX_T            mtx_t
+    #endif
+    #ifndef EZCB_MUTEX_INIT
+        #define EZCB_MUTEX_INIT(m)      mtx_init(&(m), mtx_plain | mtx_recursive)
+    #endif
+    #ifndef EZCB_MUTEX_LOCK
+        #define EZCB_MUTEX_LOCK(m)      mtx_lock(&(m))
+    #endif
+    #ifndef EZCB_MUTEX_UNLOCK
+        #define EZCB_MUTEX_UNLOCK(m)    mtx_unlock(&(m))
+    #endif
+    #ifndef EZCB_MUTEX_DESTROY
+        #define EZCB_MUTEX_DESTROY(m)   mtx_destroy(&(m))
+    #endif
+#else
+    #define EZCB_MUTEX_INIT(m)
+    #define EZCB_MUTEX_LOCK(m)
+    #define EZCB_MUTEX_UNLOCK(m)
+    #define EZCB_MUTEX_DESTROY(m)
+#endif
+
+/* Each shard has its own mutex and table; a trigger name maps to one shard */
+#ifdef EZCB_LOCK_SHARDS
+    #define EZCB_SHARDS             EZCB_LOCK_SHARDS
+#else
+    #define EZCB_SHARDS             1
+#endif
+
+/*
+ * Fields read by lock-free triggers. Writers publish with release stores
+ * while holding the shard mutex; readers pair them with acquire loads.
+ */
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    #include <stdatomic.h>
+
+    #define EZCB_ATOMIC(T)          _Atomic(T)
+    #define EZCB_LOAD(x)            atomic_load_explicit(&(x), memory_order_acquire)
+    #define EZCB_STORE(x, v)        atomic_store_explicit(&(x), (v), memory_order_release)
+#else
+    #define EZCB_ATOMIC(T)          T
+    #define EZCB_LOAD(x)            (x)
+    #define EZCB_STORE(x, v)        ((x) = (v))
+#endif
+
+/*
+ * Statistics counters. Lock-free triggers update them concurrently, so
+ * they become relaxed atomics there; otherwise the shard mutex covers them.
+ */
+#ifdef EZCB_ENABLE_STATS
+    #ifdef EZCB_LOCK_FREE_TRIGGER
+        #define EZCB_STAT_ADD(x, v)     atomic_fetch_add_explicit(&(x), (v), memory_order_relaxed)
+        #define EZCB_STAT_GET(x)        atomic_load_explicit(&(x), memory_order_relaxed)
+        #define EZCB_STAT_SET(x, v)     atomic_store_explicit(&(x), (v), memory_order_relaxed)
+    #else
+        #define EZCB_STAT_ADD(x, v)     ((x) += (v))
+        #define EZCB_STAT_GET(x)        (x)
+        #define EZCB_STAT_SET(x, v)     ((x) = (v))
+    #endif
+#endif
+
+#ifdef EZCB_ENABLE_EXECUTOR
+    #include <stdatomic.h>
+#endif
+
+#ifdef EZCB_ENABLE_ISR
+    #include <stdatomic.h>
+
+    #if EZCB_EVENT_INDEX_BITS == 8
+        typedef uint8_t ezcb_evt_idx_t;
+    #elif EZCB_EVENT_INDEX_BITS == 16
+        typedef uint16_t ezcb_evt_idx_t;
+    #elif EZCB_EVENT_INDEX_BITS == 32
+        typedef uint32_t ezcb_evt_idx_t;
+    #else
+        typedef uint64_t ezcb_evt_idx_t;
+    #endif
+
+    #define EZCB_EVT_MASK           ((ezcb_evt_idx_t)(EZCB_EVENT_QUEUE_SIZE - 1))
+    #define EZCB_EVT_HALF           ((ezcb_evt_idx_t)((ezcb_evt_idx_t)1 << (EZCB_EVENT_INDEX_BITS - 1)))
+#endif
+
+#if (defined(EZCB_ENABLE_ISR) || defined(EZCB_ENABLE_LATENCY)) && !defined(EZCB_TICKS)
+    #include <time.h>
+
+    #define EZCB_TICKS()            ezcb_ticks()
+    #define EZCB_DEFAULT_TICKS
+#endif
+
+/****************************************************************
  * Internal structures
  ****************************************************************/
 
-typedef struct ezcb_node ezcb_node_t;
-typedef struct ezcb_node
+#ifndef EZCB_NO_MALLOC
+/* Header of a pool chunk; the objects follow it, suitably aligned */
+typedef union ezcb_chunk ezcb_chunk_t;
+typedef union ezcb_chunk
+{
+    struct
+    {
+        ezcb_chunk_t* next;
+        size_t objects;         /* Objects the chunk was carved into */
+    } hdr;
+    long double align_ld;       /* max_align_t is C11; these cover it in practice */
+    long long align_ll;
+    void (*align_fn)(void);
+} ezcb_chunk_t;
+
+/*
+ * Fixed-size object pool. Objects are carved from chunks that double in
+ * size as the pool grows, and freed ones are reused through a free list
+ * linked through their first word. Chunks go back to the allocator when
+ * the pool is cleared, or when ezcb_pool_trim() finds all their objects free.
+ */
+typedef struct ezcb_pool
+{
+    void* free;
+    ezcb_chunk_t* chunks;
+    char* bump;                 /* Unused tail of the newest chunk */
+    char* end;
+    size_t size;                /* Object size */
+    size_t grow;                /* Objects in the next chunk */
+} ezcb_pool_t;
+#endif  /* EZCB_NO_MALLOC */
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+/* Header of objects whose release is deferred until readers have left */
+typedef struct ezcb_rcu_head ezcb_rcu_head_t;
+typedef struct ezcb_rcu_head
+{
+    ezcb_rcu_head_t* next;
+    ezcb_pool_t* pool;          /* Pool to return the object to, or NULL if allocated directly */
+    unsigned epoch;
+} ezcb_rcu_head_t;
+
+/* Per-registration state shared by every snapshot holding the callback */
+typedef struct ezcb_cell
+{
+    ezcb_rcu_head_t head;
+    atomic_bool dead;
+} ezcb_cell_t;
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+/* One ezcb_register_pattern() callback; matching entries hold a copy of it */
+typedef struct ezcb_sub ezcb_sub_t;
+
+#ifdef EZCB_ENABLE_PATTERNS
+typedef struct ezcb_sub
+{
+    ezcb_sub_t* next;
+    ezcb_fn_t fn;
+    void* ctx;
+    uint8_t priority;
+    bool dead;                  /* Unregistered; its copies are being swept */
+} ezcb_sub_t;
+
+/* A pattern callback gathered for a trigger that has no entry */
+typedef struct ezcb_pmatch
+{
+    ezcb_sub_t* sub;            /* Only compared, it may be freed meanwhile */
+    ezcb_fn_t fn;
+    void* ctx;
+    uint8_t priority;
+} ezcb_pmatch_t;
+
+typedef struct ezcb_pgather
+{
+    ezcb_pmatch_t* buf;
+    size_t cap;
+    size_t count;               /* Matches seen, stored or not */
+} ezcb_pgather_t;
+
+/* Pattern trie node for one segment; siblings are chained through next */
+typedef struct ezcb_pnode ezcb_pnode_t;
+typedef struct ezcb_pnode
+{
+    ezcb_pnode_t* child;
+    ezcb_pnode_t* next;
+    ezcb_sub_t* subs;           /* Callbacks of the pattern ending here */
+    size_t len;
+    char seg[];
+} ezcb_pnode_t;
+#endif  /* EZCB_ENABLE_PATTERNS */
+
+/* Callback record flags */
+#define EZCB_CB_ONCE                0x01
+#define EZCB_CB_BATCH               0x02    /* fn was cast from an ezcb_batch_fn_t */
+#define EZCB_CB_DEAD                0x04    /* Removed while the entry was being walked */
+#define EZCB_CB_PARALLEL            0x08    /* May run on the executor with its peers */
+#define EZCB_CB_DETACHED            0x10    /* Parallel, and the trigger does not wait for it */
+
+/* One callback record, as registering and removing pass it around */
+typedef struct ezcb_cb
+{
+    ezcb_fn_t fn;
+    void* ctx;
+    uint8_t priority;
+    uint8_t flags;              /* EZCB_CB_*; lock-free, deaths go to the cell instead */
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_cell_t* cell;
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    uint32_t id;                /* Token id, unique within the shard */
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    ezcb_sub_t* sub;            /* Pattern callback this is a copy of, or NULL */
+#endif
+} ezcb_cb_t;
+
+/* The part of a record a walk calls through */
+typedef struct ezcb_call
+{
+    ezcb_fn_t fn;
+    void* ctx;
+} ezcb_call_t;
+
+#if defined(EZCB_ENABLE_REVERSE_INDEX) || defined(EZCB_ENABLE_PATTERNS)
+#define EZCB_CB_META
+/* The part only registering and removing read */
+typedef struct ezcb_meta
+{
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    uint32_t id;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    ezcb_sub_t* sub;
+#endif
+} ezcb_meta_t;
+#endif  /* EZCB_ENABLE_REVERSE_INDEX || EZCB_ENABLE_PATTERNS */
+
+/*
+ * An entry stores its records one column per field, all sorted alike by
+ * descending priority, so a walk reads 16-byte fn/ctx pairs and a flag
+ * byte per record and none of the metadata. Dynamic mode keeps the
+ * columns of an entry back to back in one block; static mode slices the
+ * instance's columns.
+ */
+typedef struct ezcb_cols
+{
+    ezcb_call_t* calls;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_cell_t** cells;
+#endif
+#ifdef EZCB_CB_META
+    ezcb_meta_t* meta;          /* NULL in a snapshot */
+#endif
+    uint8_t* keys;              /* Priorities */
+    uint8_t* flags;
+} ezcb_cols_t;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+/* Immutable copy of an entry's records, without their metadata, read without the lock */
+typedef struct ezcb_snap
+{
+    ezcb_rcu_head_t head;
+    size_t count;
+    ezcb_call_t calls[];        /* First column of count records */
+} ezcb_snap_t;
+
+#define EZCB_SNAP_POOLED            4
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_ENABLE_STATS
+typedef struct ezcb_entry_stats
+{
+    EZCB_ATOMIC(uint32_t) fires;
+    EZCB_ATOMIC(uint32_t) invocations;
+    EZCB_ATOMIC(uint32_t) chain_max;
+    EZCB_ATOMIC(uint32_t) chain_total;
+#ifdef EZCB_ENABLE_LATENCY
+    EZCB_ATOMIC(uint32_t) latency_max;
+    EZCB_ATOMIC(uint32_t) latency[EZCB_LATENCY_BUCKETS];
+#endif
+} ezcb_entry_stats_t;
+#endif  /* EZCB_ENABLE_STATS */
+
+typedef struct ezcb_entry ezcb_entry_t;
+#ifdef EZCB_ENABLE_COALESCING
+/*
+ * Coalescing state of an entry. A producer stores its data, then sets the
+ * pending flag; only the one that finds it clear queues an event. Taking
+ * the event clears the flag before reading the data, so data stored after
+ * that queues a new event.
+ */
+typedef struct ezcb_coalesce
+{
+    bool on;
+#ifdef EZCB_ENABLE_ISR
+    _Atomic(bool) isr_pending;
+    _Atomic(void*) isr_data;
+    uint32_t interval;          /* Minimum ticks between runs, or 0 */
+    uint32_t last;              /* When it last ran (dispatcher only) */
+    bool ran;
+    struct ezcb_entry* waiting; /* Next entry held back by its interval */
+#endif
+#ifdef EZCB_ENABLE_EXECUTOR
+    _Atomic(bool) post_pending;
+    _Atomic(void*) post_data;
+#endif
+} ezcb_coalesce_t;
+#endif  /* EZCB_ENABLE_COALESCING */
+
+typedef struct ezcb_entry
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_rcu_head_t head;       /* Freed entries are retired, as readers may still be on them */
+#endif
+#ifdef EZCB_NO_MALLOC
+    char trigger[EZCB_MAX_TRIGGER_LENGTH];
+#else
+    char* trigger;              /* name, or a separate copy if too long for it */
+#endif
+    uint32_t hash;
+    uint32_t len;               /* strlen(trigger), compared before any byte */
+#ifdef EZCB_NO_MALLOC
+    size_t first;               /* Start of its records in the instance's columns */
+#else
+    void* cbs;                  /* Record columns, see ezcb_cols() */
+#endif
+    size_t count;
+    bool pinned;                /* A handle to it was handed out, so it lives until ezcb_deinit() */
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    size_t live;                /* Sorted prefix of the records; the rest was added mid-walk */
+    unsigned firing;            /* Walks in progress (nested triggers) */
+    bool dirty;                 /* Dead or unsorted records await ezcb_entry_settle() */
+#endif
+#ifndef EZCB_NO_MALLOC
+    size_t capacity;
+#endif
+#ifdef EZCB_STATIC_HANDLERS
+    const ezcb_static_t** statics;  /* Slice of ezcb_static_order, sorted like the records */
+    size_t nstatics;
+#endif
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    EZCB_ATOMIC(ezcb_snap_t*) snap;
+    ezcb_rcu_head_t* zombies;   /* Removed cells still held by the snapshot */
+#endif
+#ifdef EZCB_ENABLE_STATS
+    ezcb_entry_stats_t stats;
+#endif
+#ifdef EZCB_ENABLE_COALESCING
+    ezcb_coalesce_t coalesce;
+#endif
+    struct ezcb_shard* shard;   /* Shard, and through it the dispatcher, holding the entry */
+#ifndef EZCB_OPEN_ADDRESSING
+    EZCB_ATOMIC(ezcb_entry_t*) next;
+#endif
+#ifndef EZCB_NO_MALLOC
+    char name[EZCB_INLINE_TRIGGER_LENGTH];  /* Holds the trigger when it fits */
+#endif
+} ezcb_entry_t;
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+/*
+ * Reverse index link: how many records of entry e have this fn, or this
+ * ctx (fn NULL then). The links of one fn or ctx hang off a head link
+ * whose e is NULL, so a wildcard unregister only visits their entries.
+ */
+typedef struct ezcb_ref ezcb_ref_t;
+typedef struct ezcb_ref
+{
+    ezcb_ref_t* next;           /* Bucket chain */
+    ezcb_ref_t* sib;            /* Next link of the same owner; a head's first */
+    ezcb_ref_t** pprev;         /* Whatever points to this link through sib */
+    ezcb_fn_t fn;
+    void* ctx;
+    ezcb_entry_t* e;
+    size_t count;               /* Records, or links for a head */
+} ezcb_ref_t;
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+#ifdef EZCB_OPEN_ADDRESSING
+/*
+ * SwissTable-style index: one control byte per slot holds 7 bits of the
+ * hash, EZCB_CTRL_EMPTY or EZCB_CTRL_DELETED. A probe matches a group of control bytes at
+ * once and only dereferences entries whose fingerprint agrees. The first
+ * group of control bytes is mirrored past the end so a group never wraps.
+ * SSE2 scans 16 control bytes per compare; NEON and the portable path 8.
+ */
+#ifdef EZCB_SSE2
+#define EZCB_GROUP_WIDTH        16
+typedef uint32_t ezcb_mask_t;   /* Bit i set for slot i */
+#else
+#define EZCB_GROUP_WIDTH        8
+typedef uint64_t ezcb_mask_t;   /* High bit of byte i set for slot i */
+#endif
+#define EZCB_CTRL_EMPTY         0x80
+#define EZCB_CTRL_DELETED       0xFE    /* Tombstone of a freed entry; probes go on past it */
+
+typedef struct ezcb_table
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_rcu_head_t head;       /* Published tables are immutable and retired on change */
+#endif
+    size_t capacity;            /* Power of two, at least EZCB_GROUP_WIDTH */
+    ezcb_entry_t** entries;     /* Same allocation, after the control bytes */
+    uint8_t ctrl[];
+} ezcb_table_t;
+#else
+typedef EZCB_ATOMIC(ezcb_entry_t*) ezcb_slot_t;
+typedef ezcb_slot_t ezcb_table_t;
+#endif  /* EZCB_OPEN_ADDRESSING */
+
+/*
+ * A grown table is filled from the old one EZCB_REHASH_STEP buckets (or
+ * slots) at a time, by the registrations that follow, and lookups check
+ * both until it is drained. Lock-free open addressing already copies the
+ * table on every insert, so it keeps rebuilding in one pass.
+ */
+#if !defined(EZCB_NO_MALLOC) && !(defined(EZCB_OPEN_ADDRESSING) && defined(EZCB_LOCK_FREE_TRIGGER))
+    #define EZCB_REHASH
+#endif
+
+#ifdef EZCB_ENABLE_ISR
+/*
+ * Bounded multi-producer, single-consumer ring. Each slot carries a
+ * sequence number that says whose turn it is: for position pos it holds
+ * the lap base (pos & ~mask) while free and lap base + 1 once filled. The
+ * lap base is 0 for every slot on the first lap, so the zeroed queue is
+ * already valid.
+ */
+typedef struct ezcb_evt
+{
+    _Atomic(ezcb_evt_idx_t) seq;
+    const char* trigger;        /* NULL when queued by handle */
+    ezcb_entry_t* handle;
+    void* data;
+#ifdef EZCB_ENABLE_LATENCY
+    uint32_t stamp;             /* EZCB_TICKS() when queued */
+#endif
+} ezcb_evt_t;
+
+/* The queue of one event priority */
+typedef struct ezcb_evt_ring
+{
+    _Atomic(ezcb_evt_idx_t) head;   /* Next position to claim (producers) */
+    ezcb_evt_idx_t tail;            /* Next position to consume (dispatcher) */
+    ezcb_evt_t slots[EZCB_EVENT_QUEUE_SIZE];
+} ezcb_evt_ring_t;
+
+/* Scratch space for ezcb_dispatch_batch(), owned by the single consumer */
+typedef struct ezcb_batch_evt
+{
+    const char* trigger;
+    ezcb_entry_t* handle;       /* Queued by handle, or NULL */
+    void* data;
+    uint32_t hash;
+    uint32_t len;
+    size_t next;                /* Next event of the same trigger */
+} ezcb_batch_evt_t;
+
+/* Events of one trigger, chained through ezcb_batch_evt_t.next */
+typedef struct ezcb_batch_group
+{
+    size_t first;
+    size_t last;
+    size_t slot;                /* Its slot in ezcb_batch_index */
+    ezcb_entry_t* handle;       /* Entry of the first event queued by handle, so the group needs no lookup */
+} ezcb_batch_group_t;
+
+#define EZCB_BATCH_INDEX_SIZE   (2 * EZCB_EVENT_QUEUE_SIZE)
+
+/*
+ * Multi-producer, single-consumer ring of variable-sized records for
+ * ezcb_trigger_isr_copy(), counted in units of this header. A record is a
+ * header and its payload in the units after it, never split across the
+ * end of the ring; a header with a NULL handle fills the units up to the
+ * end instead. The header's size keeps each payload 8-byte aligned.
+ */
+typedef union ezcb_rec
+{
+    struct
+    {
+        ezcb_entry_t* handle;
+        uint32_t len;
+#ifdef EZCB_ENABLE_LATENCY
+        uint32_t stamp;
+#endif
+    } hdr;
+    uint64_t align;
+} ezcb_rec_t;
+
+#define EZCB_REC_UNITS          (EZCB_PAYLOAD_RING_SIZE / sizeof(ezcb_rec_t))
+#define EZCB_REC_MASK           ((ezcb_evt_idx_t)(EZCB_REC_UNITS - 1))
+
+/* rec_head and rec_tail count units, so the preprocessor cannot check the ring's size against their range */
+typedef char ezcb_payload_ring_size_exceeds_half_the_index_range[EZCB_REC_UNITS <= EZCB_EVT_HALF ? 1 : -1];
+#endif  /* EZCB_ENABLE_ISR*/
+
+#ifdef EZCB_ENABLE_EXECUTOR
+#ifdef EZCB_LOCK_FREE_TRIGGER
+#define EZCB_FANOUT
+#endif
+
+typedef struct ezcb_task
+{
+    const char* trigger;        /* NULL when posted by handle */
+    ezcb_entry_t* handle;
+    void* data;
+    struct ezcb_fanout* fanout; /* Set for a worker helping with a parallel group */
+} ezcb_task_t;
+
+typedef struct ezcb_executor ezcb_executor_t;
+
+/* One worker's ring; its owner and thieves both take from the front */
+typedef struct ezcb_worker
+{
+    mtx_t mtx;
+    size_t head;
+    atomic_size_t count;        /* Changed under mtx, peeked without it */
+    ezcb_task_t tasks[EZCB_EXECUTOR_QUEUE_SIZE];
+    ezcb_executor_t* ex;
+    size_t index;
+    thrd_t thread;
+} ezcb_worker_t;
+
+/*
+ * queued counts tasks sitting in rings and pending those not finished
+ * yet. A worker counts itself in sleepers before it checks queued, and a
+ * poster bumps queued before it checks sleepers, so one of them always
+ * sees the other and a wakeup is never lost.
+ */
+struct ezcb_executor
+{
+    ezcb_ctx_t* inst;
+    mtx_t mtx;
+    cnd_t wake;                 /* Work was queued, or the pool is stopping */
+    cnd_t idle;                 /* pending dropped to 0 */
+#ifdef EZCB_FANOUT
+    cnd_t joined;               /* A joined parallel group finished */
+    struct ezcb_fanout* groups; /* Free groups of EZCB_FANOUT_POOLED calls, under mtx */
+#endif
+    atomic_size_t queued;
+    atomic_size_t pending;
+    atomic_size_t sleepers;
+    atomic_bool stopping;
+    size_t workers;
+    ezcb_worker_t worker[];
+};
+
+#ifdef EZCB_FANOUT
+/*
+ * One group of parallel callbacks. The triggering thread and the workers
+ * it posted claim calls by bumping next until all are taken; left counts
+ * the calls not finished. Whoever drops the last reference releases it,
+ * so a helper that only gets to run after the trigger returned finds
+ * nothing left to claim and just lets go. Groups of up to
+ * EZCB_FANOUT_POOLED calls go back to the executor's free list.
+ */
+typedef struct ezcb_fanout
+{
+    struct ezcb_fanout* free_next;
+    ezcb_entry_t* e;
+    ezcb_executor_t* ex;
+    void* data;
+    bool join;
+    atomic_bool stop;           /* A joined call returned EZCB_STOP */
+    atomic_size_t next;
+    atomic_size_t left;
+    atomic_size_t refs;
+    bool pooled;                /* Holds EZCB_FANOUT_POOLED calls and is reused */
+    size_t count;
+    ezcb_call_t calls[];
+} ezcb_fanout_t;
+
+#define EZCB_FANOUT_POOLED          16
+#endif  /* EZCB_FANOUT */
+
+static _Thread_local ezcb_worker_t* ezcb_exec_self;     /* Set on worker threads */
+static _Thread_local size_t ezcb_exec_home;             /* Poster's queue + 1, 0 until first post */
+static atomic_size_t ezcb_exec_homes;
+#endif  /* EZCB_ENABLE_EXECUTOR */
+
+/****************************************************************
+ * Hash table state
+ ****************************************************************/
+
+/* Each shard's table holds its trigger entries; count is the number of entries */
+typedef struct ezcb_shard
+{
+#ifdef EZCB_THREAD_SAFE
+    EZCB_MUTEX_T mtx;
+#endif
+    ezcb_ctx_t* inst;           /* Owning dispatcher */
+    EZCB_ATOMIC(ezcb_table_t*) table;
+    EZCB_ATOMIC(size_t) buckets;    /* Bucket count, or slot count with EZCB_OPEN_ADDRESSING */
+    size_t count;
+#ifdef EZCB_OPEN_ADDRESSING
+    size_t tombs;               /* Slots of the current table left by freed entries */
+#endif
+#ifndef EZCB_NO_MALLOC
+    ezcb_pool_t entries;
+    size_t floor;               /* Size ezcb_reserve() asked for; freed entries do not shrink the table below it */
+    bool sweeping;              /* Entries are being walked, so freeing one leaves the table as it is */
+#endif
+#ifdef EZCB_REHASH
+    EZCB_ATOMIC(ezcb_table_t*) old_table;   /* Being drained into table, or NULL */
+#ifndef EZCB_OPEN_ADDRESSING
+    EZCB_ATOMIC(size_t) old_buckets;
+#endif
+    size_t rehash_pos;          /* Next old bucket or slot to move */
+#endif
+#if defined(EZCB_LOCK_FREE_TRIGGER) && !defined(EZCB_OPEN_ADDRESSING)
+    atomic_uint resize_seq;     /* Odd while entries move between tables */
+#endif
+#ifdef EZCB_ENABLE_STATS
+    uint32_t resizes;
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    ezcb_ref_t** refs;          /* Reverse index buckets, chained; NULL until the first link */
+    size_t ref_buckets;
+    ezcb_ref_t** old_refs;      /* Buckets being drained into refs after a resize, or NULL */
+    size_t old_ref_buckets;
+    size_t ref_rehash_pos;      /* Next old bucket to move */
+    size_t nrefs;
+    ezcb_pool_t ref_pool;
+    uint32_t last_id;           /* Token id of the latest record */
+#endif
+} ezcb_shard_t;
+
+/*
+ * One dispatcher. Everything is zero until ezcb_ctx_init() runs, and the
+ * zero state is valid for ezcb_trigger_isr() and the ready checks.
+ */
+struct ezcb_ctx
+{
+    ezcb_shard_t shards[EZCB_SHARDS];
+    bool ready;                 /* Checked before any shard mutex is taken */
+#ifdef EZCB_ENABLE_STATS
+    ezcb_hook_fn_t hook_pre;
+    ezcb_hook_fn_t hook_post;
+    void* hook_ctx;
+#endif
+#ifdef EZCB_ENABLE_LATENCY
+    ezcb_cb_hook_fn_t cb_hook;
+    void* cb_hook_ctx;
+#endif
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    /* Readers register in the counter matching the epoch they entered in */
+    atomic_uint epoch;
+    atomic_size_t readers[2];
+    ezcb_rcu_head_t* retired;
+    /* Guarded by the (only) shard mutex */
+    ezcb_pool_t cells;
+    ezcb_pool_t snaps;          /* Snapshots of up to EZCB_SNAP_POOLED callbacks */
+#endif
+#ifdef EZCB_NO_MALLOC
+    /* Record columns; each entry's records are packed back to back, in entry order */
+    ezcb_call_t calls[EZCB_MAX_NODES];
+    uint8_t keys[EZCB_MAX_NODES];
+    uint8_t flags[EZCB_MAX_NODES];
+    size_t cbs_used;
+    ezcb_entry_t entries[EZCB_MAX_TRIGGERS];
+    size_t entries_used;
+    ezcb_entry_t* entries_free; /* Freed entries below entries_used, chained through next */
+    size_t entries_spare;       /* How many */
+    ezcb_slot_t table_static[EZCB_MAX_BUCKETS];
+#endif
+#ifdef EZCB_ENABLE_ISR
+    ezcb_evt_ring_t evt_rings[EZCB_EVENT_PRIORITIES];   /* Indexed by priority */
+#ifdef EZCB_ENABLE_STATS
+    _Atomic(uint32_t) evt_drops;
+    _Atomic(uint32_t) evt_high_water;   /* Written by the dispatcher only */
+#endif
+#ifdef EZCB_ENABLE_LATENCY
+    _Atomic(uint32_t) evt_wait_max;     /* Written by the dispatcher only */
+    _Atomic(uint32_t) evt_wait[EZCB_LATENCY_BUCKETS];
+#endif
+    ezcb_batch_evt_t batch_evts[EZCB_EVENT_QUEUE_SIZE];
+    ezcb_batch_group_t batch_groups[EZCB_EVENT_QUEUE_SIZE];
+    size_t batch_index[EZCB_BATCH_INDEX_SIZE];     /* Group + 1, or 0 when empty */
+    void* batch_data[EZCB_EVENT_QUEUE_SIZE];
+    bool batch_busy;
+    _Atomic(ezcb_evt_idx_t) rec_head;   /* Next unit to claim (producers) */
+    _Atomic(ezcb_evt_idx_t) rec_tail;   /* First unit still in use (dispatcher) */
+    ezcb_evt_idx_t rec_next;            /* Next unit to dispatch, at or after rec_tail */
+#ifdef EZCB_ENABLE_COALESCING
+    ezcb_entry_t* coalesce_waiting;     /* Entries whose pending event waits out its interval */
+#endif
+    unsigned rec_depth;                 /* Dispatches running payload callbacks */
+    _Atomic(bool) rec_ready[EZCB_REC_UNITS];   /* Set from publishing a record here until it is taken */
+    ezcb_rec_t rec_ring[EZCB_REC_UNITS];
+#endif
+#ifdef EZCB_ENABLE_EXECUTOR
+    ezcb_executor_t* executor;  /* Running pool, or NULL */
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    /* Changed with every shard mutex held, so any one of them covers reads */
+    ezcb_pnode_t* patterns;     /* Top-level segments */
+    EZCB_ATOMIC(size_t) npatterns;  /* Pattern callbacks; lock-free triggers read it unlocked */
+    EZCB_ATOMIC(unsigned) pattern_gen;  /* Bumped whenever pattern callbacks are freed */
+#endif
+};
+
+/* Behind the functions without an _ex suffix */
+static ezcb_ctx_t ezcb_default;
+
+#if defined(EZCB_NO_MALLOC) && EZCB_MAX_CONTEXTS > 0
+static ezcb_ctx_t ezcb_ctx_pool[EZCB_MAX_CONTEXTS];
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+static _Thread_local unsigned ezcb_read_depth;
+#endif
+
+#if EZCB_SHARDS > 1
+static _Thread_local unsigned ezcb_shards_held;     /* Shard locks taken by this thread, recursion included */
+#endif
+
+#ifdef EZCB_STATIC_HANDLERS
+/*
+ * Bounds of the ezcb_static section, provided by the linker. Weak, so a
+ * program without any EZCB_STATIC_HANDLER() still links.
+ */
+#ifdef __APPLE__
+extern const ezcb_static_t ezcb_static_begin[] __asm("section$start$__DATA_CONST$ezcb_static");
+extern const ezcb_static_t ezcb_static_end[] __asm("section$end$__DATA_CONST$ezcb_static");
+#else
+extern const ezcb_static_t __start_ezcb_static[] __attribute__((weak));
+extern const ezcb_static_t __stop_ezcb_static[] __attribute__((weak));
+#define ezcb_static_begin           __start_ezcb_static
+#define ezcb_static_end             __stop_ezcb_static
+#endif
+
+/* Static records grouped by entry, each group by descending priority */
+#ifdef EZCB_NO_MALLOC
+static const ezcb_static_t* ezcb_static_order[EZCB_MAX_STATIC_HANDLERS];
+#else
+static const ezcb_static_t** ezcb_static_order;
+#endif
+#endif  /* EZCB_STATIC_HANDLERS */
+
+/****************************************************************
+ * Hash
+ ****************************************************************/
+
+/*
+ * Hash of a trigger name; *length gets its length, which lookups compare
+ * first. Where word loads from any address are cheap, the name is measured
+ * with strlen() and hashed a word at a time; elsewhere it is read once, a
+ * byte at a time, so cores that trap on unaligned loads never issue one.
+ * Both paths give the same value.
+ */
+static uint32_t ezcb_hash_len(
+    const char* s,
+    size_t* length
+)
+{
+#ifdef EZCB_HASH_FN
+    size_t len = strlen(s);
+    *length = len;
+    return (uint32_t) EZCB_HASH_FN(s, len);
+#else
+#ifdef EZCB_UNALIGNED_LE
+    const uint8_t* p = (const uint8_t*) s;
+    size_t len = strlen(s);
+    const uint8_t* end = p + (len & ~(size_t) 3);
+    uint32_t h = 0;
+    uint32_t tail = 0;
+
+    for (; p < end; p += 4)
+    {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        h = ezcb_hash_fold_(h, word, true);
+    }
+
+    switch (len & 3)
+    {
+        case 3: tail |= (uint32_t) p[2] << 16; /* fall through */
+        case 2: tail |= (uint32_t) p[1] << 8;  /* fall through */
+        case 1: tail |= p[0];
+    }
+    h = ezcb_hash_fold_(h, tail, false);
+
+    *length = len;
+    return ezcb_hash_final_(h, len);
+#else
+    const uint8_t* p = (const uint8_t*) s;
+    uint32_t h = 0;
+    uint32_t tail;
+
+    /* Compilers merge the byte reads into one load where unaligned loads are allowed */
+    for (;; p += 4)
+    {
+        if (!p[0]) { tail = 0; break; }
+        if (!p[1]) { tail = p[0]; p += 1; break; }
+        if (!p[2]) { tail = p[0] | (uint32_t) p[1] << 8; p += 2; break; }
+        if (!p[3]) { tail = p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16; p += 3; break; }
+
+        h = ezcb_hash_fold_(h, p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24, true);
+    }
+    h = ezcb_hash_fold_(h, tail, false);
+
+    *length = (size_t)(p - (const uint8_t*) s);
+    return ezcb_hash_final_(h, *length);
+#endif  /* EZCB_UNALIGNED_LE */
+#endif  /* EZCB_HASH_FN */
+}
+
+static inline uint32_t ezcb_hash(
+    const char* s
+)
+{
+    size_t len;
+    return ezcb_hash_len(s, &len);
+}
+
+/****************************************************************
+ * Name comparison
+ ****************************************************************/
+
+/* Unaligned loads go through memcpy, which compilers turn into a single load where that is safe */
+static inline uint64_t ezcb_load64(
+    const char* p
+)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t ezcb_load32(
+    const char* p
+)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline bool ezcb_eq16(
+    const char* a,
+    const char* b
+)
+{
+#if defined(EZCB_SSE2)
+    __m128i x = _mm_loadu_si128((const __m128i*) a);
+    __m128i y = _mm_loadu_si128((const __m128i*) b);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+#elif defined(EZCB_NEON)
+    uint64x2_t x = vreinterpretq_u64_u8(veorq_u8(vld1q_u8((const uint8_t*) a), vld1q_u8((const uint8_t*) b)));
+    return (vgetq_lane_u64(x, 0) | vgetq_lane_u64(x, 1)) == 0;
+#else
+    return ((ezcb_load64(a) ^ ezcb_load64(b)) | (ezcb_load64(a + 8) ^ ezcb_load64(b + 8))) == 0;
+#endif
+}
+
+/*
+ * Compare two names already known to be len bytes long. Names of 16 bytes
+ * or more go 16 at a time, the last block overlapping the one before it;
+ * shorter ones take two overlapping words. Nothing past either name is read.
+ */
+static inline bool ezcb_name_eq(
+    const char* a,
+    const char* b,
+    size_t len
+)
+{
+    if (len >= 16)
+    {
+        for (size_t i = 0; i + 16 < len; i += 16)
+        {
+            if (!ezcb_eq16(a + i, b + i)) return false;
+        }
+        return ezcb_eq16(a + len - 16, b + len - 16);
+    }
+
+    if (len >= 8)
+    {
+        return ((ezcb_load64(a) ^ ezcb_load64(b)) | (ezcb_load64(a + len - 8) ^ ezcb_load64(b + len - 8))) == 0;
+    }
+
+    if (len >= 4)
+    {
+        return ((ezcb_load32(a) ^ ezcb_load32(b)) | (ezcb_load32(a + len - 4) ^ ezcb_load32(b + len - 4))) == 0;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+/* Whether entry e is named `trigger`, of length len and with that hash */
+static inline bool ezcb_entry_is(
+    const ezcb_entry_t* e,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    return e->hash == hash && e->len == len && ezcb_name_eq(e->trigger, trigger, len);
+}
+
+/****************************************************************
+ * Mutex helpers
+ ****************************************************************/
+
+static inline ezcb_shard_t* ezcb_shard_of(
+    ezcb_ctx_t* inst,
+    uint32_t hash
+)
+{
+#if EZCB_SHARDS > 1
+    /* High bits pick the shard so the low bits still spread its buckets */
+    return &inst->shards[(hash >> 16) % EZCB_SHARDS];
+#else
+    (void) hash;
+    return &inst->shards[0];
+#endif
+}
+
+static inline void ezcb_lock(
+    ezcb_shard_t* s
+)
+{
+    (void) s;
+    EZCB_MUTEX_LOCK(s->mtx);
+#if EZCB_SHARDS > 1
+    ezcb_shards_held++;
+#endif
+}
+
+static inline void ezcb_unlock(
+    ezcb_shard_t* s
+)
+{
+    (void) s;
+#if EZCB_SHARDS > 1
+    ezcb_shards_held--;
+#endif
+    EZCB_MUTEX_UNLOCK(s->mtx);
+}
+
+/*
+ * Whether this thread may take every shard lock. A callback runs with its
+ * trigger's shard held, and taking the others from there breaks the index
+ * order: two callbacks doing it on different shards would deadlock.
+ */
+static inline bool ezcb_may_lock_all(void)
+{
+#if EZCB_SHARDS > 1
+    return ezcb_shards_held == 0;
+#else
+    return true;
+#endif
+}
+
+/* Every shard, in index order so that two such callers cannot deadlock */
+static inline void ezcb_lock_all(
+    ezcb_ctx_t* inst
+)
+{
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_lock(&inst->shards[i]);
+    }
+}
+
+static inline void ezcb_unlock_all(
+    ezcb_ctx_t* inst
+)
+{
+    for (size_t i = EZCB_SHARDS; i-- > 0;)
+    {
+        ezcb_unlock(&inst->shards[i]);
+    }
+}
+
+/****************************************************************
+ * Pools
+ ****************************************************************/
+
+#ifndef EZCB_NO_MALLOC
+static void* ezcb_zalloc(
+    size_t size
+)
+{
+    void* p = EZCB_MALLOC(size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+static void ezcb_pool_init(
+    ezcb_pool_t* p,
+    size_t size
+)
+{
+    memset(p, 0, sizeof(*p));
+    p->size = size;
+    p->grow = 8;
+}
+
+static void* ezcb_pool_alloc(
+    ezcb_pool_t* p
+)
+{
+    void* obj = p->free;
+
+    if (obj)
+    {
+        memcpy(&p->free, obj, sizeof(void*));
+        return obj;
+    }
+
+    if (p->bump == p->end)
+    {
+        ezcb_chunk_t* chunk = (ezcb_chunk_t*) EZCB_MALLOC(sizeof(ezcb_chunk_t) + p->grow * p->size);
+        if (!chunk) return NULL;
+
+        chunk->hdr.next = p->chunks;
+        chunk->hdr.objects = p->grow;
+        p->chunks = chunk;
+        p->bump = (char*)(chunk + 1);
+        p->end = p->bump + p->grow * p->size;
+        if (p->grow < 256) p->grow *= 2;
+    }
+
+    obj = p->bump;
+    p->bump += p->size;
+    return obj;
+}
+
+static void ezcb_pool_free(
+    ezcb_pool_t* p,
+    void* obj
+)
+{
+    memcpy(obj, &p->free, sizeof(void*));
+    p->free = obj;
+}
+
+/* Release every chunk at once; the pool is left empty and reusable */
+static void ezcb_pool_clear(
+    ezcb_pool_t* p
+)
+{
+    while (p->chunks)
+    {
+        ezcb_chunk_t* next = p->chunks->hdr.next;
+        EZCB_FREE(p->chunks);
+        p->chunks = next;
+    }
+    ezcb_pool_init(p, p->size);
+}
+
+/* A chunk and how many of its objects are free, for ezcb_pool_trim() */
+typedef struct ezcb_chunk_use
+{
+    ezcb_chunk_t* chunk;
+    size_t unused;
+} ezcb_chunk_use_t;
+
+static int ezcb_chunk_use_cmp(
+    const void* a,
+    const void* b
+)
+{
+    uintptr_t x = (uintptr_t)((const ezcb_chunk_use_t*) a)->chunk;
+    uintptr_t y = (uintptr_t)((const ezcb_chunk_use_t*) b)->chunk;
+    return x < y ? -1 : x > y;
+}
+
+/* Entry of the chunk holding obj, in `uses` sorted by address */
+static ezcb_chunk_use_t* ezcb_chunk_use_of(
+    ezcb_chunk_use_t* uses,
+    size_t n,
+    const void* obj
+)
+{
+    size_t lo = 0;
+    size_t hi = n;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((uintptr_t) uses[mid].chunk <= (uintptr_t) obj) lo = mid;
+        else hi = mid;
+    }
+    return &uses[lo];
+}
+
+/*
+ * Release the chunks whose objects are all on the free list, and drop
+ * those objects from it. The rest of the free list keeps its order. Left
+ * as is if the scratch array cannot be allocated.
+ */
+static void ezcb_pool_trim(
+    ezcb_pool_t* p
+)
+{
+    if (!p->free) return;
+
+    size_t n = 0;
+    for (ezcb_chunk_t* c = p->chunks; c; c = c->hdr.next) n++;
+
+    ezcb_chunk_use_t* uses = (ezcb_chunk_use_t*) EZCB_MALLOC(n * sizeof(ezcb_chunk_use_t));
+    if (!uses) return;
+
+    n = 0;
+    for (ezcb_chunk_t* c = p->chunks; c; c = c->hdr.next)
+    {
+        uses[n].chunk = c;
+        /* The newest chunk's tail was never handed out */
+        uses[n].unused = c == p->chunks ? (size_t)(p->end - p->bump) / p->size : 0;
+        n++;
+    }
+    qsort(uses, n, sizeof(ezcb_chunk_use_t), ezcb_chunk_use_cmp);
+
+    for (void* obj = p->free; obj; memcpy(&obj, obj, sizeof(void*)))
+    {
+        ezcb_chunk_use_of(uses, n, obj)->unused++;
+    }
+
+    size_t released = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (uses[i].unused == uses[i].chunk->hdr.objects) released++;
+    }
+
+    if (released)
+    {
+        void* obj = p->free;
+        void** link = &p->free;
+
+        while (obj)
+        {
+            void* next;
+            memcpy(&next, obj, sizeof(void*));
+
+            ezcb_chunk_use_t* use = ezcb_chunk_use_of(uses, n, obj);
+            if (use->unused != use->chunk->hdr.objects)
+            {
+                memcpy(link, &obj, sizeof(void*));
+                link = (void**) obj;
+            }
+            obj = next;
+        }
+        memset(link, 0, sizeof(void*));
+
+        for (ezcb_chunk_t** cur = &p->chunks; *cur;)
+        {
+            ezcb_chunk_t* c = *cur;
+            ezcb_chunk_use_t* use = ezcb_chunk_use_of(uses, n, c + 1);
+
+            if (use->unused != c->hdr.objects)
+            {
+                cur = &c->hdr.next;
+                continue;
+            }
+
+            if (c == p->chunks)
+            {
+                p->bump = NULL;
+                p->end = NULL;
+            }
+            *cur = c->hdr.next;
+            EZCB_FREE(c);
+        }
+    }
+
+    EZCB_FREE(uses);
+}
+#endif  /* EZCB_NO_MALLOC */
+
+/****************************************************************
+ * Epoch-based reclamation
+ ****************************************************************/
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+
+/*
+ * A reader counts itself in the dispatcher's readers[epoch & 1]. The epoch only moves
+ * from E to E + 1 once the counter of E - 1 (same parity as E + 1) has
+ * drained, so an object retired in epoch R is unreachable once the epoch
+ * has reached R + 2. All epoch operations are sequentially consistent.
+ */
+static unsigned ezcb_rcu_read_lock(
+    ezcb_ctx_t* inst
+)
+{
+    for (;;)
+    {
+        unsigned epoch = atomic_load(&inst->epoch);
+        atomic_fetch_add(&inst->readers[epoch & 1], 1);
+
+        if (atomic_load(&inst->epoch) == epoch)
+        {
+            ezcb_read_depth++;
+            return epoch;
+        }
+
+        atomic_fetch_sub(&inst->readers[epoch & 1], 1);
+    }
+}
+
+static void ezcb_rcu_read_unlock(
+    ezcb_ctx_t* inst,
+    unsigned epoch
+)
+{
+    ezcb_read_depth--;
+    atomic_fetch_sub(&inst->readers[epoch & 1], 1);
+}
+
+static bool ezcb_rcu_try_advance(
+    ezcb_ctx_t* inst
+)
+{
+    unsigned epoch = atomic_load(&inst->epoch);
+
+    if (atomic_load(&inst->readers[(epoch + 1) & 1]) != 0) return false;
+
+    atomic_compare_exchange_strong(&inst->epoch, &epoch, epoch + 1);
+    return true;
+}
+
+/* Call with the shard mutex held, after the object has been unpublished */
+static void ezcb_rcu_retire(
+    ezcb_ctx_t* inst,
+    ezcb_rcu_head_t* head
+)
+{
+    head->epoch = atomic_load(&inst->epoch);
+    head->next = inst->retired;
+    inst->retired = head;
+}
+
+static void ezcb_rcu_free(
+    ezcb_rcu_head_t* head
+)
+{
+    if (head->pool)
+    {
+        ezcb_pool_free(head->pool, head);
+    }
+    else
+    {
+        EZCB_FREE(head);
+    }
+}
+
+/* Call with the shard mutex held; frees whatever no reader can still reach */
+static void ezcb_rcu_reclaim(
+    ezcb_ctx_t* inst
+)
+{
+    if (!inst->retired) return;
+
+    ezcb_rcu_try_advance(inst);
+    ezcb_rcu_try_advance(inst);
+
+    unsigned epoch = atomic_load(&inst->epoch);
+    ezcb_rcu_head_t** cur = &inst->retired;
+
+    while (*cur)
+    {
+        ezcb_rcu_head_t* head = *cur;
+
+        if (epoch - head->epoch >= 2)
+        {
+            *cur = head->next;
+            ezcb_rcu_free(head);
+            continue;
+        }
+
+        cur = &head->next;
+    }
+}
+
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+/*
+ * Trigger-side locking. Lock-free triggers only enter an epoch; otherwise
+ * the shard mutex is held for the whole callback walk.
+ */
+static inline unsigned ezcb_read_lock(
+    ezcb_shard_t* s
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    return ezcb_rcu_read_lock(s->inst);
+#else
+    ezcb_lock(s);
+    return 0;
+#endif
+}
+
+static inline void ezcb_read_unlock(
+    ezcb_shard_t* s,
+    unsigned token
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_rcu_read_unlock(s->inst, token);
+#else
+    (void) token;
+    ezcb_unlock(s);
+#endif
+}
+
+/****************************************************************
+ * Callback records
+ ****************************************************************/
+
+#ifndef EZCB_NO_MALLOC
+/* Bytes for the columns of `capacity` records, with or without their metadata */
+static inline size_t ezcb_cols_size(
+    size_t capacity,
+    bool meta
+)
+{
+    size_t per = sizeof(ezcb_call_t) + 2;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    per += sizeof(ezcb_cell_t*);
+#endif
+#ifdef EZCB_CB_META
+    if (meta) per += sizeof(ezcb_meta_t);
+#else
+    (void) meta;
+#endif
+    return capacity * per;
+}
+
+/* Columns of a block sized by ezcb_cols_size(); the widest come first, so each stays aligned */
+static inline ezcb_cols_t ezcb_cols_at(
+    void* block,
+    size_t capacity,
+    bool meta
+)
+{
+    ezcb_cols_t c;
+    char* p = (char*) block;
+
+    c.calls = (ezcb_call_t*) p;
+    p += capacity * sizeof(ezcb_call_t);
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    c.cells = (ezcb_cell_t**) p;
+    p += capacity * sizeof(ezcb_cell_t*);
+#endif
+#ifdef EZCB_CB_META
+    c.meta = meta ? (ezcb_meta_t*) p : NULL;
+    if (meta) p += capacity * sizeof(ezcb_meta_t);
+#else
+    (void) meta;
+#endif
+    c.keys = (uint8_t*) p;
+    c.flags = c.keys + capacity;
+    return c;
+}
+#endif  /* EZCB_NO_MALLOC */
+
+/* Where the entry's records are now; any growth or shrinking may move them */
+static inline ezcb_cols_t ezcb_cols(
+    const ezcb_entry_t* e
+)
+{
+#ifdef EZCB_NO_MALLOC
+    ezcb_ctx_t* inst = e->shard->inst;
+    ezcb_cols_t c;
+
+    c.calls = inst->calls + e->first;
+    c.keys = inst->keys + e->first;
+    c.flags = inst->flags + e->first;
+    return c;
+#else
+    return ezcb_cols_at(e->cbs, e->capacity, true);
+#endif
+}
+
+/* Copy n records from src[from] to dst[to], which may overlap; metadata only if both have it */
+static void ezcb_cols_move(
+    const ezcb_cols_t* dst,
+    size_t to,
+    const ezcb_cols_t* src,
+    size_t from,
+    size_t n
+)
+{
+    if (n == 0) return;
+
+    memmove(dst->calls + to, src->calls + from, n * sizeof(ezcb_call_t));
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    memmove(dst->cells + to, src->cells + from, n * sizeof(ezcb_cell_t*));
+#endif
+#ifdef EZCB_CB_META
+    if (dst->meta && src->meta) memmove(dst->meta + to, src->meta + from, n * sizeof(ezcb_meta_t));
+#endif
+    memmove(dst->keys + to, src->keys + from, n);
+    memmove(dst->flags + to, src->flags + from, n);
+}
+
+static inline ezcb_cb_t ezcb_cb_get(
+    const ezcb_cols_t* c,
+    size_t i
+)
+{
+    ezcb_cb_t cb;
+
+    cb.fn = c->calls[i].fn;
+    cb.ctx = c->calls[i].ctx;
+    cb.priority = c->keys[i];
+    cb.flags = c->flags[i];
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    cb.cell = c->cells[i];
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    cb.id = c->meta[i].id;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    cb.sub = c->meta[i].sub;
+#endif
+    return cb;
+}
+
+static inline void ezcb_cb_put(
+    const ezcb_cols_t* c,
+    size_t i,
+    const ezcb_cb_t* cb
+)
+{
+    c->calls[i].fn = cb->fn;
+    c->calls[i].ctx = cb->ctx;
+    c->keys[i] = cb->priority;
+    c->flags[i] = cb->flags;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    c->cells[i] = cb->cell;
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    c->meta[i].id = cb->id;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    c->meta[i].sub = cb->sub;
+#endif
+}
+
+/****************************************************************
+ * Allocation
+ ****************************************************************/
+
+#ifndef EZCB_NO_MALLOC
+/*
+ * Shift the columns of a block's first n records from their offsets for
+ * capacity `from` to those for `to`. Growing moves every column up, so the
+ * last goes first; shrinking moves them down, first to last.
+ */
+static void ezcb_cols_relocate(
+    void* block,
+    size_t from,
+    size_t to,
+    size_t n
+)
+{
+    ezcb_cols_t a = ezcb_cols_at(block, from, true);
+    ezcb_cols_t b = ezcb_cols_at(block, to, true);
+    void* src[4];
+    void* dst[4];
+    size_t len[4];
+    size_t k = 0;
+
+    /* The calls column starts the block either way */
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    src[k] = a.cells; dst[k] = b.cells; len[k++] = n * sizeof(ezcb_cell_t*);
+#endif
+#ifdef EZCB_CB_META
+    src[k] = a.meta; dst[k] = b.meta; len[k++] = n * sizeof(ezcb_meta_t);
+#endif
+    src[k] = a.keys; dst[k] = b.keys; len[k++] = n;
+    src[k] = a.flags; dst[k] = b.flags; len[k++] = n;
+
+    if (to > from)
+    {
+        while (k-- > 0) memmove(dst[k], src[k], len[k]);
+    }
+    else
+    {
+        for (size_t i = 0; i < k; i++) memmove(dst[i], src[i], len[i]);
+    }
+}
+
+/* Resize the entry's columns to `capacity` records, at least its count; 0 frees them */
+static int ezcb_cbs_realloc(
+    ezcb_entry_t* e,
+    size_t capacity
+)
+{
+    assert(capacity >= e->count);
+
+    if (capacity == 0)
+    {
+        EZCB_FREE(e->cbs);
+        e->cbs = NULL;
+        e->capacity = 0;
+        return 0;
+    }
+
+    if (capacity < e->capacity)
+    {
+        /* Packed first, so that a failed shrink leaves a usable, larger block */
+        ezcb_cols_relocate(e->cbs, e->capacity, capacity, e->count);
+
+        void* cbs = EZCB_REALLOC(e->cbs, ezcb_cols_size(capacity, true));
+        if (cbs) e->cbs = cbs;
+    }
+    else
+    {
+        void* cbs = EZCB_REALLOC(e->cbs, ezcb_cols_size(capacity, true));
+        if (!cbs) return -1;
+
+        if (e->capacity) ezcb_cols_relocate(cbs, e->capacity, capacity, e->count);
+        e->cbs = cbs;
+    }
+
+    e->capacity = capacity;
+    return 0;
+}
+
+/* Make room for `count` callbacks in the entry's columns, growing them geometrically */
+static int ezcb_cbs_reserve(
+    ezcb_entry_t* e,
+    size_t count
+)
+{
+    if (count <= e->capacity) return 0;
+
+    size_t capacity = e->capacity ? e->capacity * 2 : 4;
+    if (capacity < count) capacity = count;
+
+    return ezcb_cbs_realloc(e, capacity);
+}
+
+/* Resize the entry's columns to `capacity` records, at least its count; 0 frees them */
+static void ezcb_cbs_shrink(
+    ezcb_entry_t* e,
+    size_t capacity
+)
+{
+    /* Shrinking only fails to give memory back, which leaves the larger block in use */
+    if (capacity != e->capacity) (void) ezcb_cbs_realloc(e, capacity);
+}
+#endif  /* EZCB_NO_MALLOC */
+
+/*
+ * Make room for one more callback at the end of the entry's array. In
+ * static mode, the records of the following entries are shifted up by one.
+ */
+static int ezcb_cbs_grow(
+    ezcb_entry_t* e
+)
+{
+#ifdef EZCB_NO_MALLOC
+    ezcb_ctx_t* inst = e->shard->inst;
+
+    if (inst->cbs_used >= EZCB_MAX_NODES) return -1;
+
+    ezcb_cols_t all = { inst->calls, inst->keys, inst->flags };
+    size_t end = e->first + e->count;
+    ezcb_cols_move(&all, end + 1, &all, end, inst->cbs_used - end);
+
+    for (ezcb_entry_t* f = e + 1; f < inst->entries + inst->entries_used; f++)
+    {
+        f->first++;
+    }
+
+    inst->cbs_used++;
+    return 0;
+#else
+    return ezcb_cbs_reserve(e, e->count + 1);
+#endif
+}
+
+/*
+ * Drop the records past new_count from the entry's array. In static mode,
+ * the records of the following entries are shifted down to close the gap.
+ * In dynamic mode, the array is halved while at most a quarter of it is
+ * used; growth waits for a full array, so alternating register and
+ * unregister calls do not reallocate it each time.
+ */
+static void ezcb_cbs_truncate(
+    ezcb_entry_t* e,
+    size_t new_count
+)
+{
+#ifdef EZCB_NO_MALLOC
+    ezcb_ctx_t* inst = e->shard->inst;
+    size_t gap = e->count - new_count;
+    if (gap == 0) return;
+
+    ezcb_cols_t all = { inst->calls, inst->keys, inst->flags };
+    size_t end = e->first + e->count;
+    ezcb_cols_move(&all, end - gap, &all, end, inst->cbs_used - end);
+
+    for (ezcb_entry_t* f = e + 1; f < inst->entries + inst->entries_used; f++)
+    {
+        f->first -= gap;
+    }
+
+    inst->cbs_used -= gap;
+    e->count = new_count;
+#else
+    e->count = new_count;
+
+    size_t capacity = e->capacity;
+    while (capacity >= 8 && new_count * 4 <= capacity) capacity /= 2;
+    ezcb_cbs_shrink(e, capacity);
+#endif
+}
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+static void ezcb_entry_remove_at(
+    ezcb_entry_t* e,
+    size_t i
+)
+{
+    ezcb_cols_t c = ezcb_cols(e);
+    ezcb_cols_move(&c, i, &c, i + 1, e->count - i - 1);
+    ezcb_cbs_truncate(e, e->count - 1);
+}
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifndef EZCB_NO_MALLOC
+/* Copy of a name too long for its entry; lock-free, it is retired with the entry */
+static char* ezcb_name_alloc(
+    size_t size
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_rcu_head_t* head = (ezcb_rcu_head_t*) EZCB_MALLOC(sizeof(ezcb_rcu_head_t) + size);
+    if (!head) return NULL;
+
+    head->pool = NULL;
+    return (char*)(head + 1);
+#else
+    return (char*) EZCB_MALLOC(size);
+#endif
+}
+
+static void ezcb_name_free(
+    char* name
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    EZCB_FREE((ezcb_rcu_head_t*) name - 1);
+#else
+    EZCB_FREE(name);
+#endif
+}
+#endif  /* EZCB_NO_MALLOC */
+
+static ezcb_entry_t* ezcb_entry_alloc(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t trigger_length
+)
+{
+#ifdef EZCB_NO_MALLOC
+    ezcb_ctx_t* inst = s->inst;
+
+    if (trigger_length >= EZCB_MAX_TRIGGER_LENGTH) return NULL;
+
+    /* A freed entry keeps its place in the column order, and an empty run there */
+    ezcb_entry_t* e = inst->entries_free;
+    if (e)
+    {
+        inst->entries_free = e->next;
+        inst->entries_spare--;
+    }
+    else
+    {
+        if (inst->entries_used >= EZCB_MAX_TRIGGERS) return NULL;
+
+        e = &inst->entries[inst->entries_used++];
+        e->first = inst->cbs_used;
+    }
+#else
+    ezcb_entry_t* e = (ezcb_entry_t*) ezcb_pool_alloc(&s->entries);
+    if (!e) return NULL;
+
+    e->trigger = e->name;
+    if (trigger_length >= EZCB_INLINE_TRIGGER_LENGTH)
+    {
+        e->trigger = ezcb_name_alloc(trigger_length + 1);
+        if (!e->trigger)
+        {
+            ezcb_pool_free(&s->entries, e);
+            return NULL;
+        }
+    }
+#endif
+
+    memcpy(e->trigger, trigger, trigger_length + 1);
+    e->len = (uint32_t) trigger_length;
+    return e;
+}
+
+#ifdef EZCB_ENABLE_STATS
+static void ezcb_entry_stats_clear(
+    ezcb_entry_t* e
+)
+{
+    EZCB_STAT_SET(e->stats.fires, 0);
+    EZCB_STAT_SET(e->stats.invocations, 0);
+    EZCB_STAT_SET(e->stats.chain_max, 0);
+    EZCB_STAT_SET(e->stats.chain_total, 0);
+#ifdef EZCB_ENABLE_LATENCY
+    EZCB_STAT_SET(e->stats.latency_max, 0);
+    for (size_t i = 0; i < EZCB_LATENCY_BUCKETS; i++)
+    {
+        EZCB_STAT_SET(e->stats.latency[i], 0);
+    }
+#endif
+}
+#endif  /* EZCB_ENABLE_STATS */
+
+static void ezcb_entry_free(
+    ezcb_entry_t* e
+)
+{
+#ifdef EZCB_NO_MALLOC
+    ezcb_ctx_t* inst = e->shard->inst;
+
+    e->next = inst->entries_free;
+    inst->entries_free = e;
+    inst->entries_spare++;
+#else
+    ezcb_shard_t* s = e->shard;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_cols_t c = ezcb_cols(e);
+    for (size_t i = 0; i < e->count; i++)
+    {
+        ezcb_rcu_free(&c.cells[i]->head);
+    }
+    while (e->zombies)
+    {
+        ezcb_rcu_head_t* next = e->zombies->next;
+        ezcb_rcu_free(e->zombies);
+        e->zombies = next;
+    }
+    ezcb_snap_t* snap = EZCB_LOAD(e->snap);
+    if (snap) ezcb_rcu_free(&snap->head);
+#endif
+    EZCB_FREE(e->cbs);
+    if (e->trigger != e->name) ezcb_name_free(e->trigger);
+    ezcb_pool_free(&s->entries, e);
+#endif
+}
+
+#ifdef EZCB_NO_MALLOC
+/* Entries the static pool can still hand out, freed ones included */
+static size_t ezcb_entries_left(
+    ezcb_ctx_t* inst
+)
+{
+    return EZCB_MAX_TRIGGERS - inst->entries_used + inst->entries_spare;
+}
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+/* Snapshot with room for `count` callbacks; call with the shard mutex held */
+static ezcb_snap_t* ezcb_snap_alloc(
+    ezcb_ctx_t* inst,
+    size_t count
+)
+{
+    /* Short callback lists, the common case, reuse pooled snapshots */
+    ezcb_pool_t* pool = count <= EZCB_SNAP_POOLED ? &inst->snaps : NULL;
+
+    ezcb_snap_t* snap = (ezcb_snap_t*)(pool ? ezcb_pool_alloc(pool)
+                                            : EZCB_MALLOC(sizeof(ezcb_snap_t) + ezcb_cols_size(count, false)));
+    if (snap) snap->head.pool = pool;
+    return snap;
+}
+
+/*
+ * Fill snap, which has room for the entry's callbacks (or is NULL if there
+ * are none), publish it for lock-free triggers and retire the previous one.
+ * Call with the shard mutex held.
+ */
+static void ezcb_entry_install(
+    ezcb_entry_t* e,
+    ezcb_snap_t* snap
+)
+{
+    ezcb_ctx_t* inst = e->shard->inst;
+
+    if (snap)
+    {
+        ezcb_cols_t from = ezcb_cols(e);
+        ezcb_cols_t to = ezcb_cols_at(snap->calls, e->count, false);
+
+        snap->count = e->count;
+        ezcb_cols_move(&to, 0, &from, 0, e->count);
+    }
+
+    ezcb_snap_t* old = atomic_exchange(&e->snap, snap);
+    if (old) ezcb_rcu_retire(inst, &old->head);
+
+    /* Cells removed since the last publish are now unreachable from new readers */
+    while (e->zombies)
+    {
+        ezcb_rcu_head_t* next = e->zombies->next;
+        ezcb_rcu_retire(inst, e->zombies);
+        e->zombies = next;
+    }
+
+    ezcb_rcu_reclaim(inst);
+}
+
+/* Publish a fresh snapshot of the entry's callback array; call with the shard mutex held */
+static int ezcb_entry_publish(
+    ezcb_entry_t* e
+)
+{
+    ezcb_snap_t* snap = NULL;
+
+    if (e->count)
+    {
+        snap = ezcb_snap_alloc(e->shard->inst, e->count);
+        if (!snap) return -1;
+    }
+
+    ezcb_entry_install(e, snap);
+    return 0;
+}
+
+/*
+ * Mark a removed registration dead so triggers skip it, and park its cell
+ * until a snapshot without it has been published.
+ */
+static void ezcb_cell_kill(
+    ezcb_entry_t* e,
+    ezcb_cell_t* cell
+)
+{
+    atomic_store(&cell->dead, true);
+    cell->head.next = e->zombies;
+    e->zombies = &cell->head;
+}
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_OPEN_ADDRESSING
+/* Bytes for a table of `capacity` slots; *entries gets the offset of the entry array */
+static size_t ezcb_table_size(
+    size_t capacity,
+    size_t* entries
+)
+{
+    size_t ctrl = offsetof(ezcb_table_t, ctrl) + capacity + EZCB_GROUP_WIDTH;
+    *entries = (ctrl + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    return *entries + capacity * sizeof(ezcb_entry_t*);
+}
+
+static ezcb_table_t* ezcb_table_alloc(
+    size_t capacity
+)
+{
+    size_t entries;
+    ezcb_table_t* t = (ezcb_table_t*) EZCB_MALLOC(ezcb_table_size(capacity, &entries));
+    if (!t) return NULL;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    t->head.pool = NULL;
+#endif
+    t->capacity = capacity;
+    t->entries = (ezcb_entry_t**)((char*) t + entries);
+    memset(t->ctrl, EZCB_CTRL_EMPTY, capacity + EZCB_GROUP_WIDTH);
+    return t;
+}
+
+static void ezcb_table_free(
+    ezcb_table_t* t
+)
+{
+    EZCB_FREE(t);
+}
+
+static inline uint8_t ezcb_ctrl_h2(
+    uint32_t hash
+)
+{
+    /* Top bits, since the low ones pick the home slot */
+    return (uint8_t)(hash >> 25);
+}
+
+#ifdef EZCB_SSE2
+typedef __m128i ezcb_group_t;
+
+static inline ezcb_group_t ezcb_group_load(
+    const uint8_t* ctrl
+)
+{
+    return _mm_loadu_si128((const __m128i*) ctrl);
+}
+
+/* Slots whose fingerprint is exactly h2 */
+static inline ezcb_mask_t ezcb_group_match(
+    ezcb_group_t group,
+    uint8_t h2
+)
+{
+    return (ezcb_mask_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) h2)));
+}
+
+/* Slots that never held an entry; only these end a probe */
+static inline ezcb_mask_t ezcb_group_empty(
+    ezcb_group_t group
+)
+{
+    return (ezcb_mask_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) EZCB_CTRL_EMPTY)));
+}
+
+/* Slots an entry may be placed in: EZCB_CTRL_EMPTY and EZCB_CTRL_DELETED are the bytes with the high bit set */
+static inline ezcb_mask_t ezcb_group_free(
+    ezcb_group_t group
+)
+{
+    return (ezcb_mask_t) _mm_movemask_epi8(group);
+}
+#else
+typedef uint64_t ezcb_group_t;
+
+/* Control bytes of one group; byte i lands in bits 8i..8i+7 on any byte order */
+static inline ezcb_group_t ezcb_group_load(
+    const uint8_t* ctrl
+)
+{
+#ifdef EZCB_NEON
+    return vget_lane_u64(vreinterpret_u64_u8(vld1_u8(ctrl)), 0);
+#else
+    return (uint64_t) ctrl[0]       | (uint64_t) ctrl[1] << 8  |
+           (uint64_t) ctrl[2] << 16 | (uint64_t) ctrl[3] << 24 |
+           (uint64_t) ctrl[4] << 32 | (uint64_t) ctrl[5] << 40 |
+           (uint64_t) ctrl[6] << 48 | (uint64_t) ctrl[7] << 56;
+#endif
+}
+
+/*
+ * High bit of byte i set if slot i may hold fingerprint h2. NEON is exact;
+ * the portable version can flag a neighbouring full slot through a borrow,
+ * which the full hash check rejects. Empty slots are never flagged.
+ */
+static inline ezcb_mask_t ezcb_group_match(
+    ezcb_group_t group,
+    uint8_t h2
+)
+{
+#ifdef EZCB_NEON
+    uint8x8_t eq = vceq_u8(vcreate_u8(group), vdup_n_u8(h2));
+    return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ULL;
+#else
+    uint64_t x = group ^ (0x0101010101010101ULL * h2);
+    return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+#endif
+}
+
+static inline ezcb_mask_t ezcb_group_empty(
+    ezcb_group_t group
+)
+{
+#ifdef EZCB_NEON
+    uint8x8_t eq = vceq_u8(vcreate_u8(group), vdup_n_u8(EZCB_CTRL_EMPTY));
+    return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ULL;
+#else
+    /* Of the two bytes with the high bit set, only EZCB_CTRL_EMPTY has bit 1 clear */
+    return group & ~(group << 6) & 0x8080808080808080ULL;
+#endif
+}
+
+static inline ezcb_mask_t ezcb_group_free(
+    ezcb_group_t group
+)
+{
+    return group & 0x8080808080808080ULL;
+}
+#endif  /* EZCB_SSE2 */
+
+/* Slot offset of the lowest flagged slot in a match mask */
+static inline size_t ezcb_group_first(
+    ezcb_mask_t mask
+)
+{
+#ifdef EZCB_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t) __builtin_ctz(mask);
+#else
+    size_t i = 0;
+    while (!(mask & 1)) { mask >>= 1; i++; }
+    return i;
+#endif
+#else
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t) __builtin_ctzll(mask) >> 3;
+#else
+    size_t i = 0;
+    while (!(mask & 0x80)) { mask >>= 8; i++; }
+    return i;
+#endif
+#endif  /* EZCB_SSE2 */
+}
+
+static inline void ezcb_ctrl_set(
+    ezcb_table_t* t,
+    size_t i,
+    uint8_t ctrl
+)
+{
+    t->ctrl[i] = ctrl;
+    if (i < EZCB_GROUP_WIDTH) t->ctrl[t->capacity + i] = ctrl;
+}
+
+/*
+ * Store e in the first free slot of its probe sequence; the table must not
+ * be full. Returns whether that slot was a tombstone.
+ */
+static bool ezcb_table_place(
+    ezcb_table_t* t,
+    ezcb_entry_t* e
+)
+{
+    size_t mask = t->capacity - 1;
+    size_t pos = e->hash & mask;
+
+    for (size_t step = EZCB_GROUP_WIDTH;; step += EZCB_GROUP_WIDTH)
+    {
+        ezcb_mask_t slots = ezcb_group_free(ezcb_group_load(&t->ctrl[pos]));
+
+        if (slots)
+        {
+            size_t i = (pos + ezcb_group_first(slots)) & mask;
+            bool tomb = t->ctrl[i] == EZCB_CTRL_DELETED;
+
+            t->entries[i] = e;
+            ezcb_ctrl_set(t, i, ezcb_ctrl_h2(e->hash));
+            return tomb;
+        }
+
+        /* Triangular steps visit every group of a power-of-two table */
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Leave a tombstone in the slot of e, if the table holds it; returns whether it did */
+static bool ezcb_table_erase(
+    ezcb_table_t* t,
+    const ezcb_entry_t* e
+)
+{
+    size_t mask = t->capacity - 1;
+    size_t pos = e->hash & mask;
+    uint8_t h2 = ezcb_ctrl_h2(e->hash);
+
+    for (size_t step = EZCB_GROUP_WIDTH;; step += EZCB_GROUP_WIDTH)
+    {
+        ezcb_group_t group = ezcb_group_load(&t->ctrl[pos]);
+
+        for (ezcb_mask_t m = ezcb_group_match(group, h2); m; m &= m - 1)
+        {
+            size_t i = (pos + ezcb_group_first(m)) & mask;
+            if (t->entries[i] != e || t->ctrl[i] != h2) continue;
+
+            t->entries[i] = NULL;
+            ezcb_ctrl_set(t, i, EZCB_CTRL_DELETED);
+            return true;
+        }
+
+        if (ezcb_group_empty(group)) return false;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Link a new entry; with lock-free triggers a modified copy is published instead */
+static int ezcb_table_insert(
+    ezcb_shard_t* s,
+    ezcb_entry_t* e
+)
+{
+    ezcb_table_t* t = EZCB_LOAD(s->table);
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    size_t entries;
+    size_t size = ezcb_table_size(t->capacity, &entries);
+    ezcb_table_t* copy = (ezcb_table_t*) EZCB_MALLOC(size);
+    if (!copy) return -1;
+
+    memcpy(copy, t, size);
+    copy->entries = (ezcb_entry_t**)((char*) copy + entries);
+    if (ezcb_table_place(copy, e)) s->tombs--;
+
+    EZCB_STORE(s->table, copy);
+    ezcb_rcu_retire(s->inst, &t->head);
+    ezcb_rcu_reclaim(s->inst);
+#else
+    if (ezcb_table_place(t, e)) s->tombs--;
+#endif
+    return 0;
+}
+
+/* Unlink an entry, leaving a tombstone; with lock-free triggers a modified copy is published instead */
+static int ezcb_table_remove(
+    ezcb_shard_t* s,
+    ezcb_entry_t* e
+)
+{
+    ezcb_table_t* t = EZCB_LOAD(s->table);
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    size_t entries;
+    size_t size = ezcb_table_size(t->capacity, &entries);
+    ezcb_table_t* copy = (ezcb_table_t*) EZCB_MALLOC(size);
+    if (!copy) return -1;
+
+    memcpy(copy, t, size);
+    copy->entries = (ezcb_entry_t**)((char*) copy + entries);
+    if (ezcb_table_erase(copy, e)) s->tombs++;
+
+    EZCB_STORE(s->table, copy);
+    ezcb_rcu_retire(s->inst, &t->head);
+    ezcb_rcu_reclaim(s->inst);
+#else
+    if (ezcb_table_erase(t, e)) s->tombs++;
+#ifdef EZCB_REHASH
+    /* The old table may list it too, copied over or not */
+    if (s->old_table) (void) ezcb_table_erase(s->old_table, e);
+#endif
+#endif
+    return 0;
+}
+#else
+static int ezcb_table_insert(
+    ezcb_shard_t* s,
+    ezcb_entry_t* e
+)
+{
+    ezcb_slot_t* table = EZCB_LOAD(s->table);
+    uint32_t idx = e->hash & (EZCB_LOAD(s->buckets) - 1);
+    EZCB_STORE(e->next, EZCB_LOAD(table[idx]));
+    EZCB_STORE(table[idx], e);
+    return 0;
+}
+
+/* Unlink e from the chain holding it, if any */
+static bool ezcb_chain_unlink(
+    ezcb_slot_t* link,
+    ezcb_entry_t* e
+)
+{
+    for (ezcb_entry_t* f; (f = EZCB_LOAD(*link)) != NULL; link = &f->next)
+    {
+        if (f != e) continue;
+
+        /* Lock-free readers on e go on to the rest of the chain */
+        EZCB_STORE(*link, EZCB_LOAD(e->next));
+        return true;
+    }
+    return false;
+}
+
+/* Unlink an entry from its bucket, in the table or, not moved yet, in the old one */
+static int ezcb_table_remove(
+    ezcb_shard_t* s,
+    ezcb_entry_t* e
+)
+{
+    ezcb_slot_t* table = EZCB_LOAD(s->table);
+    if (ezcb_chain_unlink(&table[e->hash & (EZCB_LOAD(s->buckets) - 1)], e)) return 0;
+
+#ifdef EZCB_REHASH
+    ezcb_slot_t* old = EZCB_LOAD(s->old_table);
+    if (old) (void) ezcb_chain_unlink(&old[e->hash & (EZCB_LOAD(s->old_buckets) - 1)], e);
+#endif
+    return 0;
+}
+#endif  /* EZCB_OPEN_ADDRESSING */
+
+#if !defined(EZCB_NO_MALLOC) && !defined(EZCB_OPEN_ADDRESSING)
+static ezcb_slot_t* ezcb_table_alloc(
+    size_t buckets
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    /* Old tables are retired, so they carry a reclamation header */
+    ezcb_rcu_head_t* head = (ezcb_rcu_head_t*) ezcb_zalloc(sizeof(ezcb_rcu_head_t) + buckets * sizeof(ezcb_slot_t));
+    return head ? (ezcb_slot_t*)(head + 1) : NULL;
+#else
+    return (ezcb_slot_t*) ezcb_zalloc(buckets * sizeof(ezcb_slot_t));
+#endif
+}
+
+static void ezcb_table_free(
+    ezcb_slot_t* table
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    EZCB_FREE((ezcb_rcu_head_t*) table - 1);
+#else
+    EZCB_FREE(table);
+#endif
+}
+#endif
+
+/****************************************************************
+ * Resize
+ ****************************************************************/
+
+#ifdef EZCB_OPEN_ADDRESSING
+#ifdef EZCB_REHASH
+/* Copy up to n old slots into the current table; call with the shard mutex held */
+static void ezcb_rehash_step(
+    ezcb_shard_t* s,
+    size_t n
+)
+{
+    ezcb_table_t* old = s->old_table;
+    if (!old) return;
+
+    ezcb_table_t* table = s->table;
+    size_t end = old->capacity - s->rehash_pos > n ? s->rehash_pos + n : old->capacity;
+
+    /* Copied slots stay in the old table too, which is harmless: it holds the same entries */
+    for (size_t i = s->rehash_pos; i < end; i++)
+    {
+        if (!(old->ctrl[i] & EZCB_CTRL_EMPTY) && ezcb_table_place(table, old->entries[i])) s->tombs--;
+    }
+    s->rehash_pos = end;
+
+    if (end == old->capacity)
+    {
+        s->old_table = NULL;
+        ezcb_table_free(old);
+    }
+}
+#endif  /* EZCB_REHASH */
+
+static int ezcb_resize(
+    ezcb_shard_t* s,
+    size_t new_size
+)
+{
+    assert(new_size > 0 && (new_size & (new_size - 1)) == 0);
+
+#ifdef EZCB_REHASH
+    /* Only one old table drains at a time */
+    ezcb_rehash_step(s, SIZE_MAX);
+#endif
+
+    ezcb_table_t* new_table = ezcb_table_alloc(new_size);
+    if (!new_table) return -1;
+
+    ezcb_table_t* table = EZCB_LOAD(s->table);
+
+#ifdef EZCB_REHASH
+    s->old_table = table;
+    s->rehash_pos = 0;
+#else
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (!(table->ctrl[i] & EZCB_CTRL_EMPTY)) (void) ezcb_table_place(new_table, table->entries[i]);
+    }
+#endif
+
+    /* Readers take the capacity from the table itself */
+    EZCB_STORE(s->table, new_table);
+    EZCB_STORE(s->buckets, new_size);
+    s->tombs = 0;
+
+#ifdef EZCB_ENABLE_STATS
+    s->resizes++;
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_rcu_retire(s->inst, &table->head);
+    ezcb_rcu_reclaim(s->inst);
+#endif
+    return 0;
+}
+#elif !defined(EZCB_NO_MALLOC)
+/* Move the chains of up to n old buckets into the current table; call with the shard mutex held */
+static void ezcb_rehash_step(
+    ezcb_shard_t* s,
+    size_t n
+)
+{
+    ezcb_slot_t* old = EZCB_LOAD(s->old_table);
+    if (!old) return;
+
+    ezcb_slot_t* table = EZCB_LOAD(s->table);
+    size_t mask = EZCB_LOAD(s->buckets) - 1;
+    size_t old_buckets = EZCB_LOAD(s->old_buckets);
+    size_t end = old_buckets - s->rehash_pos > n ? s->rehash_pos + n : old_buckets;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    atomic_fetch_add(&s->resize_seq, 1);
+#endif
+
+    for (size_t i = s->rehash_pos; i < end; i++)
+    {
+        ezcb_entry_t* e = EZCB_LOAD(old[i]);
+        EZCB_STORE(old[i], NULL);
+
+        while (e)
+        {
+            ezcb_entry_t* next = EZCB_LOAD(e->next);
+            uint32_t idx = e->hash & mask;
+            EZCB_STORE(e->next, EZCB_LOAD(table[idx]));
+            EZCB_STORE(table[idx], e);
+            e = next;
+        }
+    }
+    s->rehash_pos = end;
+
+    bool drained = end == old_buckets;
+    if (drained)
+    {
+        EZCB_STORE(s->old_table, NULL);
+        EZCB_STORE(s->old_buckets, 0);
+    }
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    atomic_fetch_add(&s->resize_seq, 1);
+    if (drained)
+    {
+        ezcb_rcu_retire(s->inst, (ezcb_rcu_head_t*) old - 1);
+        ezcb_rcu_reclaim(s->inst);
+    }
+#else
+    if (drained) ezcb_table_free(old);
+#endif
+}
+
+static int ezcb_resize(
+    ezcb_shard_t* s,
+    size_t new_size
+)
+{
+    assert(new_size > 0 && (new_size & (new_size - 1)) == 0);
+
+    /* Only one old table drains at a time */
+    ezcb_rehash_step(s, SIZE_MAX);
+
+    ezcb_slot_t* new_table = ezcb_table_alloc(new_size);
+    if (!new_table) return -1;
+
+    ezcb_slot_t* table = EZCB_LOAD(s->table);
+    size_t buckets = EZCB_LOAD(s->buckets);
+
+    /* The entries stay where they are; ezcb_rehash_step() moves them over later */
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    atomic_fetch_add(&s->resize_seq, 1);
+#endif
+
+    EZCB_STORE(s->old_buckets, buckets);
+    EZCB_STORE(s->old_table, table);
+    s->rehash_pos = 0;
+    EZCB_STORE(s->buckets, new_size);
+    EZCB_STORE(s->table, new_table);
+
+#ifdef EZCB_ENABLE_STATS
+    s->resizes++;
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    atomic_fetch_add(&s->resize_seq, 1);
+#endif
+    return 0;
+}
+#endif
+
+#ifndef EZCB_NO_MALLOC
+/* Smallest table that holds `entries` without ezcb_entry_intern() growing it */
+static size_t ezcb_table_need(
+    size_t entries
+)
+{
+    size_t size = 16;
+    while (entries * 4 >= size * 3) size *= 2;
+    return size;
+}
+#endif
+
+/****************************************************************
+ * Entry lookup
+ ****************************************************************/
+
+#ifdef EZCB_OPEN_ADDRESSING
+static ezcb_entry_t* ezcb_table_find(
+    const ezcb_table_t* t,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    size_t mask = t->capacity - 1;
+    size_t pos = hash & mask;
+    uint8_t h2 = ezcb_ctrl_h2(hash);
+
+    for (size_t step = EZCB_GROUP_WIDTH;; step += EZCB_GROUP_WIDTH)
+    {
+        ezcb_group_t group = ezcb_group_load(&t->ctrl[pos]);
+
+        for (ezcb_mask_t m = ezcb_group_match(group, h2); m; m &= m - 1)
+        {
+            ezcb_entry_t* e = t->entries[(pos + ezcb_group_first(m)) & mask];
+            if (ezcb_entry_is(e, trigger, len, hash)) return e;
+        }
+
+        /* An empty slot ends the probe sequence: nothing was placed past it */
+        if (ezcb_group_empty(group)) return NULL;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Writer-side lookup; call with the shard mutex held */
+static ezcb_entry_t* ezcb_entry_find(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    ezcb_entry_t* e = ezcb_table_find(EZCB_LOAD(s->table), trigger, len, hash);
+
+#ifdef EZCB_REHASH
+    /* Entries not copied yet are only in the old table */
+    if (!e && s->old_table) e = ezcb_table_find(s->old_table, trigger, len, hash);
+#endif
+    return e;
+}
+
+/*
+ * Trigger-side lookup; call between ezcb_read_lock() and ezcb_read_unlock().
+ * Lock-free readers never see a table change under them, because inserts
+ * and resizes publish a new table and retire the old one.
+ */
+static ezcb_entry_t* ezcb_entry_lookup(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    ezcb_table_t* t = EZCB_LOAD(s->table);
+    if (!t) return NULL;
+
+#ifdef EZCB_REHASH
+    return ezcb_entry_find(s, trigger, len, hash);
+#else
+    return ezcb_table_find(t, trigger, len, hash);
+#endif
+}
+#else
+static ezcb_entry_t* ezcb_bucket_find(
+    ezcb_slot_t* table,
+    size_t buckets,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    /* Bucket counts are powers of two, so no divide on the lookup path */
+    ezcb_entry_t* e = EZCB_LOAD(table[hash & (buckets - 1)]);
+
+    while (e)
+    {
+        if (ezcb_entry_is(e, trigger, len, hash)) return e;
+        e = EZCB_LOAD(e->next);
+    }
+
+    return NULL;
+}
+
+/* Writer-side lookup; call with the shard mutex held */
+static ezcb_entry_t* ezcb_entry_find(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+    ezcb_entry_t* e = ezcb_bucket_find(EZCB_LOAD(s->table), EZCB_LOAD(s->buckets), trigger, len, hash);
+
+#ifdef EZCB_REHASH
+    /* Entries not moved yet are only in the old table */
+    ezcb_slot_t* old = EZCB_LOAD(s->old_table);
+    if (!e && old) e = ezcb_bucket_find(old, EZCB_LOAD(s->old_buckets), trigger, len, hash);
+#endif
+    return e;
+}
+
+/*
+ * Trigger-side lookup; call between ezcb_read_lock() and ezcb_read_unlock().
+ * A lock-free miss is only trusted if no entries moved meanwhile; otherwise
+ * the lookup is retried under the lock.
+ */
+static ezcb_entry_t* ezcb_entry_lookup(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    unsigned seq = atomic_load(&s->resize_seq);
+
+    if (!(seq & 1))
+    {
+        ezcb_slot_t* table = EZCB_LOAD(s->table);
+        size_t buckets = EZCB_LOAD(s->buckets);
+        ezcb_slot_t* old = EZCB_LOAD(s->old_table);
+        size_t old_buckets = EZCB_LOAD(s->old_buckets);
+
+        if (!table) return NULL;
+
+        if (atomic_load(&s->resize_seq) == seq)
+        {
+            ezcb_entry_t* e = ezcb_bucket_find(table, buckets, trigger, len, hash);
+            if (!e && old) e = ezcb_bucket_find(old, old_buckets, trigger, len, hash);
+            if (e || atomic_load(&s->resize_seq) == seq) return e;
+        }
+    }
+
+    ezcb_lock(s);
+    ezcb_entry_t* e = EZCB_LOAD(s->table) ? ezcb_entry_find(s, trigger, len, hash) : NULL;
+    ezcb_unlock(s);
+    return e;
+#else
+    return ezcb_entry_find(s, trigger, len, hash);
+#endif
+}
+#endif  /* EZCB_OPEN_ADDRESSING */
+
+/*
+ * Walk the entries of a shard; call with the shard mutex held. The next
+ * entry is fetched ahead, so the caller may free the one it was given.
+ */
+typedef struct ezcb_iter
+{
+    size_t pos;
+    ezcb_entry_t* next;
+} ezcb_iter_t;
+
+static ezcb_entry_t* ezcb_iter_next(
+    ezcb_shard_t* s,
+    ezcb_iter_t* it
+)
+{
+    ezcb_table_t* table = EZCB_LOAD(s->table);
+
+#ifdef EZCB_OPEN_ADDRESSING
+    while (it->pos < table->capacity)
+    {
+        size_t i = it->pos++;
+        if (!(table->ctrl[i] & EZCB_CTRL_EMPTY)) return table->entries[i];
+    }
+
+#ifdef EZCB_REHASH
+    /* Then the old slots not copied yet; positions past the table index them */
+    ezcb_table_t* old = s->old_table;
+    if (old && it->pos < table->capacity + s->rehash_pos) it->pos = table->capacity + s->rehash_pos;
+
+    while (old && it->pos - table->capacity < old->capacity)
+    {
+        size_t i = it->pos++ - table->capacity;
+        if (!(old->ctrl[i] & EZCB_CTRL_EMPTY)) return old->entries[i];
+    }
+#endif
+    return NULL;
+#else
+    size_t buckets = EZCB_LOAD(s->buckets);
+    ezcb_entry_t* e = it->next;
+
+    while (!e && it->pos < buckets)
+    {
+        e = EZCB_LOAD(table[it->pos++]);
+    }
+
+#ifdef EZCB_REHASH
+    /* Then the old buckets; positions past the table index them */
+    ezcb_slot_t* old = EZCB_LOAD(s->old_table);
+
+    while (!e && old && it->pos - buckets < EZCB_LOAD(s->old_buckets))
+    {
+        e = EZCB_LOAD(old[it->pos++ - buckets]);
+    }
+#endif
+
+    if (e) it->next = EZCB_LOAD(e->next);
+    return e;
+#endif
+}
+
+static void ezcb_entry_release(
+    ezcb_entry_t* e
+);
+
+#ifdef EZCB_ENABLE_PATTERNS
+static int ezcb_pattern_attach(
+    ezcb_entry_t* e
+);
+
+static void ezcb_trie_free(
+    ezcb_pnode_t* list
+);
+#endif
+
+/* Find or create the entry for a trigger; call with the shard mutex held */
+static ezcb_entry_t* ezcb_entry_intern(
+    ezcb_shard_t* s,
+    const char* trigger,
+    size_t len,
+    uint32_t hash
+)
+{
+#ifdef EZCB_REHASH
+    ezcb_rehash_step(s, EZCB_REHASH_STEP);
+#endif
+
+    ezcb_entry_t* e = ezcb_entry_find(s, trigger, len, hash);
+    if (e) return e;
+
+#ifdef EZCB_OPEN_ADDRESSING
+    /* Tombstones fill probe chains as live slots do; a table full of them is rebuilt at its size */
+    size_t buckets = EZCB_LOAD(s->buckets);
+    if ((s->count + s->tombs) * 4 >= buckets * 3)
+    {
+        if (ezcb_resize(s, s->count * 4 >= buckets * 3 ? buckets * 2 : buckets) != 0) return NULL;
+    }
+#elif !defined(EZCB_NO_MALLOC)
+    size_t buckets = EZCB_LOAD(s->buckets);
+    if (s->count * 4 >= buckets * 3)
+    {
+        if (ezcb_resize(s, buckets * 2) != 0) return NULL;
+    }
+#endif
+
+    e = ezcb_entry_alloc(s, trigger, len);
+    if (!e) return NULL;
+
+    e->hash = hash;
+    e->shard = s;
+    e->count = 0;
+    e->pinned = false;
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    e->live = 0;
+    e->firing = 0;
+    e->dirty = false;
+#endif
+#ifdef EZCB_STATIC_HANDLERS
+    e->statics = NULL;
+    e->nstatics = 0;
+#endif
+#ifndef EZCB_NO_MALLOC
+    e->cbs = NULL;
+    e->capacity = 0;
+#endif
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    atomic_init(&e->snap, NULL);
+    e->zombies = NULL;
+#endif
+#ifdef EZCB_ENABLE_STATS
+    ezcb_entry_stats_clear(e);
+#endif
+#ifdef EZCB_ENABLE_COALESCING
+    e->coalesce.on = false;
+#ifdef EZCB_ENABLE_ISR
+    atomic_init(&e->coalesce.isr_pending, false);
+    atomic_init(&e->coalesce.isr_data, NULL);
+    e->coalesce.interval = 0;
+    e->coalesce.ran = false;
+    e->coalesce.waiting = NULL;
+#endif
+#ifdef EZCB_ENABLE_EXECUTOR
+    atomic_init(&e->coalesce.post_pending, false);
+    atomic_init(&e->coalesce.post_data, NULL);
+#endif
+#endif  /* EZCB_ENABLE_COALESCING */
+#ifdef EZCB_ENABLE_PATTERNS
+    if (ezcb_pattern_attach(e) != 0)
+    {
+        ezcb_entry_free(e);
+        return NULL;
+    }
+#endif
+
+    if (ezcb_table_insert(s, e) != 0)
+    {
+        ezcb_entry_free(e);
+        return NULL;
+    }
+    s->count++;
+
+    return e;
+}
+
+#ifdef EZCB_STATIC_HANDLERS
+/*
+ * Attach the linker-section records to their entries. The first pass
+ * interns each trigger and counts its records; the second gives each entry
+ * its slice of ezcb_static_order and insertion-sorts the records into it.
+ */
+static int ezcb_static_bind(
+    ezcb_ctx_t* inst
+)
+{
+    size_t n = (size_t)(ezcb_static_end - ezcb_static_begin);
+    if (n == 0) return 0;
+
+#ifdef EZCB_NO_MALLOC
+    if (n > EZCB_MAX_STATIC_HANDLERS) return -1;
+#else
+    ezcb_static_order = (const ezcb_static_t**) EZCB_MALLOC(n * sizeof(ezcb_static_t*));
+    if (!ezcb_static_order) return -1;
+#endif
+
+    for (const ezcb_static_t* st = ezcb_static_begin; st < ezcb_static_end; st++)
+    {
+        size_t len;
+        uint32_t hash = ezcb_hash_len(st->trigger, &len);
+        ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+        ezcb_lock(s);
+        ezcb_entry_t* e = ezcb_entry_intern(s, st->trigger, len, hash);
+        if (e) e->nstatics++;
+        ezcb_unlock(s);
+
+        if (!e) return -1;
+    }
+
+    size_t used = 0;
+
+    for (const ezcb_static_t* st = ezcb_static_begin; st < ezcb_static_end; st++)
+    {
+        size_t len;
+        uint32_t hash = ezcb_hash_len(st->trigger, &len);
+        ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+        ezcb_lock(s);
+
+        ezcb_entry_t* e = ezcb_entry_find(s, st->trigger, len, hash);
+        if (!e->statics)
+        {
+            e->statics = ezcb_static_order + used;
+            used += e->nstatics;
+            e->nstatics = 0;
+        }
+
+        size_t pos = e->nstatics++;
+        while (pos > 0 && e->statics[pos - 1]->priority < st->priority)
+        {
+            e->statics[pos] = e->statics[pos - 1];
+            pos--;
+        }
+        e->statics[pos] = st;
+
+        ezcb_unlock(s);
+    }
+
+    return 0;
+}
+#endif  /* EZCB_STATIC_HANDLERS */
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+/****************************************************************
+ * Reverse index
+ ****************************************************************/
+
+/* Function pointers don't convert to integers portably, so fn is copied out bytewise */
+static uint32_t ezcb_ref_hash(
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    uintptr_t f = 0;
+    memcpy(&f, &fn, sizeof(fn) < sizeof(f) ? sizeof(fn) : sizeof(f));
+
+    uint64_t h = (uint64_t) f * 0x9E3779B97F4A7C15ULL ^
+                 (uint64_t)(uintptr_t) ctx * 0xC2B2AE3D27D4EB4FULL ^
+                 (uint64_t)(uintptr_t) e * 0x165667B19E3779F9ULL;
+    return (uint32_t)(h >> 32) ^ (uint32_t) h;
+}
+
+static ezcb_ref_t** ezcb_ref_chain(
+    ezcb_ref_t** p,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    while (*p && ((*p)->fn != fn || (*p)->ctx != ctx || (*p)->e != e))
+    {
+        p = &(*p)->next;
+    }
+    return p;
+}
+
+/*
+ * Link pointing to the key's ref, or to the end of its bucket's chain in
+ * the current buckets. New refs always go there; an old one is still in
+ * the old buckets until its bucket is moved.
+ */
+static ezcb_ref_t** ezcb_ref_find(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    uint32_t hash = ezcb_ref_hash(fn, ctx, e);
+    ezcb_ref_t** p = ezcb_ref_chain(&s->refs[hash & (s->ref_buckets - 1)], fn, ctx, e);
+
+    if (!*p && s->old_refs)
+    {
+        size_t i = hash & (s->old_ref_buckets - 1);
+        if (i >= s->ref_rehash_pos)
+        {
+            ezcb_ref_t** q = ezcb_ref_chain(&s->old_refs[i], fn, ctx, e);
+            if (*q) return q;
+        }
+    }
+    return p;
+}
+
+static ezcb_ref_t* ezcb_ref_get(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    return s->refs ? *ezcb_ref_find(s, fn, ctx, e) : NULL;
+}
+
+static void ezcb_ref_push(
+    ezcb_shard_t* s,
+    ezcb_ref_t* ref
+)
+{
+    ezcb_ref_t** bucket = &s->refs[ezcb_ref_hash(ref->fn, ref->ctx, ref->e) & (s->ref_buckets - 1)];
+
+    ref->next = *bucket;
+    *bucket = ref;
+}
+
+/* Unlink the ref that *p points to and free it */
+static void ezcb_ref_pop(
+    ezcb_shard_t* s,
+    ezcb_ref_t** p
+)
+{
+    ezcb_ref_t* ref = *p;
+
+    *p = ref->next;
+    s->nrefs--;
+    ezcb_pool_free(&s->ref_pool, ref);
+}
+
+/* Move the chains of up to n old buckets into the current ones, as ezcb_rehash_step() does */
+static void ezcb_refs_step(
+    ezcb_shard_t* s,
+    size_t n
+)
+{
+    ezcb_ref_t** old = s->old_refs;
+    if (!old) return;
+
+    size_t end = s->old_ref_buckets - s->ref_rehash_pos > n ? s->ref_rehash_pos + n : s->old_ref_buckets;
+
+    for (size_t i = s->ref_rehash_pos; i < end; i++)
+    {
+        for (ezcb_ref_t* ref = old[i], * next; ref; ref = next)
+        {
+            next = ref->next;
+            ezcb_ref_push(s, ref);
+        }
+        old[i] = NULL;
+    }
+    s->ref_rehash_pos = end;
+
+    if (end == s->old_ref_buckets)
+    {
+        EZCB_FREE(old);
+        s->old_refs = NULL;
+        s->old_ref_buckets = 0;
+    }
+}
+
+/*
+ * Resize the buckets; on failure the chains just get longer. The refs
+ * stay where they are, and later links move them over EZCB_REHASH_STEP
+ * old buckets at a time.
+ */
+static int ezcb_refs_resize(
+    ezcb_shard_t* s,
+    size_t buckets
+)
+{
+    /* Only one old table drains at a time */
+    ezcb_refs_step(s, SIZE_MAX);
+
+    ezcb_ref_t** refs = (ezcb_ref_t**) ezcb_zalloc(buckets * sizeof(ezcb_ref_t*));
+    if (!refs) return -1;
+
+    s->old_refs = s->refs;
+    s->old_ref_buckets = s->refs ? s->ref_buckets : 0;
+    s->ref_rehash_pos = 0;
+    s->refs = refs;
+    s->ref_buckets = buckets;
+    return 0;
+}
+
+/* Double the buckets, or create 16 */
+static int ezcb_refs_grow(
+    ezcb_shard_t* s
+)
+{
+    return ezcb_refs_resize(s, s->refs ? s->ref_buckets * 2 : 16);
+}
+
+static ezcb_ref_t* ezcb_ref_new(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    ezcb_ref_t* ref = (ezcb_ref_t*) ezcb_pool_alloc(&s->ref_pool);
+    if (!ref) return NULL;
+
+    ref->sib = NULL;
+    ref->pprev = NULL;
+    ref->fn = fn;
+    ref->ctx = ctx;
+    ref->e = e;
+    ref->count = 0;
+
+    ezcb_ref_push(s, ref);
+    s->nrefs++;
+    return ref;
+}
+
+/* Count one more record of e under fn, or under ctx when fn is NULL */
+static int ezcb_ref_acquire(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    ezcb_refs_step(s, EZCB_REHASH_STEP);
+    if (s->nrefs + 2 > s->ref_buckets && ezcb_refs_grow(s) != 0 && !s->refs) return -1;
+
+    ezcb_ref_t* ref = *ezcb_ref_find(s, fn, ctx, e);
+
+    if (!ref)
+    {
+        ezcb_ref_t* head = *ezcb_ref_find(s, fn, ctx, NULL);
+
+        if (!head && (head = ezcb_ref_new(s, fn, ctx, NULL)) == NULL) return -1;
+
+        ref = ezcb_ref_new(s, fn, ctx, e);
+        if (!ref)
+        {
+            if (!head->count) ezcb_ref_pop(s, ezcb_ref_find(s, fn, ctx, NULL));
+            return -1;
+        }
+
+        ref->sib = head->sib;
+        ref->pprev = &head->sib;
+        if (head->sib) head->sib->pprev = &ref->sib;
+        head->sib = ref;
+        head->count++;
+    }
+
+    ref->count++;
+    return 0;
+}
+
+/* Count one record fewer; e's last one drops its link, and the owner's last link its head */
+static void ezcb_ref_release(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx,
+    ezcb_entry_t* e
+)
+{
+    ezcb_refs_step(s, EZCB_REHASH_STEP);
+
+    ezcb_ref_t** p = ezcb_ref_find(s, fn, ctx, e);
+    ezcb_ref_t* ref = *p;
+    assert(ref != NULL);
+
+    if (--ref->count) return;
+
+    *ref->pprev = ref->sib;
+    if (ref->sib) ref->sib->pprev = ref->pprev;
+    ezcb_ref_pop(s, p);
+
+    ezcb_ref_t** h = ezcb_ref_find(s, fn, ctx, NULL);
+    if (--(*h)->count == 0) ezcb_ref_pop(s, h);
+}
+
+/* Index a record of e under its fn and, unless NULL, its ctx */
+static int ezcb_index_link(
+    ezcb_entry_t* e,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    ezcb_shard_t* s = e->shard;
+
+    if (ezcb_ref_acquire(s, fn, NULL, e) != 0) return -1;
+
+    if (ctx && ezcb_ref_acquire(s, NULL, ctx, e) != 0)
+    {
+        ezcb_ref_release(s, fn, NULL, e);
+        return -1;
+    }
+    return 0;
+}
+
+static void ezcb_index_unlink(
+    ezcb_entry_t* e,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    ezcb_ref_release(e->shard, fn, NULL, e);
+    if (ctx) ezcb_ref_release(e->shard, NULL, ctx, e);
+}
+
+/* A record leaving e's array; pattern copies are never indexed, as only pattern unregistering matches them */
+static void ezcb_index_drop(
+    ezcb_entry_t* e,
+    const ezcb_cb_t* cb
+)
+{
+#ifdef EZCB_ENABLE_PATTERNS
+    if (cb->sub) return;
+#endif
+    ezcb_index_unlink(e, cb->fn, cb->ctx);
+}
+
+/* Token id for a new record; 0 is never handed out */
+static uint32_t ezcb_token_next(
+    ezcb_shard_t* s
+)
+{
+    if (++s->last_id == 0) s->last_id = 1;
+    return s->last_id;
+}
+
+static void ezcb_index_clear(
+    ezcb_shard_t* s
+)
+{
+    EZCB_FREE(s->old_refs);
+    s->old_refs = NULL;
+    s->old_ref_buckets = 0;
+    EZCB_FREE(s->refs);
+    s->refs = NULL;
+    s->ref_buckets = 0;
+    s->nrefs = 0;
+    ezcb_pool_clear(&s->ref_pool);
+}
+
+/* Shrink the link table to what the links need and release idle pool chunks */
+static void ezcb_index_trim(
+    ezcb_shard_t* s
+)
+{
+    ezcb_refs_step(s, SIZE_MAX);
+
+    if (s->nrefs == 0)
+    {
+        EZCB_FREE(s->refs);
+        s->refs = NULL;
+        s->ref_buckets = 0;
+    }
+    else
+    {
+        size_t buckets = 16;
+        while (s->nrefs + 2 > buckets) buckets *= 2;
+
+        /* On failure the larger table is kept; compacting drains the old one at once */
+        if (buckets < s->ref_buckets && ezcb_refs_resize(s, buckets) == 0) ezcb_refs_step(s, SIZE_MAX);
+    }
+
+    ezcb_pool_trim(&s->ref_pool);
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+static void ezcb_ctx_deinit(
+    ezcb_ctx_t* inst
+);
+
+/****************************************************************
+ * Initialize
+ ****************************************************************/
+
+static int ezcb_ctx_init(
+    ezcb_ctx_t* inst
+)
+{
+    if (inst->ready) return 0;
+
+#ifdef EZCB_NO_MALLOC
+    ezcb_shard_t* s = &inst->shards[0];
+
+    EZCB_MUTEX_INIT(s->mtx);
+
+    s->inst = inst;
+    memset(inst->table_static, 0, sizeof(inst->table_static));
+    inst->cbs_used = 0;
+    inst->entries_used = 0;
+    inst->entries_free = NULL;
+    inst->entries_spare = 0;
+    s->buckets = EZCB_MAX_BUCKETS;
+    s->table = inst->table_static;
+    s->count = 0;
+#else
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_table_t* table = ezcb_table_alloc(16);
+
+        if (!table)
+        {
+            while (i-- > 0)
+            {
+                ezcb_table_free(EZCB_LOAD(inst->shards[i].table));
+                EZCB_STORE(inst->shards[i].table, NULL);
+                EZCB_MUTEX_DESTROY(inst->shards[i].mtx);
+            }
+            return -1;
+        }
+
+        EZCB_MUTEX_INIT(s->mtx);
+
+        s->inst = inst;
+        ezcb_pool_init(&s->entries, sizeof(ezcb_entry_t));
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+        ezcb_pool_init(&s->ref_pool, sizeof(ezcb_ref_t));
+#endif
+        /* Buckets first: lock-free readers load the table, then its size */
+        s->count = 0;
+#ifdef EZCB_ENABLE_STATS
+        s->resizes = 0;
+#endif
+#ifdef EZCB_REHASH
+        EZCB_STORE(s->old_table, NULL);
+#ifndef EZCB_OPEN_ADDRESSING
+        EZCB_STORE(s->old_buckets, 0);
+#endif
+        s->rehash_pos = 0;
+#endif
+        EZCB_STORE(s->buckets, 16);
+        EZCB_STORE(s->table, table);
+    }
+#endif
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_pool_init(&inst->cells, sizeof(ezcb_cell_t));
+    ezcb_pool_init(&inst->snaps, sizeof(ezcb_snap_t) + ezcb_cols_size(EZCB_SNAP_POOLED, false));
+#endif
+    inst->ready = true;
+
+#ifdef EZCB_STATIC_HANDLERS
+    if (inst == &ezcb_default && ezcb_static_bind(inst) != 0)
+    {
+        ezcb_ctx_deinit(inst);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Triggering an instance nothing was registered on has nothing to run, so
+ * triggers do not initialize it; but the default instance's static
+ * handlers need no registration, so its first trigger links them.
+ */
+static inline bool ezcb_ctx_ready(
+    ezcb_ctx_t* inst
+)
+{
+    if (inst->ready) return true;
+#ifdef EZCB_STATIC_HANDLERS
+    if (inst == &ezcb_default && ezcb_static_end - ezcb_static_begin > 0) return ezcb_ctx_init(inst) == 0;
+#endif
+    return false;
+}
+
+void ezcb_init(void)
+{
+    (void) ezcb_ctx_init(&ezcb_default);
+}
+
+ezcb_ctx_t* ezcb_create(void)
+{
+#ifdef EZCB_NO_MALLOC
+#if EZCB_MAX_CONTEXTS > 0
+    for (size_t i = 0; i < EZCB_MAX_CONTEXTS; i++)
+    {
+        ezcb_ctx_t* inst = &ezcb_ctx_pool[i];
+
+        if (!inst->ready)
+        {
+            memset(inst, 0, sizeof(*inst));
+            return ezcb_ctx_init(inst) == 0 ? inst : NULL;
+        }
+    }
+#endif
+    return NULL;
+#else
+    ezcb_ctx_t* inst = (ezcb_ctx_t*) ezcb_zalloc(sizeof(ezcb_ctx_t));
+    if (!inst) return NULL;
+
+    if (ezcb_ctx_init(inst) != 0)
+    {
+        EZCB_FREE(inst);
+        return NULL;
+    }
+    return inst;
+#endif
+}
+
+/****************************************************************
+ * Deinitialize
+ ****************************************************************/
+
+static void ezcb_ctx_deinit(
+    ezcb_ctx_t* inst
+)
+{
+    /* Not ezcb_ctx_ready(): an unused instance has nothing to tear down */
+    if (!inst->ready) return;
+
+#ifdef EZCB_ENABLE_EXECUTOR
+    /* Workers need the shard locks to finish what is queued */
+    ezcb_executor_stop_ex(inst);
+#endif
+
+    ezcb_lock_all(inst);
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    /* First, as retired entries go back to the entry pools cleared below */
+    while (inst->retired)
+    {
+        ezcb_rcu_head_t* next = inst->retired->next;
+        ezcb_rcu_free(inst->retired);
+        inst->retired = next;
+    }
+#endif
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            ezcb_entry_free(e);
+        }
+
+#ifndef EZCB_NO_MALLOC
+        ezcb_table_free(EZCB_LOAD(s->table));
+        ezcb_pool_clear(&s->entries);
+#endif  /* EZCB_NO_MALLOC */
+#ifdef EZCB_REHASH
+        if (EZCB_LOAD(s->old_table)) ezcb_table_free(EZCB_LOAD(s->old_table));
+        EZCB_STORE(s->old_table, NULL);
+#ifndef EZCB_OPEN_ADDRESSING
+        EZCB_STORE(s->old_buckets, 0);
+#endif
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+        ezcb_index_clear(s);
+#endif
+
+        EZCB_STORE(s->table, NULL);
+        EZCB_STORE(s->buckets, 0);
+        s->count = 0;
+    }
+
+#ifdef EZCB_ENABLE_PATTERNS
+    ezcb_trie_free(inst->patterns);
+    inst->patterns = NULL;
+    EZCB_STORE(inst->npatterns, 0);
+#endif
+
+#if defined(EZCB_STATIC_HANDLERS) && !defined(EZCB_NO_MALLOC)
+    if (inst == &ezcb_default)
+    {
+        EZCB_FREE(ezcb_static_order);
+        ezcb_static_order = NULL;
+    }
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_pool_clear(&inst->cells);
+    ezcb_pool_clear(&inst->snaps);
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_ENABLE_ISR
+    for (size_t p = 0; p < EZCB_EVENT_PRIORITIES; p++)
+    {
+        ezcb_evt_ring_t* ring = &inst->evt_rings[p];
+
+        for (size_t i = 0; i < EZCB_EVENT_QUEUE_SIZE; i++)
+        {
+            atomic_store_explicit(&ring->slots[i].seq, 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+        ring->tail = 0;
+    }
+
+    for (size_t i = 0; i < EZCB_REC_UNITS; i++)
+    {
+        atomic_store_explicit(&inst->rec_ready[i], false, memory_order_relaxed);
+    }
+    atomic_store_explicit(&inst->rec_head, 0, memory_order_relaxed);
+    atomic_store_explicit(&inst->rec_tail, 0, memory_order_relaxed);
+    inst->rec_next = 0;
+#ifdef EZCB_ENABLE_COALESCING
+    inst->coalesce_waiting = NULL;
+#endif
+#endif  /* EZCB_ENABLE_ISR */
+
+    inst->ready = false;
+
+    for (size_t i = EZCB_SHARDS; i-- > 0;)
+    {
+        ezcb_unlock(&inst->shards[i]);
+        EZCB_MUTEX_DESTROY(inst->shards[i].mtx);
+    }
+}
+
+void ezcb_deinit(void)
+{
+    ezcb_ctx_deinit(&ezcb_default);
+}
+
+void ezcb_destroy(
+    ezcb_ctx_t* inst
+)
+{
+    assert(inst != NULL);
+
+    ezcb_ctx_deinit(inst);
+#ifndef EZCB_NO_MALLOC
+    EZCB_FREE(inst);
+#endif
+}
+
+/****************************************************************
+ * Resolve
+ ****************************************************************/
+
+ezcb_handle_t ezcb_resolve_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return NULL;
+
+    size_t len;
+    uint32_t hash = ezcb_hash_len(trigger, &len);
+    ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+    ezcb_lock(s);
+    ezcb_entry_t* e = ezcb_entry_intern(s, trigger, len, hash);
+    if (e) e->pinned = true;
+    ezcb_unlock(s);
+
+    return e;
+}
+
+/****************************************************************
+ * Register
+ ****************************************************************/
+
+/*
+ * Where a new record goes: after every record of equal or higher priority.
+ * While the entry is being walked, its records must keep their places, so
+ * the new one is appended and ezcb_entry_settle() sorts it in afterwards.
+ */
+static size_t ezcb_cb_slot(
+    ezcb_entry_t* e,
+    uint8_t priority
+)
+{
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    if (e->firing)
+    {
+        e->dirty = true;
+        return e->count;
+    }
+#endif
+
+    const uint8_t* keys = ezcb_cols(e).keys;
+    size_t pos = 0;
+
+    while (pos < e->count && keys[pos] >= priority)
+    {
+        pos++;
+    }
+    return pos;
+}
+
+static void ezcb_cb_fill(
+    ezcb_entry_t* e,
+    ezcb_cb_t* cb,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    uint8_t flags,
+    ezcb_sub_t* sub
+)
+{
+    cb->fn = fn;
+    cb->ctx = ctx;
+    cb->priority = priority;
+    cb->flags = flags;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    cb->cell = NULL;
+#endif
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    cb->id = ezcb_token_next(e->shard);
+#else
+    (void) e;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    cb->sub = sub;
+#else
+    (void) sub;
+#endif
+}
+
+static int ezcb_entry_insert(
+    ezcb_entry_t* e,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    uint8_t flags,
+    ezcb_sub_t* sub
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_pool_t* cells = &e->shard->inst->cells;
+    ezcb_cell_t* cell = (ezcb_cell_t*) ezcb_pool_alloc(cells);
+    if (!cell) return -1;
+
+    cell->head.pool = cells;
+    atomic_init(&cell->dead, false);
+#endif
+
+    if (ezcb_cbs_grow(e) != 0)
+    {
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        ezcb_pool_free(cells, cell);
+#endif
+        return -1;
+    }
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    if (!sub && ezcb_index_link(e, fn, ctx) != 0)
+    {
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        ezcb_pool_free(cells, cell);
+#endif
+        return -1;
+    }
+#endif
+
+    size_t pos = ezcb_cb_slot(e, priority);
+    ezcb_cols_t c = ezcb_cols(e);
+    ezcb_cb_t cb;
+
+    ezcb_cols_move(&c, pos + 1, &c, pos, e->count - pos);
+
+    ezcb_cb_fill(e, &cb, priority, fn, ctx, flags, sub);
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    cb.cell = cell;
+#endif
+    ezcb_cb_put(&c, pos, &cb);
+    e->count++;
+
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    if (!e->firing) e->live = e->count;
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    if (ezcb_entry_publish(e) != 0)
+    {
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+        ezcb_index_drop(e, &cb);
+#endif
+        ezcb_entry_remove_at(e, pos);
+        ezcb_pool_free(cells, cell);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+static int ezcb_register_internal(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    uint8_t flags
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+    assert(fn != NULL);
+
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+
+    size_t len;
+    uint32_t hash = ezcb_hash_len(trigger, &len);
+    ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+    ezcb_lock(s);
+
+    ezcb_entry_t* e = ezcb_entry_intern(s, trigger, len, hash);
+    int r = e ? ezcb_entry_insert(e, priority, fn, ctx, flags, NULL) : -1;
+
+    /* A parallel group may still run on the executor after the trigger returned */
+    if (r == 0 && (flags & EZCB_CB_PARALLEL)) e->pinned = true;
+    if (r != 0 && e) ezcb_entry_release(e);
+
+    ezcb_unlock(s);
+    return r;
+}
+
+static int ezcb_register_h_internal(
+    ezcb_handle_t handle,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    uint8_t flags
+)
+{
+    assert(handle != NULL);
+    assert(fn != NULL);
+
+    ezcb_shard_t* s = handle->shard;
+
+    ezcb_lock(s);
+    int r = ezcb_entry_insert(handle, priority, fn, ctx, flags, NULL);
+    ezcb_unlock(s);
+
+    return r;
+}
+
+int ezcb_register_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_internal(inst, trigger, priority, fn, ctx, 0);
+}
+
+int ezcb_register_once_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_internal(inst, trigger, priority, fn, ctx, EZCB_CB_ONCE);
+}
+
+int ezcb_register_h(
+    ezcb_handle_t handle,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_h_internal(handle, priority, fn, ctx, 0);
+}
+
+int ezcb_register_once_h(
+    ezcb_handle_t handle,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_h_internal(handle, priority, fn, ctx, EZCB_CB_ONCE);
+}
+
+int ezcb_register_batch_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_batch_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_internal(inst, trigger, priority, (ezcb_fn_t)(void (*)(void)) fn, ctx, EZCB_CB_BATCH);
+}
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+ezcb_token_t ezcb_register_token_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+    assert(fn != NULL);
+
+    ezcb_token_t token = { NULL, 0 };
+
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return token;
+
+    size_t len;
+    uint32_t hash = ezcb_hash_len(trigger, &len);
+    ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+    ezcb_lock(s);
+
+    ezcb_entry_t* e = ezcb_entry_intern(s, trigger, len, hash);
+
+    if (e && ezcb_entry_insert(e, priority, fn, ctx, 0, NULL) == 0)
+    {
+        /* The record just inserted took the latest id; the token keeps the entry */
+        e->pinned = true;
+        token.handle = e;
+        token.id = s->last_id;
+    }
+    else if (e)
+    {
+        ezcb_entry_release(e);
+    }
+
+    ezcb_unlock(s);
+    return token;
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+#ifndef EZCB_NO_MALLOC
+/* One record of an ezcb_register_many() or ezcb_restore() call */
+typedef struct ezcb_bulk
+{
+    const ezcb_reg_t* reg;
+    uint32_t hash;
+    size_t len;
+    uint8_t flags;              /* EZCB_CB_* the record gets */
+    size_t group;               /* Index of its entry's group */
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_cell_t* cell;
+#endif
+} ezcb_bulk_t;
+
+/* The records of an ezcb_register_many() call that go to one entry */
+typedef struct ezcb_bulk_group
+{
+    ezcb_entry_t* e;
+    size_t first;               /* Start of its records in the sorted order */
+    size_t count;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_snap_t* snap;
+#endif
+} ezcb_bulk_group_t;
+
+/* Grow each shard's table once, to hold every trigger the call may add */
+static int ezcb_bulk_presize(
+    ezcb_ctx_t* inst,
+    const ezcb_bulk_t* bulk,
+    size_t n
+)
+{
+    size_t adds[EZCB_SHARDS] = { 0 };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ezcb_shard_t* s = ezcb_shard_of(inst, bulk[i].hash);
+        if (!ezcb_entry_find(s, bulk[i].reg->trigger, bulk[i].len, bulk[i].hash)) adds[s - inst->shards]++;
+    }
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        size_t size = ezcb_table_need(s->count + adds[i]);
+
+        if (size > EZCB_LOAD(s->buckets) && ezcb_resize(s, size) != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Group of the entry, added if new. Groups are found through an open-addressed
+ * map of `mask + 1` slots, each holding a group's index plus one, or 0 if free.
+ */
+static size_t ezcb_bulk_group_of(
+    ezcb_bulk_group_t* groups,
+    size_t* ngroups,
+    size_t* slots,
+    size_t mask,
+    ezcb_entry_t* e
+)
+{
+    size_t i = e->hash & mask;
+
+    while (slots[i] && groups[slots[i] - 1].e != e)
+    {
+        i = (i + 1) & mask;
+    }
+
+    if (!slots[i])
+    {
+        groups[*ngroups].e = e;
+        slots[i] = ++*ngroups;
+    }
+    return slots[i] - 1;
+}
+
+/*
+ * Merge g records, sorted like the entry's, into its columns, which have
+ * room for them. Filling them from the back moves each old record only
+ * once and needs no scratch space; on a tie the old record stays in front.
+ */
+static void ezcb_bulk_merge(
+    ezcb_entry_t* e,
+    ezcb_bulk_t* const* recs,
+    size_t g
+)
+{
+    ezcb_cols_t c = ezcb_cols(e);
+    size_t i = e->count;
+    size_t w = e->count + g;
+
+    e->count = w;
+
+    while (g > 0)
+    {
+        const ezcb_bulk_t* b = recs[g - 1];
+
+        if (i > 0 && c.keys[i - 1] < b->reg->priority)
+        {
+            ezcb_cols_move(&c, --w, &c, i - 1, 1);
+            i--;
+            continue;
+        }
+
+        ezcb_cb_t cb;
+        ezcb_cb_fill(e, &cb, b->reg->priority, b->reg->fn, b->reg->ctx, b->flags, NULL);
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        cb.cell = b->cell;
+#endif
+        ezcb_cb_put(&c, --w, &cb);
+        g--;
+    }
+}
+
+/*
+ * Register n hashed records, in order, with every shard locked: presize
+ * the tables, intern the entries, sort each entry's new records, reserve
+ * all that can fail, then merge. Either all of them go in or none does.
+ */
+static int ezcb_bulk_register(
+    ezcb_ctx_t* inst,
+    ezcb_bulk_t* bulk,
+    size_t n
+)
+{
+    if (!ezcb_may_lock_all()) return -1;
+
+    /* Group map at most half full */
+    size_t mask = 1;
+    while (mask < n * 2) mask = mask * 2 + 1;
+
+    ezcb_bulk_group_t* groups = (ezcb_bulk_group_t*) ezcb_zalloc(n * (sizeof(ezcb_bulk_group_t) + sizeof(ezcb_bulk_t*)) +
+                                                                 (mask + 1) * sizeof(size_t));
+    if (!groups) return -1;
+
+    ezcb_bulk_t** order = (ezcb_bulk_t**)(groups + n);
+    size_t* slots = (size_t*)(order + n);
+    size_t ngroups = 0;
+
+    ezcb_lock_all(inst);
+
+    int r = ezcb_bulk_presize(inst, bulk, n);
+
+    for (size_t i = 0; r == 0 && i < n; i++)
+    {
+        ezcb_shard_t* s = ezcb_shard_of(inst, bulk[i].hash);
+        ezcb_entry_t* e = ezcb_entry_intern(s, bulk[i].reg->trigger, bulk[i].len, bulk[i].hash);
+
+        if (!e)
+        {
+            r = -1;
+            break;
+        }
+        bulk[i].group = ezcb_bulk_group_of(groups, &ngroups, slots, mask, e);
+        groups[bulk[i].group].count++;
+    }
+
+    if (r == 0)
+    {
+        /* Lay the records out group by group, keeping the call's order */
+        for (size_t j = 0, sum = 0; j < ngroups; j++)
+        {
+            groups[j].first = sum;
+            sum += groups[j].count;
+        }
+        for (size_t i = 0; i < n; i++) order[groups[bulk[i].group].first++] = &bulk[i];
+
+        /* Then sort each group like the records; a stable insertion sort, as groups are short */
+        for (size_t j = 0; j < ngroups; j++)
+        {
+            ezcb_bulk_group_t* g = &groups[j];
+            g->first -= g->count;
+
+            ezcb_bulk_t** recs = order + g->first;
+            for (size_t k = 1; k < g->count; k++)
+            {
+                ezcb_bulk_t* b = recs[k];
+                size_t at = k;
+
+                while (at > 0 && recs[at - 1]->reg->priority < b->reg->priority)
+                {
+                    recs[at] = recs[at - 1];
+                    at--;
+                }
+                recs[at] = b;
+            }
+        }
+    }
+
+    /* Reserve everything that can fail before registering anything */
+    for (size_t j = 0; r == 0 && j < ngroups; j++)
+    {
+        ezcb_bulk_group_t* g = &groups[j];
+
+        r = ezcb_cbs_reserve(g->e, g->e->count + g->count);
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        if (r == 0)
+        {
+            g->snap = ezcb_snap_alloc(inst, g->e->count + g->count);
+            if (!g->snap) r = -1;
+        }
+#endif
+    }
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    for (size_t i = 0; r == 0 && i < n; i++)
+    {
+        bulk[i].cell = (ezcb_cell_t*) ezcb_pool_alloc(&inst->cells);
+        if (!bulk[i].cell)
+        {
+            r = -1;
+            break;
+        }
+        bulk[i].cell->head.pool = &inst->cells;
+        atomic_init(&bulk[i].cell->dead, false);
+    }
+#endif
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    size_t linked = 0;
+
+    while (r == 0 && linked < n)
+    {
+        const ezcb_reg_t* reg = bulk[linked].reg;
+
+        if (ezcb_index_link(groups[bulk[linked].group].e, reg->fn, reg->ctx) != 0) r = -1;
+        else linked++;
+    }
+#endif
+
+    for (size_t j = 0; r == 0 && j < ngroups; j++)
+    {
+        ezcb_bulk_group_t* g = &groups[j];
+        ezcb_entry_t* e = g->e;
+
+#ifndef EZCB_LOCK_FREE_TRIGGER
+        /* Mid-walk, append like ezcb_entry_insert() does; the walk's end sorts them in */
+        if (e->firing)
+        {
+            ezcb_cols_t c = ezcb_cols(e);
+
+            for (size_t k = g->first; k < g->first + g->count; k++)
+            {
+                const ezcb_reg_t* reg = order[k]->reg;
+                ezcb_cb_t cb;
+
+                ezcb_cb_fill(e, &cb, reg->priority, reg->fn, reg->ctx, order[k]->flags, NULL);
+                ezcb_cb_put(&c, e->count++, &cb);
+            }
+            e->dirty = true;
+            continue;
+        }
+#endif
+
+        ezcb_bulk_merge(e, order + g->first, g->count);
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        ezcb_entry_install(e, g->snap);
+#else
+        e->live = e->count;
+#endif
+    }
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+    for (size_t i = 0; r != 0 && i < linked; i++)
+    {
+        ezcb_index_unlink(groups[bulk[i].group].e, bulk[i].reg->fn, bulk[i].reg->ctx);
+    }
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    if (r != 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (bulk[i].cell) ezcb_pool_free(&inst->cells, bulk[i].cell);
+        }
+        for (size_t j = 0; j < ngroups; j++)
+        {
+            if (groups[j].snap) ezcb_rcu_free(&groups[j].snap->head);
+        }
+    }
+#endif
+
+    ezcb_unlock_all(inst);
+    EZCB_FREE(groups);
+    return r;
+}
+#endif  /* EZCB_NO_MALLOC */
+
+int ezcb_register_many_ex(
+    ezcb_ctx_t* inst,
+    const ezcb_reg_t* regs,
+    size_t n
+)
+{
+    assert(inst != NULL);
+    assert(regs != NULL || n == 0);
+
+    if (n == 0) return 0;
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+
+#ifdef EZCB_NO_MALLOC
+    ezcb_shard_t* s = &inst->shards[0];
+
+    ezcb_lock(s);
+
+    /* Check the static pools first, so that a failure registers nothing */
+    int r = inst->cbs_used + n <= EZCB_MAX_NODES ? 0 : -1;
+    size_t adds = 0;
+
+    for (size_t i = 0; r == 0 && i < n; i++)
+    {
+        const char* trigger = regs[i].trigger;
+        assert(trigger != NULL && regs[i].fn != NULL);
+
+        size_t len;
+        uint32_t hash = ezcb_hash_len(trigger, &len);
+
+        if (len >= EZCB_MAX_TRIGGER_LENGTH) r = -1;
+        if (r != 0 || ezcb_entry_find(s, trigger, len, hash)) continue;
+
+        /* Count each new name once; the pools are small, so this stays cheap */
+        size_t k = 0;
+        while (k < i && strcmp(regs[k].trigger, trigger) != 0) k++;
+        if (k == i) adds++;
+    }
+    if (adds > ezcb_entries_left(inst)) r = -1;
+
+    for (size_t i = 0; r == 0 && i < n; i++)
+    {
+        const ezcb_reg_t* reg = &regs[i];
+        size_t len;
+        uint32_t hash = ezcb_hash_len(reg->trigger, &len);
+
+        ezcb_entry_t* e = ezcb_entry_intern(s, reg->trigger, len, hash);
+        r = e ? ezcb_entry_insert(e, reg->priority, reg->fn, reg->ctx, 0, NULL) : -1;
+    }
+
+    ezcb_unlock(s);
+    return r;
+#else
+    ezcb_bulk_t* bulk = (ezcb_bulk_t*) ezcb_zalloc(n * sizeof(ezcb_bulk_t));
+    if (!bulk) return -1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        assert(regs[i].trigger != NULL && regs[i].fn != NULL);
+
+        bulk[i].reg = &regs[i];
+        bulk[i].hash = ezcb_hash_len(regs[i].trigger, &bulk[i].len);
+    }
+
+    int r = ezcb_bulk_register(inst, bulk, n);
+
+    EZCB_FREE(bulk);
+    return r;
+#endif
+}
+
+
+/****************************************************************
+ * Unregister
+ ****************************************************************/
+
+/*
+ * Whether a record goes: a plain one matching the wildcard fn and ctx, or
+ * with subs set, a copy of an unregistered pattern callback.
+ */
+static bool ezcb_cb_match(
+    const ezcb_cb_t* cb,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool subs
+)
+{
+#ifdef EZCB_ENABLE_PATTERNS
+    if (cb->sub) return subs && cb->sub->dead;
+#endif
+    return !subs &&
+           (fn  == NULL || cb->fn  == fn) &&
+           (ctx == NULL || cb->ctx == ctx);
+}
+
+#ifndef EZCB_LOCK_FREE_TRIGGER
+/*
+ * Apply the changes made while the entry was walked: drop the dead
+ * records, then sort the ones added meanwhile into place, in the order
+ * they were registered.
+ */
+static void ezcb_entry_settle(
+    ezcb_entry_t* e
+)
+{
+    ezcb_cols_t c = ezcb_cols(e);
+    size_t kept = 0;
+    size_t live = 0;
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        if (c.flags[i] & EZCB_CB_DEAD)
+        {
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+            ezcb_cb_t cb = ezcb_cb_get(&c, i);
+            ezcb_index_drop(e, &cb);
+#endif
+            continue;
+        }
+        if (i < e->live) live++;
+        ezcb_cols_move(&c, kept++, &c, i, 1);
+    }
+    ezcb_cbs_truncate(e, kept);
+    c = ezcb_cols(e);
+
+    for (size_t k = live; k < kept; k++)
+    {
+        ezcb_cb_t cb = ezcb_cb_get(&c, k);
+        size_t pos = k;
+
+        while (pos > 0 && c.keys[pos - 1] < cb.priority)
+        {
+            ezcb_cols_move(&c, pos, &c, pos - 1, 1);
+            pos--;
+        }
+        ezcb_cb_put(&c, pos, &cb);
+    }
+
+    e->live = kept;
+    e->dirty = false;
+}
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+/*
+ * Unpublish the records left on an entry taken out of the table and retire
+ * it, with its name, as lock-free triggers may still be on it.
+ */
+static void ezcb_entry_retire(
+    ezcb_entry_t* e
+)
+{
+    ezcb_shard_t* s = e->shard;
+    ezcb_ctx_t* inst = s->inst;
+    ezcb_cols_t c = ezcb_cols(e);
+
+    /* Only pattern copies are left, which a trigger still on the entry may as well run */
+    for (size_t i = 0; i < e->count; i++)
+    {
+        c.cells[i]->head.next = e->zombies;
+        e->zombies = &c.cells[i]->head;
+    }
+    e->count = 0;
+    ezcb_entry_install(e, NULL);
+    (void) ezcb_cbs_realloc(e, 0);
+
+    if (e->trigger != e->name) ezcb_rcu_retire(inst, (ezcb_rcu_head_t*) e->trigger - 1);
+    e->head.pool = &s->entries;
+    ezcb_rcu_retire(inst, &e->head);
+    ezcb_rcu_reclaim(inst);
+}
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+/*
+ * Halve a table that freed entries left at most an eighth used, as often
+ * as that holds, never below the initial 16 or the reserved size. A table
+ * grows at three quarters, so one that was just shrunk has room before it
+ * doubles again. With EZCB_REHASH the entries move over incrementally, as
+ * after growing. Call with the shard mutex held.
+ */
+static void ezcb_table_shrink(
+    ezcb_shard_t* s
+)
+{
+#ifdef EZCB_NO_MALLOC
+    (void) s;
+#else
+    if (s->sweeping) return;
+
+    size_t buckets = EZCB_LOAD(s->buckets);
+    size_t size = buckets;
+    while (size > 16 && size > s->floor && s->count * 8 <= size) size /= 2;
+
+    /* On failure the larger table is kept */
+    if (size < buckets) (void) ezcb_resize(s, size);
+#endif
+}
+
+/* Resizing would move the entries an ezcb_iter_t walks, so freeing them waits to shrink the table */
+static inline void ezcb_sweep_begin(
+    ezcb_shard_t* s
+)
+{
+#ifdef EZCB_NO_MALLOC
+    (void) s;
+#else
+    s->sweeping = true;
+#endif
+}
+
+static inline void ezcb_sweep_end(
+    ezcb_shard_t* s
+)
+{
+#ifdef EZCB_NO_MALLOC
+    (void) s;
+#else
+    s->sweeping = false;
+#endif
+    ezcb_table_shrink(s);
+}
+
+/*
+ * Free an entry nothing keeps: no handle to it, no walk on it, no static
+ * handler and no record but pattern copies, which the trigger-side
+ * fallback runs as well. Call with the shard mutex held, and do not touch
+ * the entry afterwards.
+ */
+static void ezcb_entry_release(
+    ezcb_entry_t* e
+)
+{
+    if (e->pinned) return;
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    if (e->firing) return;
+#endif
+#ifdef EZCB_STATIC_HANDLERS
+    if (e->nstatics) return;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    ezcb_cols_t c = ezcb_cols(e);
+    for (size_t i = 0; i < e->count; i++)
+    {
+        if (!c.meta[i].sub) return;
+    }
+#else
+    if (e->count) return;
+#endif
+
+    ezcb_shard_t* s = e->shard;
+
+    /* Lock-free, the table is copied to drop the entry; without the memory it stays */
+    if (ezcb_table_remove(s, e) != 0) return;
+    s->count--;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_entry_retire(e);
+#else
+    ezcb_entry_free(e);
+#endif
+    ezcb_table_shrink(s);
+}
+
+/* Mark the matching records dead; ezcb_entry_purge() drops them */
+static int ezcb_entry_mark(
+    ezcb_entry_t* e,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool subs
+)
+{
+    ezcb_cols_t c = ezcb_cols(e);
+    int marked = 0;
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        ezcb_cb_t cb = ezcb_cb_get(&c, i);
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        /* Readers skip a dead cell at once; a one-shot a reader claims first is already gone */
+        if (!ezcb_cb_match(&cb, fn, ctx, subs) || atomic_exchange(&cb.cell->dead, true)) continue;
+#else
+        if ((cb.flags & EZCB_CB_DEAD) || !ezcb_cb_match(&cb, fn, ctx, subs)) continue;
+        c.flags[i] |= EZCB_CB_DEAD;
+#endif
+        marked++;
+    }
+
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    if (marked) e->dirty = true;
+#endif
+    return marked;
+}
+
+/*
+ * Drop the dead records, unless the entry is being walked; the walk's end
+ * does it then. An entry left with nothing to keep is freed.
+ */
+static void ezcb_entry_purge(
+    ezcb_entry_t* e
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_cols_t c = ezcb_cols(e);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        if (atomic_load(&c.cells[i]->dead))
+        {
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+            ezcb_cb_t cb = ezcb_cb_get(&c, i);
+            ezcb_index_drop(e, &cb);
+#endif
+            ezcb_cell_kill(e, c.cells[i]);
+            continue;
+        }
+
+        ezcb_cols_move(&c, kept++, &c, i, 1);
+    }
+
+    if (kept == e->count) return;
+    ezcb_cbs_truncate(e, kept);
+
+    /* On failure, readers keep the old snapshot but skip the dead cells */
+    (void) ezcb_entry_publish(e);
+#else
+    if (!e->dirty || e->firing) return;
+    ezcb_entry_settle(e);
+#endif
+
+    ezcb_entry_release(e);
+}
+
+static int ezcb_entry_remove(
+    ezcb_entry_t* e,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool subs
+)
+{
+    int removed = ezcb_entry_mark(e, fn, ctx, subs);
+    if (removed) ezcb_entry_purge(e);
+    return removed;
+}
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+/* Wildcard unregister in one shard, visiting only the entries indexed under ctx, or else fn */
+static int ezcb_index_remove(
+    ezcb_shard_t* s,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    ezcb_ref_t* head = ctx ? ezcb_ref_get(s, NULL, ctx, NULL) : ezcb_ref_get(s, fn, NULL, NULL);
+    int removed = 0;
+
+    for (ezcb_ref_t* ref = head ? head->sib : NULL, * next; ref; ref = next)
+    {
+        /* Removing from one entry may free its link, and after the last link the head */
+        next = ref->sib;
+        removed += ezcb_entry_remove(ref->e, fn, ctx, false);
+    }
+    return removed;
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+int ezcb_unregister_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+
+    if (!inst->ready) return 0;
+
+    int removed = 0;
+
+    if (trigger)
+    {
+        size_t len;
+        uint32_t hash = ezcb_hash_len(trigger, &len);
+        ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+        ezcb_lock(s);
+
+        ezcb_entry_t* e = ezcb_entry_find(s, trigger, len, hash);
+        if (e) removed = ezcb_entry_remove(e, fn, ctx, false);
+
+        ezcb_unlock(s);
+        return removed;
+    }
+
+#ifdef EZCB_ENABLE_PATTERNS
+    removed = ezcb_unregister_pattern_ex(inst, NULL, fn, ctx);
+#endif
+
+    /* Wildcard: visit every shard in turn */
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+
+        ezcb_lock(s);
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+        if (fn || ctx)
+        {
+            removed += ezcb_index_remove(s, fn, ctx);
+            ezcb_unlock(s);
+            continue;
+        }
+#endif
+
+        ezcb_iter_t it = { 0, NULL };
+        ezcb_sweep_begin(s);
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            removed += ezcb_entry_remove(e, fn, ctx, false);
+        }
+        ezcb_sweep_end(s);
+
+        ezcb_unlock(s);
+    }
+
+    return removed;
+}
+
+int ezcb_unregister_batch_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    ezcb_batch_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_unregister_ex(inst, trigger, (ezcb_fn_t)(void (*)(void)) fn, ctx);
+}
+
+int ezcb_unregister_many_ex(
+    ezcb_ctx_t* inst,
+    const ezcb_reg_t* regs,
+    size_t n
+)
+{
+    assert(inst != NULL);
+    assert(regs != NULL || n == 0);
+
+    if (!inst->ready) return 0;
+
+    int removed = 0;
+
+    /* From a callback, one trigger at a time, as separate ezcb_unregister() calls would */
+    if (!ezcb_may_lock_all())
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            assert(regs[i].trigger != NULL);
+            removed += ezcb_unregister_ex(inst, regs[i].trigger, regs[i].fn, regs[i].ctx);
+        }
+        return removed;
+    }
+
+    ezcb_lock_all(inst);
+
+    /* Mark every match first, so that each array is compacted once */
+    for (size_t i = 0; i < n; i++)
+    {
+        assert(regs[i].trigger != NULL);
+
+        size_t len;
+        uint32_t hash = ezcb_hash_len(regs[i].trigger, &len);
+        ezcb_entry_t* e = ezcb_entry_find(ezcb_shard_of(inst, hash), regs[i].trigger, len, hash);
+        if (e) removed += ezcb_entry_mark(e, regs[i].fn, regs[i].ctx, false);
+    }
+
+    for (size_t i = 0; removed && i < n; i++)
+    {
+        size_t len;
+        uint32_t hash = ezcb_hash_len(regs[i].trigger, &len);
+        ezcb_entry_t* e = ezcb_entry_find(ezcb_shard_of(inst, hash), regs[i].trigger, len, hash);
+        if (e) ezcb_entry_purge(e);
+    }
+
+    ezcb_unlock_all(inst);
+    return removed;
+}
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+int ezcb_unregister_token(
+    ezcb_token_t token
+)
+{
+    ezcb_entry_t* e = token.handle;
+    if (!e) return 0;
+
+    ezcb_shard_t* s = e->shard;
+    int removed = 0;
+
+    ezcb_lock(s);
+
+    ezcb_cols_t c = ezcb_cols(e);
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        if (c.meta[i].id != token.id) continue;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        removed = !atomic_exchange(&c.cells[i]->dead, true);
+#else
+        removed = !(c.flags[i] & EZCB_CB_DEAD);
+        c.flags[i] |= EZCB_CB_DEAD;
+        e->dirty = true;
+#endif
+        break;
+    }
+
+    if (removed) ezcb_entry_purge(e);
+
+    ezcb_unlock(s);
+    return removed;
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
+
+
+/****************************************************************
+ * Patterns
+ ****************************************************************/
+
+#ifdef EZCB_ENABLE_PATTERNS
+/* Length of the segment starting at s */
+static inline size_t ezcb_seg_len(
+    const char* s
+)
+{
+    return strcspn(s, ".");
+}
+
+static inline bool ezcb_pnode_is(
+    const ezcb_pnode_t* n,
+    char wild
+)
+{
+    return n->len == 1 && n->seg[0] == wild;
+}
+
+/* Non-empty segments, and "#" in the last one only */
+static bool ezcb_pattern_valid(
+    const char* p
+)
+{
+    for (;;)
+    {
+        size_t len = ezcb_seg_len(p);
+        if (len == 0) return false;
+        if (!p[len]) return true;
+        if (len == 1 && *p == '#') return false;
+        p += len + 1;
+    }
+}
+
+/* Match one trigger name, segment by segment; the trie does the same for all patterns at once */
+static bool ezcb_pattern_match(
+    const char* p,
+    const char* name
+)
+{
+    for (;;)
+    {
+        size_t plen = ezcb_seg_len(p);
+        size_t nlen = ezcb_seg_len(name);
+
+        if (plen == 1 && *p == '#') return true;
+        if (!(plen == 1 && *p == '*') &&
+            !(plen == nlen && memcmp(p, name, plen) == 0)) return false;
+
+        p += plen;
+        name += nlen;
+
+        /* A trailing "#" also matches no segment at all */
+        if (!*name) return !*p || strcmp(p, ".#") == 0;
+        if (!*p) return false;
+
+        p++;
+        name++;
+    }
+}
+
+/* Node for a pattern, created along with its parents if asked */
+static ezcb_pnode_t* ezcb_trie_path(
+    ezcb_pnode_t** list,
+    const char* pattern,
+    bool create
+)
+{
+    for (;;)
+    {
+        size_t len = ezcb_seg_len(pattern);
+        ezcb_pnode_t* n = *list;
+
+        while (n && !(n->len == len && memcmp(n->seg, pattern, len) == 0))
+        {
+            n = n->next;
+        }
+
+        if (!n)
+        {
+            if (!create) return NULL;
+
+            /* Nodes left empty by a failure here are pruned by ezcb_trie_reap() */
+            n = (ezcb_pnode_t*) EZCB_MALLOC(sizeof(ezcb_pnode_t) + len);
+            if (!n) return NULL;
+
+            memcpy(n->seg, pattern, len);
+            n->len = len;
+            n->child = NULL;
+            n->subs = NULL;
+            n->next = *list;
+            *list = n;
+        }
+
+        if (!pattern[len]) return n;
+
+        pattern += len + 1;
+        list = &n->child;
+    }
+}
+
+/* Add the live callbacks of a pattern to e, or with e NULL gather them into g */
+static int ezcb_subs_offer(
+    ezcb_sub_t* sub,
+    ezcb_entry_t* e,
+    ezcb_pgather_t* g
+)
+{
+    int found = 0;
+
+    for (; sub; sub = sub->next)
+    {
+        if (sub->dead) continue;
+
+        if (e)
+        {
+            if (ezcb_entry_insert(e, sub->priority, sub->fn, sub->ctx, 0, sub) != 0) return -1;
+        }
+        else
+        {
+            if (g->count < g->cap)
+            {
+                ezcb_pmatch_t* m = &g->buf[g->count];
+                m->sub = sub;
+                m->fn = sub->fn;
+                m->ctx = sub->ctx;
+                m->priority = sub->priority;
+            }
+            g->count++;
+        }
+        found++;
+    }
+    return found;
+}
+
+/*
+ * Offer the callbacks of every pattern below list that matches name, to e
+ * or, with e NULL, to g. Returns how many there were, or -1 if adding one
+ * to e failed.
+ */
+static int ezcb_trie_match(
+    ezcb_pnode_t* list,
+    const char* name,
+    ezcb_entry_t* e,
+    ezcb_pgather_t* g
+)
+{
+    size_t len = ezcb_seg_len(name);
+    const char* rest = name[len] ? name + len + 1 : NULL;
+    int found = 0;
+
+    for (ezcb_pnode_t* n = list; n; n = n->next)
+    {
+        int r = 0;
+
+        if (ezcb_pnode_is(n, '#'))
+        {
+            r = ezcb_subs_offer(n->subs, e, g);
+        }
+        else if (ezcb_pnode_is(n, '*') || (n->len == len && memcmp(n->seg, name, len) == 0))
+        {
+            if (rest)
+            {
+                r = ezcb_trie_match(n->child, rest, e, g);
+            }
+            else
+            {
+                r = ezcb_subs_offer(n->subs, e, g);
+
+                /* The name ends here, where a trailing "#" matches no segment */
+                for (ezcb_pnode_t* c = n->child; c && r >= 0; c = c->next)
+                {
+                    if (!ezcb_pnode_is(c, '#')) continue;
+
+                    int t = ezcb_subs_offer(c->subs, e, g);
+                    r = t < 0 ? t : r + t;
+                }
+            }
+        }
+
+        if (r < 0) return -1;
+        found += r;
+    }
+    return found;
+}
+
+static int ezcb_subs_mark(
+    ezcb_sub_t* sub,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    int marked = 0;
+
+    for (; sub; sub = sub->next)
+    {
+        if (!sub->dead &&
+            (fn  == NULL || sub->fn  == fn) &&
+            (ctx == NULL || sub->ctx == ctx))
+        {
+            sub->dead = true;
+            marked++;
+        }
+    }
+    return marked;
+}
+
+static int ezcb_trie_mark(
+    ezcb_pnode_t* list,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    int marked = 0;
+
+    for (ezcb_pnode_t* n = list; n; n = n->next)
+    {
+        marked += ezcb_subs_mark(n->subs, fn, ctx);
+        marked += ezcb_trie_mark(n->child, fn, ctx);
+    }
+    return marked;
+}
+
+/* Free the dead callbacks and prune the nodes left with nothing below them */
+static void ezcb_trie_reap(
+    ezcb_pnode_t** list
+)
+{
+    while (*list)
+    {
+        ezcb_pnode_t* n = *list;
+
+        for (ezcb_sub_t** p = &n->subs; *p;)
+        {
+            ezcb_sub_t* sub = *p;
+            if (!sub->dead)
+            {
+                p = &sub->next;
+                continue;
+            }
+            *p = sub->next;
+            EZCB_FREE(sub);
+        }
+
+        ezcb_trie_reap(&n->child);
+
+        if (n->subs || n->child)
+        {
+            list = &n->next;
+            continue;
+        }
+        *list = n->next;
+        EZCB_FREE(n);
+    }
+}
+
+static void ezcb_trie_free(
+    ezcb_pnode_t* list
+)
+{
+    while (list)
+    {
+        ezcb_pnode_t* next = list->next;
+
+        while (list->subs)
+        {
+            ezcb_sub_t* sub = list->subs->next;
+            EZCB_FREE(list->subs);
+            list->subs = sub;
+        }
+
+        ezcb_trie_free(list->child);
+        EZCB_FREE(list);
+        list = next;
+    }
+}
+
+/*
+ * Drop the copies of dead pattern callbacks from every entry, then free the
+ * callbacks. Call with every shard mutex held.
+ */
+static void ezcb_pattern_sweep(
+    ezcb_ctx_t* inst
+)
+{
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        ezcb_sweep_begin(s);
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            (void) ezcb_entry_remove(e, NULL, NULL, true);
+        }
+        ezcb_sweep_end(s);
+    }
+
+    ezcb_trie_reap(&inst->patterns);
+    EZCB_STORE(inst->pattern_gen, EZCB_LOAD(inst->pattern_gen) + 1);
+}
+
+/* Give a new entry a copy of each matching pattern callback; call with its shard mutex held */
+static int ezcb_pattern_attach(
+    ezcb_entry_t* e
+)
+{
+    ezcb_ctx_t* inst = e->shard->inst;
+
+    if (!EZCB_LOAD(inst->npatterns)) return 0;
+    return ezcb_trie_match(inst->patterns, e->trigger, e, NULL) < 0 ? -1 : 0;
+}
+
+/* Matches gathered on the stack for an unknown trigger; more go to the heap */
+#define EZCB_PATTERN_LOCAL      16
+
+/*
+ * Gather the live pattern callbacks matching trigger, in the order an entry
+ * would hold them: by priority, then as the trie offers them, which is how
+ * ezcb_pattern_attach() inserts them. *out is local, with room for
+ * EZCB_PATTERN_LOCAL, or a heap block if more match. Returns how many, or
+ * (size_t) -1 if that block could not be had.
+ */
+static size_t ezcb_pattern_gather(
+    ezcb_shard_t* s,
+    const char* trigger,
+    ezcb_pmatch_t* local,
+    ezcb_pmatch_t** out
+)
+{
+    ezcb_ctx_t* inst = s->inst;
+    ezcb_pgather_t g = { local, EZCB_PATTERN_LOCAL, 0 };
+
+    ezcb_lock(s);
+
+    (void) ezcb_trie_match(inst->patterns, trigger, NULL, &g);
+    if (g.count > g.cap)
+    {
+        /* The trie cannot change while the mutex is held, so a second pass finds the same */
+        g.buf = (ezcb_pmatch_t*) EZCB_MALLOC(g.count * sizeof(ezcb_pmatch_t));
+        if (!g.buf)
+        {
+            ezcb_unlock(s);
+            return (size_t) -1;
+        }
+        g.cap = g.count;
+        g.count = 0;
+        (void) ezcb_trie_match(inst->patterns, trigger, NULL, &g);
+    }
+
+    ezcb_unlock(s);
+
+    /* Stable, so equal priorities keep the trie's order */
+    for (size_t i = 1; i < g.count; i++)
+    {
+        ezcb_pmatch_t m = g.buf[i];
+        size_t j = i;
+
+        while (j > 0 && g.buf[j - 1].priority < m.priority)
+        {
+            g.buf[j] = g.buf[j - 1];
+            j--;
+        }
+        g.buf[j] = m;
+    }
+
+    *out = g.buf;
+    return g.count;
+}
+
+/* Keep the matches still registered, after a callback freed pattern callbacks; returns how many */
+static size_t ezcb_pattern_recheck(
+    ezcb_shard_t* s,
+    const char* trigger,
+    ezcb_pmatch_t* m,
+    size_t count
+)
+{
+    ezcb_pmatch_t local[EZCB_PATTERN_LOCAL];
+    ezcb_pmatch_t* live;
+
+    /* Out of memory, the rest are dropped rather than risk a freed one */
+    size_t nlive = ezcb_pattern_gather(s, trigger, local, &live);
+    if (nlive == (size_t) -1) return 0;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < nlive; j++)
+        {
+            if (live[j].sub == m[i].sub && live[j].fn == m[i].fn && live[j].ctx == m[i].ctx)
+            {
+                m[kept++] = m[i];
+                break;
+            }
+        }
+    }
+
+    if (live != local) EZCB_FREE(live);
+    return kept;
+}
+
+int ezcb_register_pattern_ex(
+    ezcb_ctx_t* inst,
+    const char* pattern,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+    assert(pattern != NULL);
+    assert(fn != NULL);
+
+    if (!ezcb_pattern_valid(pattern) || !ezcb_may_lock_all()) return -1;
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+
+    ezcb_sub_t* sub = (ezcb_sub_t*) EZCB_MALLOC(sizeof(ezcb_sub_t));
+    if (!sub) return -1;
+
+    sub->fn = fn;
+    sub->ctx = ctx;
+    sub->priority = priority;
+    sub->dead = false;
+
+    ezcb_lock_all(inst);
+
+    ezcb_pnode_t* n = ezcb_trie_path(&inst->patterns, pattern, true);
+    if (!n)
+    {
+        ezcb_trie_reap(&inst->patterns);
+        ezcb_unlock_all(inst);
+        EZCB_FREE(sub);
+        return -1;
+    }
+
+    /* Appended, so equal priorities keep their registration order */
+    ezcb_sub_t** tail = &n->subs;
+    while (*tail) tail = &(*tail)->next;
+    sub->next = NULL;
+    *tail = sub;
+
+    /* Entries created from now on pick the callback up in ezcb_pattern_attach() */
+    int r = 0;
+    for (size_t i = 0; i < EZCB_SHARDS && r == 0; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        for (ezcb_entry_t* e; r == 0 && (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            if (!ezcb_pattern_match(pattern, e->trigger)) continue;
+            r = ezcb_entry_insert(e, priority, fn, ctx, 0, sub);
+        }
+    }
+
+    if (r == 0)
+    {
+        EZCB_STORE(inst->npatterns, EZCB_LOAD(inst->npatterns) + 1);
+    }
+    else
+    {
+        sub->dead = true;
+        ezcb_pattern_sweep(inst);
+    }
+
+    ezcb_unlock_all(inst);
+    return r;
+}
+
+int ezcb_unregister_pattern_ex(
+    ezcb_ctx_t* inst,
+    const char* pattern,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+
+    if (!inst->ready) return 0;
+    if (!ezcb_may_lock_all()) return -1;
+
+    ezcb_lock_all(inst);
+
+    int removed = 0;
+    if (!pattern)
+    {
+        removed = ezcb_trie_mark(inst->patterns, fn, ctx);
+    }
+    else
+    {
+        ezcb_pnode_t* n = ezcb_trie_path(&inst->patterns, pattern, false);
+        if (n) removed = ezcb_subs_mark(n->subs, fn, ctx);
+    }
+
+    if (removed)
+    {
+        ezcb_pattern_sweep(inst);
+        EZCB_STORE(inst->npatterns, EZCB_LOAD(inst->npatterns) - (size_t) removed);
+    }
+
+    ezcb_unlock_all(inst);
+    return removed;
+}
+#endif  /* EZCB_ENABLE_PATTERNS */
+
+/****************************************************************
+ * Trigger
+ ****************************************************************/
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+/* Drop a fired one-shot callback from the entry, if still registered */
+static void ezcb_entry_reap(
+    ezcb_entry_t* e,
+    ezcb_cell_t* cell
+)
+{
+    ezcb_shard_t* s = e->shard;
+
+    ezcb_lock(s);
+
+    ezcb_cols_t c = ezcb_cols(e);
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        if (c.cells[i] == cell)
+        {
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+            ezcb_cb_t cb = ezcb_cb_get(&c, i);
+            ezcb_index_drop(e, &cb);
+#endif
+            ezcb_cell_kill(e, cell);
+            ezcb_entry_remove_at(e, i);
+            (void) ezcb_entry_publish(e);
+            ezcb_entry_release(e);
+            break;
+        }
+    }
+
+    ezcb_unlock(s);
+}
+#endif  /* EZCB_LOCK_FREE_TRIGGER */
+
+#ifdef EZCB_DEFAULT_TICKS
+/* Microseconds, wrapping; follows the wall clock where timespec_get() exists */
+static uint32_t ezcb_ticks(void)
+{
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && defined(TIME_UTC)
+    struct timespec ts;
+    if (timespec_get(&ts, TIME_UTC) == TIME_UTC)
+    {
+        return (uint32_t)((uint64_t) ts.tv_sec * 1000000u + (uint64_t) ts.tv_nsec / 1000u);
+    }
+#endif
+    return (uint32_t)((uint64_t) clock() * 1000000u / CLOCKS_PER_SEC);
+}
+#endif  /* EZCB_DEFAULT_TICKS */
+
+#ifdef EZCB_ENABLE_STATS
+static void ezcb_stat_max(
+    EZCB_ATOMIC(uint32_t)* x,
+    uint32_t v
+)
+{
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    uint32_t cur = atomic_load_explicit(x, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(x, &cur, v, memory_order_relaxed,
+                                                             memory_order_relaxed)) {}
+#else
+    if (v > *x) *x = v;
+#endif
+}
+#endif  /* EZCB_ENABLE_STATS */
+
+#ifdef EZCB_ENABLE_LATENCY
+/* Histogram bucket of a value: its top EZCB_LATENCY_PRECISION + 1 bits */
+static inline size_t ezcb_latency_bucket(
+    uint32_t v
+)
+{
+    if (v < (1u << EZCB_LATENCY_PRECISION)) return v;
+
+#if defined(__GNUC__) || defined(__clang__)
+    unsigned top = 31u - (unsigned) __builtin_clz(v);
+#else
+    unsigned top = 0;
+    while (v >> top >> 1) top++;
+#endif
+    unsigned shift = top - EZCB_LATENCY_PRECISION;
+    return ((size_t)(shift + 1) << EZCB_LATENCY_PRECISION) |
+           ((v >> shift) & ((1u << EZCB_LATENCY_PRECISION) - 1));
+}
+
+static void ezcb_latency_sample(
+    ezcb_entry_t* e,
+    uint32_t ticks
+)
+{
+    EZCB_STAT_ADD(e->stats.latency[ezcb_latency_bucket(ticks)], 1);
+    ezcb_stat_max(&e->stats.latency_max, ticks);
+}
+#endif  /* EZCB_ENABLE_LATENCY */
+
+/*
+ * Run one record over a group of payloads. A batch callback sees the whole
+ * group; a plain one runs per payload (a one-shot only for the first), and
+ * payloads it stops are dropped for the records after it. Returns
+ * EZCB_STOP once nothing is left to deliver.
+ */
+static ezcb_result_t ezcb_cb_invoke(
+    ezcb_entry_t* e,
+    const ezcb_call_t* call,
+    uint8_t flags,
+    void** data,
+    size_t* n
+)
+{
+    (void) e;
+
+    ezcb_result_t r;
+
+#ifdef EZCB_ENABLE_LATENCY
+    ezcb_ctx_t* inst = e->shard->inst;
+    ezcb_cb_hook_fn_t hook = inst->cb_hook;
+    uint32_t start = hook ? (uint32_t) EZCB_TICKS() : 0;
+#endif
+
+    if (flags & EZCB_CB_BATCH)
+    {
+#ifdef EZCB_ENABLE_STATS
+        EZCB_STAT_ADD(e->stats.invocations, 1);
+#endif
+        ezcb_batch_fn_t fn = (ezcb_batch_fn_t)(void (*)(void)) call->fn;
+        r = fn(call->ctx, data, *n);
+    }
+    else
+    {
+        size_t kept = 0;
+        size_t i = 0;
+
+        while (i < *n)
+        {
+            void* d = data[i++];
+            if (call->fn(call->ctx, d) == EZCB_CONTINUE) data[kept++] = d;
+            if (flags & EZCB_CB_ONCE) break;
+        }
+
+#ifdef EZCB_ENABLE_STATS
+        EZCB_STAT_ADD(e->stats.invocations, (uint32_t) i);
+#endif
+
+        /* Payloads a one-shot never saw carry on untouched */
+        while (i < *n)
+        {
+            data[kept++] = data[i++];
+        }
+
+        *n = kept;
+        r = kept ? EZCB_CONTINUE : EZCB_STOP;
+    }
+
+#ifdef EZCB_ENABLE_LATENCY
+    if (hook)
+    {
+        hook(inst->cb_hook_ctx, e->trigger, call->fn, call->ctx, start, (uint32_t) EZCB_TICKS() - start);
+    }
+#endif
+    return r;
+}
+
+#ifdef EZCB_STATIC_HANDLERS
+/*
+ * Run the entry's static handlers from *next on while they rank at or
+ * above floor, the priority of the runtime callback about to run (-1 for
+ * all that are left).
+ */
+static ezcb_result_t ezcb_static_fire(
+    ezcb_entry_t* e,
+    size_t* next,
+    int floor,
+    void** data,
+    size_t* n
+)
+{
+    while (*next < e->nstatics && (int) e->statics[*next]->priority >= floor)
+    {
+        const ezcb_static_t* st = e->statics[(*next)++];
+        ezcb_call_t call;
+
+        call.fn = st->fn;
+        call.ctx = st->ctx;
+
+        if (ezcb_cb_invoke(e, &call, 0, data, n) == EZCB_STOP) return EZCB_STOP;
+    }
+    return EZCB_CONTINUE;
+}
+#endif  /* EZCB_STATIC_HANDLERS */
+
+#ifdef EZCB_FANOUT
+static int ezcb_executor_post(
+    ezcb_executor_t* ex,
+    const ezcb_task_t* task
+);
+
+/* A group for count calls, from the free list when it is small enough */
+static ezcb_fanout_t* ezcb_fanout_get(
+    ezcb_executor_t* ex,
+    size_t count
+)
+{
+    ezcb_fanout_t* f = NULL;
+    bool pooled = count <= EZCB_FANOUT_POOLED;
+
+    if (pooled)
+    {
+        mtx_lock(&ex->mtx);
+        f = ex->groups;
+        if (f) ex->groups = f->free_next;
+        mtx_unlock(&ex->mtx);
+
+        if (f) return f;
+        count = EZCB_FANOUT_POOLED;
+    }
+
+    f = (ezcb_fanout_t*) EZCB_MALLOC(sizeof(ezcb_fanout_t) + count * sizeof(ezcb_call_t));
+    if (f) f->pooled = pooled;
+    return f;
+}
+
+static void ezcb_fanout_release(
+    ezcb_fanout_t* f
+)
+{
+    ezcb_executor_t* ex = f->ex;
+
+    if (!f->pooled)
+    {
+        EZCB_FREE(f);
+        return;
+    }
+
+    mtx_lock(&ex->mtx);
+    f->free_next = ex->groups;
+    ex->groups = f;
+    mtx_unlock(&ex->mtx);
+}
+
+static void ezcb_fanout_put(
+    ezcb_fanout_t* f
+)
+{
+    if (atomic_fetch_sub(&f->refs, 1) == 1) ezcb_fanout_release(f);
+}
+
+/* Run calls of the group until none is left to claim */
+static void ezcb_fanout_work(
+    ezcb_fanout_t* f
+)
+{
+    size_t i;
+#ifdef EZCB_ENABLE_LATENCY
+    ezcb_ctx_t* inst = f->e->shard->inst;
+    ezcb_cb_hook_fn_t hook = inst->cb_hook;
+#endif
+
+    while ((i = atomic_fetch_add(&f->next, 1)) < f->count)
+    {
+#ifdef EZCB_ENABLE_LATENCY
+        uint32_t start = hook ? (uint32_t) EZCB_TICKS() : 0;
+#endif
+        if (f->calls[i].fn(f->calls[i].ctx, f->data) == EZCB_STOP) atomic_store(&f->stop, true);
+#ifdef EZCB_ENABLE_STATS
+        EZCB_STAT_ADD(f->e->stats.invocations, 1);
+#endif
+#ifdef EZCB_ENABLE_LATENCY
+        if (hook)
+        {
+            hook(inst->cb_hook_ctx, f->e->trigger, f->calls[i].fn, f->calls[i].ctx, start,
+                 (uint32_t) EZCB_TICKS() - start);
+        }
+#endif
+
+        if (atomic_fetch_sub(&f->left, 1) == 1 && f->join)
+        {
+            mtx_lock(&f->ex->mtx);
+            cnd_broadcast(&f->ex->joined);
+            mtx_unlock(&f->ex->mtx);
+        }
+    }
+}
+
+/*
+ * Fan records [from, to) of a walk out over the pool, one worker per
+ * call past the first at most. A joined group is also worked on by the
+ * trigger's thread, which then only waits for calls already running, so
+ * it never waits on a helper stuck behind other tasks, and the walk's
+ * epoch covers every call. Without a group to take, the records run here.
+ */
+static ezcb_result_t ezcb_fanout_fire(
+    ezcb_entry_t* e,
+    ezcb_executor_t* ex,
+    const ezcb_cols_t* c,
+    size_t from,
+    size_t to,
+    void* data
+)
+{
+    bool join = !(c->flags[from] & EZCB_CB_DETACHED);
+    ezcb_fanout_t* f = ezcb_fanout_get(ex, to - from);
+    size_t count = 0;
+    bool stopped = false;
+
+    for (size_t i = from; i < to; i++)
+    {
+        if (atomic_load(&c->cells[i]->dead)) continue;
+
+        if (!f)
+        {
+            if (c->calls[i].fn(c->calls[i].ctx, data) == EZCB_STOP) stopped = true;
+#ifdef EZCB_ENABLE_STATS
+            EZCB_STAT_ADD(e->stats.invocations, 1);
+#endif
+            continue;
+        }
+        f->calls[count++] = c->calls[i];
+    }
+
+    if (!f) return join && stopped ? EZCB_STOP : EZCB_CONTINUE;
+
+    f->ex = ex;
+    if (count == 0)
+    {
+        ezcb_fanout_release(f);
+        return EZCB_CONTINUE;
+    }
+
+    size_t helpers = count - (join ? 1 : 0);
+    if (helpers > ex->workers) helpers = ex->workers;
+
+    f->e = e;
+    f->data = data;
+    f->join = join;
+    f->count = count;
+    atomic_init(&f->stop, false);
+    atomic_init(&f->next, 0);
+    atomic_init(&f->left, count);
+    atomic_init(&f->refs, 1 + helpers);
+
+    ezcb_task_t task = { NULL, NULL, NULL, f };
+    size_t posted = 0;
+
+    while (posted < helpers && ezcb_executor_post(ex, &task) == 0)
+    {
+        posted++;
+    }
+    if (posted < helpers) atomic_fetch_sub(&f->refs, helpers - posted);
+
+    ezcb_result_t r = EZCB_CONTINUE;
+
+    if (join || posted == 0)
+    {
+        ezcb_fanout_work(f);
+    }
+
+    if (join)
+    {
+        if (atomic_load(&f->left) != 0)
+        {
+            mtx_lock(&ex->mtx);
+            while (atomic_load(&f->left) != 0)
+            {
+                cnd_wait(&ex->joined, &ex->mtx);
+            }
+            mtx_unlock(&ex->mtx);
+        }
+        if (atomic_load(&f->stop)) r = EZCB_STOP;
+    }
+
+    ezcb_fanout_put(f);
+    return r;
+}
+#endif  /* EZCB_FANOUT */
+
+/*
+ * Call between ezcb_read_lock() and ezcb_read_unlock().
+ *
+ * Lock-free triggers walk the published snapshot; a one-shot callback is
+ * claimed through its shared cell, so it runs at most once even when
+ * several threads fire it concurrently. Otherwise the entry is marked as
+ * being walked, so registering and unregistering from a callback leave
+ * the records in place and ezcb_entry_settle() applies the changes once
+ * the outermost walk is over. Records are still re-read by index, since
+ * growing the array may move it.
+ */
+static void ezcb_entry_fire(
+    ezcb_entry_t* e,
+    void** data,
+    size_t n
+)
+{
+#ifdef EZCB_ENABLE_STATS
+    ezcb_ctx_t* inst = e->shard->inst;
+
+    if (inst->hook_pre) inst->hook_pre(inst->hook_ctx, e->trigger, n);
+
+    size_t fired = n;
+    size_t walked = 0;
+#endif
+#ifdef EZCB_ENABLE_LATENCY
+    uint32_t start = (uint32_t) EZCB_TICKS();
+#endif
+
+    ezcb_result_t r = EZCB_CONTINUE;
+#ifdef EZCB_STATIC_HANDLERS
+    size_t next = 0;
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    ezcb_snap_t* snap = EZCB_LOAD(e->snap);
+    size_t count = 0;
+    ezcb_cols_t c;
+
+    if (snap)
+    {
+        count = snap->count;
+        c = ezcb_cols_at(snap->calls, count, false);
+    }
+#ifdef EZCB_FANOUT
+    ezcb_executor_t* ex = e->shard->inst->executor;
+#endif
+
+    for (size_t i = 0; i < count; i++)
+    {
+#ifdef EZCB_STATIC_HANDLERS
+        r = ezcb_static_fire(e, &next, c.keys[i], data, &n);
+        if (r == EZCB_STOP) break;
+#endif
+
+#ifdef EZCB_ENABLE_STATS
+        walked++;
+#endif
+
+        uint8_t flags = c.flags[i];
+        ezcb_cell_t* cell = c.cells[i];
+
+#ifdef EZCB_FANOUT
+        /* A single payload fans the rest of this priority's parallel run out */
+        if ((flags & EZCB_CB_PARALLEL) && n == 1 && ex)
+        {
+            size_t end = i + 1;
+            uint8_t kind = flags & (EZCB_CB_PARALLEL | EZCB_CB_DETACHED);
+
+            while (end < count && c.keys[end] == c.keys[i] &&
+                   (c.flags[end] & (EZCB_CB_PARALLEL | EZCB_CB_DETACHED)) == kind)
+            {
+                end++;
+            }
+
+            r = ezcb_fanout_fire(e, ex, &c, i, end, data[0]);
+#ifdef EZCB_ENABLE_STATS
+            walked += end - i - 1;
+#endif
+            i = end - 1;
+            if (r == EZCB_STOP) break;
+            continue;
+        }
+#endif
+
+        bool dead = (flags & EZCB_CB_ONCE) ? atomic_exchange(&cell->dead, true)
+                                           : atomic_load(&cell->dead);
+        if (dead) continue;
+
+        r = ezcb_cb_invoke(e, &c.calls[i], flags, data, &n);
+
+        if (flags & EZCB_CB_ONCE) ezcb_entry_reap(e, cell);
+
+        if (r == EZCB_STOP) break;
+    }
+#else
+    e->firing++;
+
+    for (size_t i = 0; i < e->live; i++)
+    {
+#ifdef EZCB_STATIC_HANDLERS
+        r = ezcb_static_fire(e, &next, ezcb_cols(e).keys[i], data, &n);
+        if (r == EZCB_STOP) break;
+#endif
+
+#ifdef EZCB_ENABLE_STATS
+        walked++;
+#endif
+
+        /* Looked up again each time: a callback that registers may move the records */
+        ezcb_cols_t c = ezcb_cols(e);
+        uint8_t flags = c.flags[i];
+        if (flags & EZCB_CB_DEAD) continue;
+
+        ezcb_call_t call = c.calls[i];
+
+        /* Claimed before it runs, so a nested trigger skips it */
+        if (flags & EZCB_CB_ONCE)
+        {
+            c.flags[i] = flags | EZCB_CB_DEAD;
+            e->dirty = true;
+        }
+
+        r = ezcb_cb_invoke(e, &call, flags, data, &n);
+        if (r == EZCB_STOP) break;
+    }
+#endif
+
+#ifdef EZCB_STATIC_HANDLERS
+    if (r == EZCB_CONTINUE) (void) ezcb_static_fire(e, &next, -1, data, &n);
+#endif
+
+#ifdef EZCB_ENABLE_STATS
+#ifdef EZCB_STATIC_HANDLERS
+    walked += next;
+#endif
+    EZCB_STAT_ADD(e->stats.fires, (uint32_t) fired);
+    EZCB_STAT_ADD(e->stats.chain_total, (uint32_t) walked);
+    ezcb_stat_max(&e->stats.chain_max, (uint32_t) walked);
+#ifdef EZCB_ENABLE_LATENCY
+    ezcb_latency_sample(e, (uint32_t) EZCB_TICKS() - start);
+#endif
+
+    if (inst->hook_post) inst->hook_post(inst->hook_ctx, e->trigger, fired);
+#endif
+
+#ifndef EZCB_LOCK_FREE_TRIGGER
+    /* The walk ends last, so the entry outlasts whatever ran above even if they emptied it */
+    if (--e->firing == 0 && e->dirty)
+    {
+        ezcb_entry_settle(e);
+        ezcb_entry_release(e);
+    }
+#endif
+}
+
+#ifdef EZCB_ENABLE_PATTERNS
+/*
+ * Trigger-side fallback for a name without an entry: run the matching
+ * pattern callbacks directly instead of creating an entry, so names that
+ * are only ever triggered cost no memory. They are gathered under the
+ * shard mutex and run after it is released, each per payload like a plain
+ * record would. Call between ezcb_read_lock() and ezcb_read_unlock().
+ */
+static void ezcb_pattern_fire(
+    ezcb_shard_t* s,
+    const char* trigger,
+    void** data,
+    size_t n
+)
+{
+    ezcb_ctx_t* inst = s->inst;
+
+    if (!EZCB_LOAD(inst->npatterns)) return;
+
+    ezcb_pmatch_t local[EZCB_PATTERN_LOCAL];
+    ezcb_pmatch_t* m;
+
+    /* Read first: a change between here and the gather only costs a recheck */
+    unsigned gen = EZCB_LOAD(inst->pattern_gen);
+    size_t count = ezcb_pattern_gather(s, trigger, local, &m);
+    if (count == (size_t) -1 || count == 0) return;
+
+#ifdef EZCB_ENABLE_STATS
+    if (inst->hook_pre) inst->hook_pre(inst->hook_ctx, trigger, n);
+
+    size_t fired = n;
+#endif
+
+    for (size_t i = 0; n; i++)
+    {
+        /* A callback unregistered pattern callbacks, which may include the rest */
+        if (EZCB_LOAD(inst->pattern_gen) != gen)
+        {
+            gen = EZCB_LOAD(inst->pattern_gen);
+            count = i + ezcb_pattern_recheck(s, trigger, m + i, count - i);
+        }
+        if (i == count) break;
+
+#ifdef EZCB_ENABLE_LATENCY
+        ezcb_cb_hook_fn_t hook = inst->cb_hook;
+        uint32_t start = hook ? (uint32_t) EZCB_TICKS() : 0;
+#endif
+
+        /* Payloads it stops are dropped for the callbacks after it */
+        size_t kept = 0;
+        for (size_t k = 0; k < n; k++)
+        {
+            if (m[i].fn(m[i].ctx, data[k]) == EZCB_CONTINUE) data[kept++] = data[k];
+        }
+        n = kept;
+
+#ifdef EZCB_ENABLE_LATENCY
+        if (hook)
+        {
+            hook(inst->cb_hook_ctx, trigger, m[i].fn, m[i].ctx, start, (uint32_t) EZCB_TICKS() - start);
+        }
+#endif
+    }
+
+#ifdef EZCB_ENABLE_STATS
+    if (inst->hook_post) inst->hook_post(inst->hook_ctx, trigger, fired);
+#endif
+
+    if (m != local) EZCB_FREE(m);
+}
+#endif  /* EZCB_ENABLE_PATTERNS */
+
+static void ezcb_trigger_at(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    size_t len,
+    uint32_t hash,
+    void* data
+)
+{
+    ezcb_shard_t* s = ezcb_shard_of(inst, hash);
+
+    unsigned token = ezcb_read_lock(s);
+
+    ezcb_entry_t* e = ezcb_entry_lookup(s, trigger, len, hash);
+    if (e) ezcb_entry_fire(e, &data, 1);
+#ifdef EZCB_ENABLE_PATTERNS
+    else ezcb_pattern_fire(s, trigger, &data, 1);
+#endif
+
+    ezcb_read_unlock(s, token);
+}
+
+void ezcb_trigger_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+
+    if (!ezcb_ctx_ready(inst)) return;
+
+    size_t len;
+    uint32_t hash = ezcb_hash_len(trigger, &len);
+    ezcb_trigger_at(inst, trigger, len, hash, data);
+}
+
+void ezcb_trigger_hashed_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    size_t length,
+    uint32_t hash,
+    void* data
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+#ifndef NDEBUG
+    size_t measured;
+    assert(ezcb_hash_len(trigger, &measured) == hash && measured == length);
+#endif
+
+    if (!ezcb_ctx_ready(inst)) return;
+
+    ezcb_trigger_at(inst, trigger, length, hash, data);
+}
+
+void ezcb_trigger_h(
+    ezcb_handle_t handle,
+    void* data
+)
+{
+    assert(handle != NULL);
+
+    ezcb_shard_t* s = handle->shard;
+
+    unsigned token = ezcb_read_lock(s);
+    ezcb_entry_fire(handle, &data, 1);
+    ezcb_read_unlock(s, token);
+}
+
+#ifdef EZCB_ENABLE_COALESCING
+void ezcb_coalesce(
+    ezcb_handle_t handle,
+    uint32_t min_ticks
+)
+{
+    assert(handle != NULL);
+
+#ifdef EZCB_ENABLE_ISR
+    handle->coalesce.interval = min_ticks;
+#else
+    (void) min_ticks;
+#endif
+    handle->coalesce.on = true;
+}
+#endif  /* EZCB_ENABLE_COALESCING */
+
+/****************************************************************
+ * Synchronize
+ ****************************************************************/
+
+void ezcb_synchronize_ex(
+    ezcb_ctx_t* inst
+)
+{
+    assert(inst != NULL);
+
+    if (!inst->ready) return;
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    assert(ezcb_read_depth == 0);
+
+    /* Two epoch steps drain every reader that was already running */
+    unsigned start = atomic_load(&inst->epoch);
+
+    while (atomic_load(&inst->epoch) - start < 2)
+    {
+        if (!ezcb_rcu_try_advance(inst)) thrd_yield();
+    }
+
+    ezcb_lock(&inst->shards[0]);
+    ezcb_rcu_reclaim(inst);
+    ezcb_unlock(&inst->shards[0]);
+#else
+    /* Triggers hold their shard lock for their whole walk */
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_lock(&inst->shards[i]);
+        ezcb_unlock(&inst->shards[i]);
+    }
+#endif
+}
+
+/****************************************************************
+ * Compaction
+ ****************************************************************/
+
+int ezcb_reserve_ex(
+    ezcb_ctx_t* inst,
+    size_t triggers
+)
+{
+    assert(inst != NULL);
+
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+
+#ifdef EZCB_NO_MALLOC
+    return triggers <= EZCB_MAX_TRIGGERS ? 0 : -1;
+#else
+    /* A shard that gets more than its share still grows on its own */
+    size_t share = triggers / EZCB_SHARDS + (triggers % EZCB_SHARDS != 0);
+    if (share > SIZE_MAX / 8) return -1;
+
+    int r = 0;
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        size_t size = ezcb_table_need(share);
+
+        ezcb_lock(s);
+        if (size > s->floor) s->floor = size;
+        if (size > EZCB_LOAD(s->buckets) && ezcb_resize(s, size) != 0) r = -1;
+#ifdef EZCB_REHASH
+        /* Asked for up front, so the registrations that follow do not pay for the move */
+        ezcb_rehash_step(s, SIZE_MAX);
+#endif
+        ezcb_unlock(s);
+    }
+    return r;
+#endif
+}
+
+void ezcb_compact_ex(
+    ezcb_ctx_t* inst
+)
+{
+    assert(inst != NULL);
+
+    if (!inst->ready) return;
+
+#ifndef EZCB_NO_MALLOC
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        ezcb_lock(s);
+
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+#ifndef EZCB_LOCK_FREE_TRIGGER
+            /* A walk in progress holds on to the array */
+            if (e->firing) continue;
+#endif
+            ezcb_cbs_shrink(e, e->count);
+        }
+
+        /* On failure the larger table is kept */
+        size_t size = ezcb_table_need(s->count);
+        size_t buckets = EZCB_LOAD(s->buckets);
+        s->floor = 0;
+#ifdef EZCB_OPEN_ADDRESSING
+        /* Rebuilt at its size, too, to drop the tombstones of freed entries */
+        if (size < buckets || (s->tombs && size <= buckets)) (void) ezcb_resize(s, size);
+#else
+        if (size < buckets) (void) ezcb_resize(s, size);
+#endif
+#ifdef EZCB_REHASH
+        ezcb_rehash_step(s, SIZE_MAX);
+#endif
+
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+        ezcb_index_trim(s);
+#endif
+
+#ifdef EZCB_LOCK_FREE_TRIGGER
+        /* Reclaimed objects, freed entries included, return to their pools first */
+        ezcb_rcu_reclaim(inst);
+        ezcb_pool_trim(&inst->cells);
+        ezcb_pool_trim(&inst->snaps);
+#endif
+        ezcb_pool_trim(&s->entries);
+        ezcb_unlock(s);
+    }
+#endif  /* EZCB_NO_MALLOC */
+}
+
+/****************************************************************
+ * Snapshot
+ ****************************************************************/
+
+#define EZCB_BLOB_MAGIC             0x42435a45u     /* "EZCB", little-endian */
+#define EZCB_BLOB_VERSION           1u
+#define EZCB_BLOB_CHECK             "ezcb.snapshot" /* Its hash tells this build's hash function apart */
+#define EZCB_BLOB_FLAGS             (EZCB_CB_ONCE | EZCB_CB_BATCH | EZCB_CB_PARALLEL | EZCB_CB_DETACHED)
+
+/*
+ * A blob is this header, a trigger table, the records of each trigger in
+ * table order, then the NUL-terminated names. Offsets count from the
+ * blob's start, and every field goes through memcpy, so the blob may sit
+ * at any address.
+ */
+typedef struct ezcb_blob_hdr
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              /* Whole blob */
+    uint32_t check;             /* ezcb_hash(EZCB_BLOB_CHECK) */
+    uint32_t triggers;
+    uint32_t records;
+} ezcb_blob_hdr_t;
+
+typedef struct ezcb_blob_trigger
+{
+    uint32_t hash;
+    uint32_t name;              /* Offset of the name */
+    uint32_t len;
+    uint32_t count;             /* Records it owns */
+} ezcb_blob_trigger_t;
+
+typedef struct ezcb_blob_cb
+{
+    uint32_t symbol;            /* Index into the symbol table */
+    uint8_t priority;
+    uint8_t flags;              /* EZCB_BLOB_FLAGS bits */
+    uint16_t reserved;
+} ezcb_blob_cb_t;
+
+/* Whether a record belongs in a blob: registered directly and not removed */
+static bool ezcb_blob_keeps(
+    const ezcb_cb_t* cb
+)
+{
+    if (cb->flags & EZCB_CB_DEAD) return false;
+#ifdef EZCB_LOCK_FREE_TRIGGER
+    if (atomic_load(&cb->cell->dead)) return false;
+#endif
+#ifdef EZCB_ENABLE_PATTERNS
+    if (cb->sub) return false;
+#endif
+    return true;
+}
+
+/* Index of the record's fn/ctx pair in symbols, or nsymbols if it is missing */
+static size_t ezcb_blob_symbol(
+    const ezcb_cb_t* cb,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    size_t sym = 0;
+    while (sym < nsymbols && (symbols[sym].fn != cb->fn || symbols[sym].ctx != cb->ctx)) sym++;
+    return sym;
+}
+
+/* Records of e that belong in a blob, or SIZE_MAX if one of them is missing from symbols */
+static size_t ezcb_blob_kept(
+    const ezcb_entry_t* e,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    ezcb_cols_t c = ezcb_cols(e);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < e->count; i++)
+    {
+        ezcb_cb_t cb = ezcb_cb_get(&c, i);
+        if (!ezcb_blob_keeps(&cb)) continue;
+
+        if (ezcb_blob_symbol(&cb, symbols, nsymbols) == nsymbols) return SIZE_MAX;
+        kept++;
+    }
+    return kept;
+}
+
+/* Fill a blob sized from the same entries by the caller, which resolved every symbol; every shard is locked */
+static void ezcb_blob_write(
+    ezcb_ctx_t* inst,
+    uint8_t* out,
+    const ezcb_blob_hdr_t* hdr,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    size_t at_t = sizeof(*hdr);
+    size_t at_c = at_t + hdr->triggers * sizeof(ezcb_blob_trigger_t);
+    size_t at_n = at_c + hdr->records * sizeof(ezcb_blob_cb_t);
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            size_t kept = ezcb_blob_kept(e, symbols, nsymbols);
+            if (kept == 0) continue;
+
+            ezcb_blob_trigger_t t = { e->hash, (uint32_t) at_n, e->len, (uint32_t) kept };
+            memcpy(out + at_t, &t, sizeof(t));
+            memcpy(out + at_n, e->trigger, e->len + 1);
+            at_t += sizeof(t);
+            at_n += e->len + 1;
+
+            ezcb_cols_t c = ezcb_cols(e);
+
+            for (size_t k = 0; k < e->count; k++)
+            {
+                ezcb_cb_t cb = ezcb_cb_get(&c, k);
+                if (!ezcb_blob_keeps(&cb)) continue;
+
+                size_t sym = ezcb_blob_symbol(&cb, symbols, nsymbols);
+
+                ezcb_blob_cb_t b = { (uint32_t) sym, cb.priority, (uint8_t)(cb.flags & EZCB_BLOB_FLAGS), 0 };
+                memcpy(out + at_c, &b, sizeof(b));
+                at_c += sizeof(b);
+            }
+        }
+    }
+
+    memcpy(out, hdr, sizeof(*hdr));
+}
+
+size_t ezcb_snapshot_ex(
+    ezcb_ctx_t* inst,
+    void* buf,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    assert(inst != NULL);
+    assert(buf != NULL || size == 0);
+    assert(symbols != NULL || nsymbols == 0);
+
+    size_t triggers = 0;
+    size_t records = 0;
+    size_t names = 0;
+    bool missing = false;
+
+    if (!ezcb_may_lock_all()) return 0;
+    if (inst->ready) ezcb_lock_all(inst);
+
+    /* Sized and resolved first, so that a blob that does not fit, or cannot be written, writes nothing */
+    for (size_t i = 0; inst->ready && !missing && i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+        ezcb_iter_t it = { 0, NULL };
+
+        for (ezcb_entry_t* e; !missing && (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            size_t kept = ezcb_blob_kept(e, symbols, nsymbols);
+            if (kept == 0) continue;
+
+            missing = kept == SIZE_MAX;
+            triggers++;
+            records += kept;
+            names += e->len + 1;
+        }
+    }
+
+    size_t total = sizeof(ezcb_blob_hdr_t) + triggers * sizeof(ezcb_blob_trigger_t) +
+                   records * sizeof(ezcb_blob_cb_t) + names;
+    if (missing || total > UINT32_MAX) total = 0;
+
+    if (total != 0 && total <= size)
+    {
+        ezcb_blob_hdr_t hdr = { EZCB_BLOB_MAGIC, EZCB_BLOB_VERSION, (uint32_t) total,
+                                ezcb_hash(EZCB_BLOB_CHECK), (uint32_t) triggers, (uint32_t) records };
+
+        ezcb_blob_write(inst, (uint8_t*) buf, &hdr, symbols, nsymbols);
+    }
+
+    if (inst->ready) ezcb_unlock_all(inst);
+    return total;
+}
+
+/* Validate the whole blob up front, so that restoring it cannot fail halfway */
+static bool ezcb_blob_check(
+    const uint8_t* in,
+    size_t size,
+    size_t nsymbols,
+    ezcb_blob_hdr_t* hdr
+)
+{
+    if (size < sizeof(*hdr)) return false;
+    memcpy(hdr, in, sizeof(*hdr));
+
+    if (hdr->magic != EZCB_BLOB_MAGIC || hdr->version != EZCB_BLOB_VERSION) return false;
+    if (hdr->check != ezcb_hash(EZCB_BLOB_CHECK)) return false;
+    if (hdr->size > size || hdr->size < sizeof(*hdr)) return false;
+
+    size_t avail = hdr->size - sizeof(*hdr);
+    if (hdr->triggers > avail / sizeof(ezcb_blob_trigger_t)) return false;
+    avail -= hdr->triggers * sizeof(ezcb_blob_trigger_t);
+    if (hdr->records > avail / sizeof(ezcb_blob_cb_t)) return false;
+
+    size_t at_c = sizeof(*hdr) + hdr->triggers * sizeof(ezcb_blob_trigger_t);
+    size_t at_n = at_c + hdr->records * sizeof(ezcb_blob_cb_t);
+    size_t owned = 0;
+
+    for (size_t i = 0; i < hdr->triggers; i++)
+    {
+        ezcb_blob_trigger_t t;
+        memcpy(&t, in + sizeof(*hdr) + i * sizeof(t), sizeof(t));
+
+        if (t.name < at_n || t.name >= hdr->size || t.len >= hdr->size - t.name) return false;
+        if (in[t.name + t.len] != '\0') return false;
+
+        /* A name that does not match its length or hash would restore an entry no lookup finds */
+        size_t len;
+        if (ezcb_hash_len((const char*)(in + t.name), &len) != t.hash || len != t.len) return false;
+        if (t.count > hdr->records - owned) return false;
+        owned += t.count;
+    }
+    if (owned != hdr->records) return false;
+
+    for (size_t i = 0; i < hdr->records; i++)
+    {
+        ezcb_blob_cb_t b;
+        memcpy(&b, in + at_c + i * sizeof(b), sizeof(b));
+
+        if (b.symbol >= nsymbols) return false;
+    }
+    return true;
+}
+
+int ezcb_restore_ex(
+    ezcb_ctx_t* inst,
+    const void* blob,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    assert(inst != NULL);
+    assert(blob != NULL || size == 0);
+    assert(symbols != NULL || nsymbols == 0);
+
+    const uint8_t* in = (const uint8_t*) blob;
+    ezcb_blob_hdr_t hdr;
+
+    if (!ezcb_blob_check(in, size, nsymbols, &hdr)) return -1;
+    if (hdr.records == 0) return 0;
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+
+    const uint8_t* trigs = in + sizeof(hdr);
+    const uint8_t* recs = trigs + hdr.triggers * sizeof(ezcb_blob_trigger_t);
+
+#ifdef EZCB_NO_MALLOC
+    ezcb_shard_t* s = &inst->shards[0];
+
+    ezcb_lock(s);
+
+    /* Check the static pools first, as ezcb_register_many() does */
+    int r = inst->cbs_used + hdr.records <= EZCB_MAX_NODES ? 0 : -1;
+    size_t adds = 0;
+
+    for (size_t i = 0; r == 0 && i < hdr.triggers; i++)
+    {
+        ezcb_blob_trigger_t t;
+        memcpy(&t, trigs + i * sizeof(t), sizeof(t));
+
+        if (t.len >= EZCB_MAX_TRIGGER_LENGTH) r = -1;
+        else if (t.count && !ezcb_entry_find(s, (const char*)(in + t.name), t.len, t.hash)) adds++;
+    }
+    if (adds > ezcb_entries_left(inst)) r = -1;
+
+    for (size_t i = 0; r == 0 && i < hdr.triggers; i++)
+    {
+        ezcb_blob_trigger_t t;
+        memcpy(&t, trigs + i * sizeof(t), sizeof(t));
+        if (t.count == 0) continue;
+
+        ezcb_entry_t* e = ezcb_entry_intern(s, (const char*)(in + t.name), t.len, t.hash);
+
+        for (size_t k = 0; k < t.count && r == 0; k++)
+        {
+            ezcb_blob_cb_t b;
+            memcpy(&b, recs, sizeof(b));
+            recs += sizeof(b);
+
+            const ezcb_symbol_t* sym = &symbols[b.symbol];
+            r = e ? ezcb_entry_insert(e, b.priority, sym->fn, sym->ctx, b.flags & EZCB_BLOB_FLAGS, NULL) : -1;
+        }
+    }
+
+    ezcb_unlock(s);
+    return r;
+#else
+    ezcb_bulk_t* bulk = (ezcb_bulk_t*) ezcb_zalloc(hdr.records * (sizeof(ezcb_bulk_t) + sizeof(ezcb_reg_t)));
+    if (!bulk) return -1;
+
+    ezcb_reg_t* regs = (ezcb_reg_t*)(bulk + hdr.records);
+    size_t n = 0;
+
+    /* Already hashed and in priority order, so the bulk path neither hashes nor moves them */
+    for (size_t i = 0; i < hdr.triggers; i++)
+    {
+        ezcb_blob_trigger_t t;
+        memcpy(&t, trigs + i * sizeof(t), sizeof(t));
+
+        for (size_t k = 0; k < t.count; k++, n++)
+        {
+            ezcb_blob_cb_t b;
+            memcpy(&b, recs + n * sizeof(b), sizeof(b));
+
+            regs[n].trigger = (const char*)(in + t.name);
+            regs[n].fn = symbols[b.symbol].fn;
+            regs[n].ctx = symbols[b.symbol].ctx;
+            regs[n].priority = b.priority;
+
+            bulk[n].reg = &regs[n];
+            bulk[n].hash = t.hash;
+            bulk[n].len = t.len;
+            bulk[n].flags = (uint8_t)(b.flags & EZCB_BLOB_FLAGS);
+        }
+    }
+
+    int r = ezcb_bulk_register(inst, bulk, n);
+
+    EZCB_FREE(bulk);
+    return r;
+#endif
+}
+
+/****************************************************************
+ * ISR support
+ ****************************************************************/
+#ifdef EZCB_ENABLE_ISR
+
+/*
+ * Memory ordering: a producer claims a position with a relaxed CAS on
+ * head, writes the payload, then publishes it with a release store of
+ * lap + 1 into the slot; the dispatcher's acquire load of that value makes
+ * the payload visible. The dispatcher hands the slot back with a release
+ * store of the next lap base, which the next producer's acquire load pairs
+ * with, so a slot is never written while it is still being read.
+ */
+static int ezcb_evt_push(
+    ezcb_ctx_t* inst,
+    uint8_t priority,
+    const char* trigger,
+    ezcb_entry_t* handle,
+    void* data
+)
+{
+    ezcb_evt_ring_t* ring = &inst->evt_rings[priority < EZCB_EVENT_PRIORITIES ? priority : EZCB_EVENT_PRIORITIES - 1];
+    ezcb_evt_idx_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    for (;;)
+    {
+        ezcb_evt_t* slot = &ring->slots[pos & EZCB_EVT_MASK];
+        ezcb_evt_idx_t lap = (ezcb_evt_idx_t)(pos & ~EZCB_EVT_MASK);
+        ezcb_evt_idx_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ezcb_evt_idx_t diff = (ezcb_evt_idx_t)(seq - lap);
+
+        if (diff == 0)
+        {
+            /* Slot is free for this lap; on success it is ours alone */
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, (ezcb_evt_idx_t)(pos + 1),
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                slot->trigger = trigger;
+                slot->handle = handle;
+                slot->data = data;
+#ifdef EZCB_ENABLE_LATENCY
+                slot->stamp = (uint32_t) EZCB_TICKS();
+#endif
+                atomic_store_explicit(&slot->seq, (ezcb_evt_idx_t)(lap + 1), memory_order_release);
+                return 0;
+            }
+        }
+        else if (diff >= EZCB_EVT_HALF)
+        {
+            /* Still holds the previous lap's event: the queue is full */
+#ifdef EZCB_ENABLE_STATS
+            atomic_fetch_add_explicit(&inst->evt_drops, 1, memory_order_relaxed);
+#endif
+            return -1;
+        }
+        else
+        {
+            /* Another producer claimed this position first */
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+}
+
+int ezcb_trigger_isr_prio_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data,
+    uint8_t priority
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+
+    return ezcb_evt_push(inst, priority, trigger, NULL, data);
+}
+
+int ezcb_trigger_isr_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+)
+{
+    return ezcb_trigger_isr_prio_ex(inst, trigger, data, 0);
+}
+
+int ezcb_trigger_isr_h(
+    ezcb_handle_t handle,
+    void* data
+)
+{
+    assert(handle != NULL);
+
+    ezcb_ctx_t* inst = handle->shard->inst;
+
+#ifdef EZCB_ENABLE_COALESCING
+    ezcb_coalesce_t* c = &handle->coalesce;
+
+    if (c->on)
+    {
+        atomic_store_explicit(&c->isr_data, data, memory_order_relaxed);
+        if (atomic_exchange_explicit(&c->isr_pending, true, memory_order_acq_rel)) return 0;
+
+        if (ezcb_evt_push(inst, 0, NULL, handle, NULL) != 0)
+        {
+            atomic_store_explicit(&c->isr_pending, false, memory_order_release);
+            return -1;
+        }
+        return 0;
+    }
+#endif
+
+    return ezcb_evt_push(inst, 0, NULL, handle, data);
+}
+
+#ifdef EZCB_ENABLE_LATENCY
+/* Count how long an event queued at stamp waited for the dispatcher */
+static void ezcb_evt_waited(
+    ezcb_ctx_t* inst,
+    uint32_t stamp
+)
+{
+    uint32_t ticks = (uint32_t) EZCB_TICKS() - stamp;
+
+    atomic_fetch_add_explicit(&inst->evt_wait[ezcb_latency_bucket(ticks)], 1, memory_order_relaxed);
+    if (ticks > atomic_load_explicit(&inst->evt_wait_max, memory_order_relaxed))
+    {
+        atomic_store_explicit(&inst->evt_wait_max, ticks, memory_order_relaxed);
+    }
+}
+#endif  /* EZCB_ENABLE_LATENCY */
+
+/* Take one published event off the ring; returns false when none is ready */
+static bool ezcb_evt_ring_pop(
+    ezcb_ctx_t* inst,
+    ezcb_evt_ring_t* ring,
+    const char** trigger,
+    ezcb_entry_t** handle,
+    void** data
+)
+{
+    ezcb_evt_t* slot = &ring->slots[ring->tail & EZCB_EVT_MASK];
+    ezcb_evt_idx_t lap = (ezcb_evt_idx_t)(ring->tail & ~EZCB_EVT_MASK);
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != (ezcb_evt_idx_t)(lap + 1)) return false;
+
+#ifdef EZCB_ENABLE_STATS
+    /* Claimed positions, including ones still being written */
+    ezcb_evt_idx_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t pending = (uint32_t)(ezcb_evt_idx_t)(head - ring->tail);
+    if (pending > atomic_load_explicit(&inst->evt_high_water, memory_order_relaxed))
+    {
+        atomic_store_explicit(&inst->evt_high_water, pending, memory_order_relaxed);
+    }
+#else
+    (void) inst;
+#endif
+
+    *trigger = slot->trigger;
+    *handle = slot->handle;
+    *data = slot->data;
+#ifdef EZCB_ENABLE_LATENCY
+    ezcb_evt_waited(inst, slot->stamp);
+#endif
+
+    atomic_store_explicit(&slot->seq, (ezcb_evt_idx_t)(lap + EZCB_EVENT_QUEUE_SIZE), memory_order_release);
+    ring->tail++;
+    return true;
+}
+
+#ifdef EZCB_ENABLE_COALESCING
+/* Whether a coalescing entry may run now; if not, it waits with its event still pending */
+static bool ezcb_coalesce_due(
+    ezcb_ctx_t* inst,
+    ezcb_entry_t* e,
+    uint32_t now
+)
+{
+    ezcb_coalesce_t* c = &e->coalesce;
+
+    if (c->interval && c->ran && (uint32_t)(now - c->last) < c->interval)
+    {
+        c->waiting = inst->coalesce_waiting;
+        inst->coalesce_waiting = e;
+        return false;
+    }
+
+    c->last = now;
+    c->ran = true;
+    return true;
+}
+
+/* Take a coalescing entry's event: clear pending first, so later data queues anew */
+static void* ezcb_coalesce_take(
+    ezcb_entry_t* e
+)
+{
+    atomic_exchange_explicit(&e->coalesce.isr_pending, false, memory_order_acq_rel);
+    return atomic_load_explicit(&e->coalesce.isr_data, memory_order_relaxed);
+}
+
+/* Detach the first waiting entry whose interval has passed */
+static ezcb_entry_t* ezcb_coalesce_expired(
+    ezcb_ctx_t* inst,
+    uint32_t now
+)
+{
+    for (ezcb_entry_t** link = &inst->coalesce_waiting; *link; link = &(*link)->coalesce.waiting)
+    {
+        ezcb_entry_t* e = *link;
+
+        if ((uint32_t)(now - e->coalesce.last) >= e->coalesce.interval)
+        {
+            *link = e->coalesce.waiting;
+            e->coalesce.waiting = NULL;
+            e->coalesce.last = now;
+            return e;
+        }
+    }
+    return NULL;
+}
+#endif  /* EZCB_ENABLE_COALESCING */
+
+/*
+ * Take the next event of the highest priority that has one. An event
+ * queued by handle has a NULL trigger; a coalescing one gets its latest
+ * data here, or is held back while its interval runs.
+ */
+static bool ezcb_evt_pop(
+    ezcb_ctx_t* inst,
+    const char** trigger,
+    ezcb_entry_t** handle,
+    void** data
+)
+{
+#ifdef EZCB_ENABLE_COALESCING
+    if (inst->coalesce_waiting)
+    {
+        ezcb_entry_t* e = ezcb_coalesce_expired(inst, (uint32_t) EZCB_TICKS());
+
+        if (e)
+        {
+            *trigger = NULL;
+            *handle = e;
+            *data = ezcb_coalesce_take(e);
+            return true;
+        }
+    }
+#endif
+
+    for (size_t p = EZCB_EVENT_PRIORITIES; p-- > 0;)
+    {
+        while (ezcb_evt_ring_pop(inst, &inst->evt_rings[p], trigger, handle, data))
+        {
+#ifdef EZCB_ENABLE_COALESCING
+            ezcb_entry_t* e = *handle;
+
+            if (e && e->coalesce.on)
+            {
+                if (e->coalesce.interval && !ezcb_coalesce_due(inst, e, (uint32_t) EZCB_TICKS())) continue;
+                *data = ezcb_coalesce_take(e);
+            }
+#endif
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Run a popped event */
+static void ezcb_evt_run(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    ezcb_entry_t* handle,
+    void* data
+)
+{
+    if (trigger)
+    {
+        ezcb_trigger_ex(inst, trigger, data);
+    }
+    else
+    {
+        ezcb_trigger_h(handle, data);
+    }
+}
+
+/* Units a record with len payload bytes takes, header included */
+static inline size_t ezcb_rec_units(
+    size_t len
+)
+{
+    return 1 + (len + sizeof(ezcb_rec_t) - 1) / sizeof(ezcb_rec_t);
+}
+
+/*
+ * Memory ordering: a producer loads rec_tail with acquire before claiming
+ * units with a relaxed CAS on rec_head; this pairs with the dispatcher's
+ * release store of rec_tail once it is done with them, so they are never
+ * written while still being read, and their ready flags are seen cleared.
+ * Each record is then published with a release store of the ready flag of
+ * its first unit.
+ */
+int ezcb_trigger_isr_copy(
+    ezcb_handle_t handle,
+    const void* buf,
+    size_t len
+)
+{
+    assert(handle != NULL);
+    assert(buf != NULL || len == 0);
+
+    ezcb_ctx_t* inst = handle->shard->inst;
+    size_t units = ezcb_rec_units(len);
+
+    ezcb_evt_idx_t pos = atomic_load_explicit(&inst->rec_head, memory_order_relaxed);
+
+    while (len < EZCB_PAYLOAD_RING_SIZE)
+    {
+        ezcb_evt_idx_t tail = atomic_load_explicit(&inst->rec_tail, memory_order_acquire);
+        size_t used = (ezcb_evt_idx_t)(pos - tail);
+
+        if (used > EZCB_REC_UNITS)
+        {
+            /* The dispatcher has moved past the head we read */
+            pos = atomic_load_explicit(&inst->rec_head, memory_order_relaxed);
+            continue;
+        }
+
+        /* A record that would cross the end first fills it, then starts over at the front */
+        size_t at = pos & EZCB_REC_MASK;
+        size_t skip = at + units > EZCB_REC_UNITS ? EZCB_REC_UNITS - at : 0;
+        size_t claim = skip ? skip : units;
+
+        if (used + claim > EZCB_REC_UNITS) break;
+
+        if (atomic_compare_exchange_weak_explicit(&inst->rec_head, &pos, (ezcb_evt_idx_t)(pos + claim),
+                                                  memory_order_relaxed, memory_order_relaxed))
+        {
+            if (skip)
+            {
+                inst->rec_ring[at].hdr.handle = NULL;
+                atomic_store_explicit(&inst->rec_ready[at], true, memory_order_release);
+                pos = (ezcb_evt_idx_t)(pos + skip);
+                continue;
+            }
+
+            inst->rec_ring[at].hdr.handle = handle;
+            inst->rec_ring[at].hdr.len = (uint32_t) len;
+#ifdef EZCB_ENABLE_LATENCY
+            inst->rec_ring[at].hdr.stamp = (uint32_t) EZCB_TICKS();
+#endif
+            if (len) memcpy(&inst->rec_ring[at + 1], buf, len);
+            atomic_store_explicit(&inst->rec_ready[at], true, memory_order_release);
+            return 0;
+        }
+    }
+
+#ifdef EZCB_ENABLE_STATS
+    atomic_fetch_add_explicit(&inst->evt_drops, 1, memory_order_relaxed);
+#endif
+    return -1;
+}
+
+/*
+ * Take the record at rec_next off the ring. Its ready flag is cleared
+ * right away: a full ring brings rec_next back to the first unit not yet
+ * handed back, whose record must not be seen again.
+ */
+static void ezcb_rec_take(
+    ezcb_ctx_t* inst
+)
+{
+    size_t at = inst->rec_next & EZCB_REC_MASK;
+    const ezcb_rec_t* rec = &inst->rec_ring[at];
+
+    atomic_store_explicit(&inst->rec_ready[at], false, memory_order_relaxed);
+#ifdef EZCB_ENABLE_LATENCY
+    if (rec->hdr.handle) ezcb_evt_waited(inst, rec->hdr.stamp);
+#endif
+    inst->rec_next += (ezcb_evt_idx_t)(rec->hdr.handle ? ezcb_rec_units(rec->hdr.len) : EZCB_REC_UNITS - at);
+}
+
+/* Find the next published record, taking fillers; returns false when none is ready */
+static bool ezcb_rec_peek(
+    ezcb_ctx_t* inst,
+    ezcb_rec_t** rec
+)
+{
+    for (;;)
+    {
+        size_t at = inst->rec_next & EZCB_REC_MASK;
+
+        if (!atomic_load_explicit(&inst->rec_ready[at], memory_order_acquire)) return false;
+
+        if (inst->rec_ring[at].hdr.handle)
+        {
+            *rec = &inst->rec_ring[at];
+            return true;
+        }
+
+        ezcb_rec_take(inst);
+    }
+}
+
+/*
+ * Hand the units of every record taken back to the producers. A record's
+ * payload is in use until its callbacks return, so this waits for the
+ * outermost dispatch when callbacks dispatch themselves.
+ */
+static void ezcb_rec_release(
+    ezcb_ctx_t* inst
+)
+{
+    if (inst->rec_depth > 0) return;
+
+    atomic_store_explicit(&inst->rec_tail, inst->rec_next, memory_order_release);
+}
+
+/*
+ * Dispatch up to max records from the payload ring. With group, a run of
+ * records on the same handle fires once through the batch scratch space,
+ * which the caller must own.
+ */
+static size_t ezcb_rec_dispatch(
+    ezcb_ctx_t* inst,
+    size_t max,
+    bool group
+)
+{
+    size_t n = 0;
+    ezcb_rec_t* rec;
+
+    while (n < max && ezcb_rec_peek(inst, &rec))
+    {
+        ezcb_entry_t* e = rec->hdr.handle;
+        void* data = rec + 1;
+        void** payloads = &data;
+        size_t count = 1;
+
+        ezcb_rec_take(inst);
+        n++;
+
+        if (group)
+        {
+            payloads = inst->batch_data;
+            payloads[0] = data;
+
+            while (n < max && count < EZCB_EVENT_QUEUE_SIZE &&
+                   ezcb_rec_peek(inst, &rec) && rec->hdr.handle == e)
+            {
+                payloads[count++] = rec + 1;
+                ezcb_rec_take(inst);
+                n++;
+            }
+        }
+
+        ezcb_shard_t* s = e->shard;
+        unsigned token = ezcb_read_lock(s);
+        inst->rec_depth++;
+        ezcb_entry_fire(e, payloads, count);
+        inst->rec_depth--;
+        ezcb_read_unlock(s, token);
+
+        ezcb_rec_release(inst);
+    }
+
+    /* Fillers taken after the last record */
+    ezcb_rec_release(inst);
+    return n;
+}
+
+void ezcb_dispatch_ex(
+    ezcb_ctx_t* inst
+)
+{
+    assert(inst != NULL);
+
+    const char* trigger;
+    ezcb_entry_t* handle;
+    void* data;
+
+    while (ezcb_evt_pop(inst, &trigger, &handle, &data))
+    {
+        ezcb_evt_run(inst, trigger, handle, data);
+    }
+
+    ezcb_rec_dispatch(inst, SIZE_MAX, false);
+}
+
+/* Run the first n scratch events grouped by trigger */
+static void ezcb_batch_fire(
+    ezcb_ctx_t* inst,
+    size_t n
+)
+{
+    /* Group by trigger through a small open-addressed index on the hash */
+    size_t groups = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ezcb_batch_evt_t* evt = &inst->batch_evts[i];
+        size_t slot = evt->hash & (EZCB_BATCH_INDEX_SIZE - 1);
+
+        evt->next = n;
+
+        for (;;)
+        {
+            size_t g = inst->batch_index[slot];
+
+            if (g == 0)
+            {
+                inst->batch_groups[groups] = (ezcb_batch_group_t){ i, i, slot, evt->handle };
+                inst->batch_index[slot] = ++groups;
+                break;
+            }
+
+            ezcb_batch_group_t* group = &inst->batch_groups[g - 1];
+            const ezcb_batch_evt_t* head = &inst->batch_evts[group->first];
+
+            /* Two handles of one name are one entry; only an event queued by name compares names */
+            bool same = group->handle && evt->handle ? group->handle == evt->handle :
+                        head->hash == evt->hash && head->len == evt->len &&
+                        (head->trigger == evt->trigger || ezcb_name_eq(head->trigger, evt->trigger, evt->len));
+            if (same)
+            {
+                inst->batch_evts[group->last].next = i;
+                group->last = i;
+                if (!group->handle) group->handle = evt->handle;
+                break;
+            }
+
+            slot = (slot + 1) & (EZCB_BATCH_INDEX_SIZE - 1);
+        }
+    }
+
+    for (size_t g = 0; g < groups; g++)
+    {
+        inst->batch_index[inst->batch_groups[g].slot] = 0;
+    }
+
+    /* Consecutive groups in the same shard keep its lock */
+    ezcb_shard_t* s = NULL;
+    unsigned token = 0;
+
+    for (size_t g = 0; g < groups; g++)
+    {
+        const ezcb_batch_evt_t* first = &inst->batch_evts[inst->batch_groups[g].first];
+
+        size_t count = 0;
+        for (size_t i = inst->batch_groups[g].first; i < n; i = inst->batch_evts[i].next)
+        {
+            inst->batch_data[count++] = inst->batch_evts[i].data;
+        }
+
+        ezcb_entry_t* e = inst->batch_groups[g].handle;
+        ezcb_shard_t* t = e ? e->shard : ezcb_shard_of(inst, first->hash);
+        if (t != s)
+        {
+            if (s) ezcb_read_unlock(s, token);
+            s = t;
+            token = ezcb_read_lock(s);
+        }
+
+        /* A handle's entry is pinned, so only groups queued by name alone are looked up */
+        if (!e) e = ezcb_entry_lookup(s, first->trigger, first->len, first->hash);
+        if (e) ezcb_entry_fire(e, inst->batch_data, count);
+#ifdef EZCB_ENABLE_PATTERNS
+        else ezcb_pattern_fire(s, first->trigger, inst->batch_data, count);
+#endif
+    }
+
+    ezcb_read_unlock(s, token);
+}
+
+size_t ezcb_dispatch_batch_ex(
+    ezcb_ctx_t* inst,
+    size_t max_events
+)
 {
-#ifdef EZCB_NO_MALLOC
-    char trigger[EZCB_MAX_TRIGGER_LENGTH];
-#else
-    char* trigger;
-#endif
-    uint8_t priority;
-    bool once;
-    ezcb_fn_t fn;
-    void* ctx;
-    ezcb_node_t* next;
-} ezcb_node_t;
+    assert(inst != NULL);
 
-#ifdef EZCB_ENABLE_ISR
-typedef struct ezcb_evt
+
+    if (max_events > EZCB_EVENT_QUEUE_SIZE) max_events = EZCB_EVENT_QUEUE_SIZE;
+
+    const char* trigger;
+    ezcb_entry_t* handle;
+    void* data;
+    size_t n = 0;
+
+    /* Called from a callback: the scratch space is in use, go one by one */
+    if (inst->batch_busy)
+    {
+        while (n < max_events && ezcb_evt_pop(inst, &trigger, &handle, &data))
+        {
+            ezcb_evt_run(inst, trigger, handle, data);
+            n++;
+        }
+        return n + ezcb_rec_dispatch(inst, max_events - n, false);
+    }
+
+    while (n < max_events && ezcb_evt_pop(inst, &trigger, &handle, &data))
+    {
+        ezcb_batch_evt_t* evt = &inst->batch_evts[n];
+
+        /* Events queued by handle join the group of their trigger's name, and spare it the lookup */
+        if (trigger)
+        {
+            size_t len;
+            evt->trigger = trigger;
+            evt->handle = NULL;
+            evt->hash = ezcb_hash_len(trigger, &len);
+            evt->len = (uint32_t) len;
+        }
+        else
+        {
+            evt->trigger = handle->trigger;
+            evt->handle = handle;
+            evt->hash = handle->hash;
+            evt->len = handle->len;
+        }
+        evt->data = data;
+        n++;
+    }
+
+    inst->batch_busy = true;
+
+    if (n > 0 && ezcb_ctx_ready(inst)) ezcb_batch_fire(inst, n);
+    n += ezcb_rec_dispatch(inst, max_events - n, true);
+
+    inst->batch_busy = false;
+    return n;
+}
+
+size_t ezcb_dispatch_budget_ex(
+    ezcb_ctx_t* inst,
+    size_t max_events,
+    uint32_t max_ticks
+)
 {
+    assert(inst != NULL);
+
+    uint32_t start = max_ticks ? (uint32_t) EZCB_TICKS() : 0;
     const char* trigger;
+    ezcb_entry_t* handle;
     void* data;
-} ezcb_evt_t;
+    size_t n = 0;
 
-static volatile uint8_t ezcb_evt_head;
-static volatile uint8_t ezcb_evt_tail;
-static ezcb_evt_t ezcb_evt_queue[EZCB_EVENT_QUEUE_SIZE];
-#endif  /* EZCB_ENABLE_ISR*/
+    while (n < max_events)
+    {
+        if (ezcb_evt_pop(inst, &trigger, &handle, &data))
+        {
+            ezcb_evt_run(inst, trigger, handle, data);
+        }
+        else if (ezcb_rec_dispatch(inst, 1, false) == 0)
+        {
+            break;
+        }
 
-#ifdef EZCB_THREAD_SAFE
-static mtx_t ezcb_mtx;
-#endif /* EZCB_THREAD_SAFE */
+        n++;
+
+        /* Unsigned difference, so the clock may wrap */
+        if (max_ticks && (uint32_t)((uint32_t) EZCB_TICKS() - start) >= max_ticks) break;
+    }
+
+    return n;
+}
+#endif /* EZCB_ENABLE_ISR */
 
 /****************************************************************
- * Hash table state
+ * Executor
  ****************************************************************/
+#ifdef EZCB_ENABLE_EXECUTOR
 
-static ezcb_node_t** ezcb_table   = NULL;
-static size_t ezcb_buckets = 0;
-static size_t ezcb_count   = 0;
+static bool ezcb_worker_push(
+    ezcb_worker_t* w,
+    const ezcb_task_t* task
+)
+{
+    mtx_lock(&w->mtx);
 
-#ifdef EZCB_NO_MALLOC
-static ezcb_node_t ezcb_nodes[EZCB_MAX_NODES];
-static ezcb_node_t* ezcb_free_list = NULL;
-static ezcb_node_t* ezcb_table_static[EZCB_MAX_BUCKETS];
-#endif  /* EZCB_NO_MALLOC */
+    size_t count = atomic_load_explicit(&w->count, memory_order_relaxed);
+    bool ok = count < EZCB_EXECUTOR_QUEUE_SIZE;
 
-/****************************************************************
- * Hash
- ****************************************************************/
+    if (ok)
+    {
+        w->tasks[(w->head + count) & (EZCB_EXECUTOR_QUEUE_SIZE - 1)] = *task;
+        atomic_store_explicit(&w->count, count + 1, memory_order_relaxed);
+    }
+
+    mtx_unlock(&w->mtx);
+    return ok;
+}
 
-static uint32_t ezcb_hash(const char* s)
+static bool ezcb_worker_pop(
+    ezcb_worker_t* w,
+    ezcb_task_t* task
+)
 {
-    const uint8_t* p = (const uint8_t*) s;
-    size_t len = strlen(s);
+    /* Cheap skip of empty rings while looking for work to steal */
+    if (atomic_load_explicit(&w->count, memory_order_relaxed) == 0) return false;
 
-    const uint32_t PRIME32_1 = 0x9E3779B1U;
-    const uint32_t PRIME32_2 = 0x85EBCA77U;
-    const uint32_t PRIME32_3 = 0xC2B2AE3DU;
-    const uint32_t PRIME32_4 = 0x27D4EB2FU;
-    const uint32_t PRIME32_5 = 0x165667B1U;
+    mtx_lock(&w->mtx);
 
-    uint32_t h32;
+    size_t count = atomic_load_explicit(&w->count, memory_order_relaxed);
+    bool ok = count > 0;
 
-    if (len >= 16)
+    if (ok)
+    {
+        *task = w->tasks[w->head];
+        w->head = (w->head + 1) & (EZCB_EXECUTOR_QUEUE_SIZE - 1);
+        atomic_store_explicit(&w->count, count - 1, memory_order_relaxed);
+    }
+
+    mtx_unlock(&w->mtx);
+    return ok;
+}
+
+static void ezcb_executor_done(
+    ezcb_executor_t* ex
+)
+{
+    if (atomic_fetch_sub(&ex->pending, 1) == 1)
+    {
+        mtx_lock(&ex->mtx);
+        cnd_broadcast(&ex->idle);
+        mtx_unlock(&ex->mtx);
+    }
+}
+
+static int ezcb_worker_main(
+    void* arg
+)
+{
+    ezcb_worker_t* self = (ezcb_worker_t*) arg;
+    ezcb_executor_t* ex = self->ex;
+
+    ezcb_exec_self = self;
+
+    for (;;)
     {
-        const uint8_t* const limit = p + len - 16;
-        uint32_t v1 = PRIME32_1 + PRIME32_2;
-        uint32_t v2 = PRIME32_2;
-        uint32_t v3 = 0;
-        uint32_t v4 = -PRIME32_1;
+        /* Own ring first, then steal from the ones after it */
+        ezcb_task_t task;
+        bool found = false;
+
+        for (size_t i = 0; i < ex->workers && !found; i++)
+        {
+            found = ezcb_worker_pop(&ex->worker[(self->index + i) % ex->workers], &task);
+        }
+
+        if (found)
+        {
+            atomic_fetch_sub(&ex->queued, 1);
+
+#ifdef EZCB_FANOUT
+            if (task.fanout)
+            {
+                ezcb_fanout_work(task.fanout);
+                ezcb_fanout_put(task.fanout);
+            }
+            else
+#endif
+            if (task.handle)
+            {
+#ifdef EZCB_ENABLE_COALESCING
+                ezcb_coalesce_t* c = &task.handle->coalesce;
+
+                /* Cleared before reading, so data stored after it is posted anew */
+                if (c->on && atomic_exchange_explicit(&c->post_pending, false, memory_order_acq_rel))
+                {
+                    task.data = atomic_load_explicit(&c->post_data, memory_order_relaxed);
+                }
+#endif
+                ezcb_trigger_h(task.handle, task.data);
+            }
+            else
+            {
+                ezcb_trigger_ex(ex->inst, task.trigger, task.data);
+            }
+
+            ezcb_executor_done(ex);
+            continue;
+        }
+
+        mtx_lock(&ex->mtx);
+        atomic_fetch_add(&ex->sleepers, 1);
 
-        do
+        while (atomic_load(&ex->queued) == 0 && !atomic_load(&ex->stopping))
         {
-            v1 += (*(const uint32_t*) p) * PRIME32_2;
-            v1 = (v1 << 13) | (v1 >> 19);
-            v1 *= PRIME32_1;
-            p += 4;
+            cnd_wait(&ex->wake, &ex->mtx);
+        }
+
+        atomic_fetch_sub(&ex->sleepers, 1);
+        bool stop = atomic_load(&ex->queued) == 0;
+        mtx_unlock(&ex->mtx);
 
-            v2 += (*(const uint32_t*) p) * PRIME32_2;
-            v2 = (v2 << 13) | (v2 >> 19);
-            v2 *= PRIME32_1;
-            p += 4;
+        if (stop) break;
 
-            v3 += (*(const uint32_t*) p) * PRIME32_2;
-            v3 = (v3 << 13) | (v3 >> 19);
-            v3 *= PRIME32_1;
-            p += 4;
+        /* A poster has counted a task but not pushed it yet */
+        thrd_yield();
+    }
 
-            v4 += (*(const uint32_t*) p) * PRIME32_2;
-            v4 = (v4 << 13) | (v4 >> 19);
-            v4 *= PRIME32_1;
-            p += 4;
+    ezcb_exec_self = NULL;
+    return 0;
+}
 
-        } while (p <= limit);
+static int ezcb_executor_post(
+    ezcb_executor_t* ex,
+    const ezcb_task_t* task
+)
+{
+    if (!ex || atomic_load(&ex->stopping)) return -1;
 
-        h32 = ((v1 << 1) | (v1 >> 31))
-            + ((v2 << 7) | (v2 >> 25))
-            + ((v3 << 12) | (v3 >> 20))
-            + ((v4 << 18) | (v4 >> 14));
+    /* Workers post to their own ring; other threads keep a home ring */
+    size_t home;
+    if (ezcb_exec_self && ezcb_exec_self->ex == ex)
+    {
+        home = ezcb_exec_self->index;
     }
     else
     {
-        h32 = PRIME32_5;
+        if (!ezcb_exec_home) ezcb_exec_home = atomic_fetch_add(&ezcb_exec_homes, 1) + 1;
+        home = ezcb_exec_home - 1;
     }
 
-    h32 += (uint32_t)len;
+    atomic_fetch_add(&ex->pending, 1);
+    atomic_fetch_add(&ex->queued, 1);
 
-    while ((p + 4) <= (const uint8_t*) s + len)
+    for (size_t i = 0; i < ex->workers; i++)
     {
-        h32 += (*(const uint32_t*) p) * PRIME32_3;
-        h32 = ((h32 << 17) | (h32 >> 15)) * PRIME32_4;
-        p += 4;
+        if (ezcb_worker_push(&ex->worker[(home + i) % ex->workers], task))
+        {
+            if (atomic_load(&ex->sleepers))
+            {
+                mtx_lock(&ex->mtx);
+                cnd_signal(&ex->wake);
+                mtx_unlock(&ex->mtx);
+            }
+            return 0;
+        }
     }
 
-    while (p < (const uint8_t*) s + len)
+    atomic_fetch_sub(&ex->queued, 1);
+    ezcb_executor_done(ex);
+    return -1;
+}
+
+int ezcb_executor_start_ex(
+    ezcb_ctx_t* inst,
+    size_t workers
+)
+{
+    assert(inst != NULL);
+    assert(workers > 0);
+
+    if (!inst->ready && ezcb_ctx_init(inst) != 0) return -1;
+    if (inst->executor) return -1;
+
+    ezcb_executor_t* ex = (ezcb_executor_t*) ezcb_zalloc(sizeof(ezcb_executor_t) + workers * sizeof(ezcb_worker_t));
+    if (!ex) return -1;
+
+    ex->inst = inst;
+    ex->workers = workers;
+    mtx_init(&ex->mtx, mtx_plain);
+    cnd_init(&ex->wake);
+    cnd_init(&ex->idle);
+#ifdef EZCB_FANOUT
+    cnd_init(&ex->joined);
+#endif
+    atomic_init(&ex->queued, 0);
+    atomic_init(&ex->pending, 0);
+    atomic_init(&ex->sleepers, 0);
+    atomic_init(&ex->stopping, false);
+
+    for (size_t i = 0; i < workers; i++)
     {
-        h32 += (*p) * PRIME32_5;
-        h32 = ((h32 << 11) | (h32 >> 21)) * PRIME32_1;
-        p++;
+        ex->worker[i].ex = ex;
+        ex->worker[i].index = i;
+        atomic_init(&ex->worker[i].count, 0);
+        mtx_init(&ex->worker[i].mtx, mtx_plain);
     }
 
-    h32 ^= h32 >> 15;
-    h32 *= PRIME32_2;
-    h32 ^= h32 >> 13;
-    h32 *= PRIME32_3;
-    h32 ^= h32 >> 16;
+    size_t started = 0;
+    while (started < workers &&
+           thrd_create(&ex->worker[started].thread, ezcb_worker_main, &ex->worker[started]) == thrd_success)
+    {
+        started++;
+    }
 
-    return h32;
-}
+    inst->executor = ex;
 
-/****************************************************************
- * Mutex helpers
- ****************************************************************/
+    if (started < workers)
+    {
+        /* Only the started workers are joined */
+        ex->workers = started;
+        ezcb_executor_stop_ex(inst);
+        return -1;
+    }
+    return 0;
+}
 
-static inline void ezcb_lock(void)
+void ezcb_executor_stop_ex(
+    ezcb_ctx_t* inst
+)
 {
-    EZCB_MUTEX_LOCK(ezcb_mtx);
+    assert(inst != NULL);
+
+    ezcb_executor_t* ex = inst->executor;
+    if (!ex) return;
+
+    assert(ezcb_exec_self == NULL || ezcb_exec_self->ex != ex);
+
+    mtx_lock(&ex->mtx);
+    atomic_store(&ex->stopping, true);
+    cnd_broadcast(&ex->wake);
+    mtx_unlock(&ex->mtx);
+
+    for (size_t i = 0; i < ex->workers; i++)
+    {
+        thrd_join(ex->worker[i].thread, NULL);
+    }
+
+    inst->executor = NULL;
+
+    for (size_t i = 0; i < ex->workers; i++)
+    {
+        mtx_destroy(&ex->worker[i].mtx);
+    }
+#ifdef EZCB_FANOUT
+    while (ex->groups)
+    {
+        ezcb_fanout_t* f = ex->groups;
+        ex->groups = f->free_next;
+        EZCB_FREE(f);
+    }
+    cnd_destroy(&ex->joined);
+#endif
+    cnd_destroy(&ex->idle);
+    cnd_destroy(&ex->wake);
+    mtx_destroy(&ex->mtx);
+    EZCB_FREE(ex);
 }
 
-static inline void ezcb_unlock(void)
+void ezcb_executor_wait_ex(
+    ezcb_ctx_t* inst
+)
 {
-    EZCB_MUTEX_UNLOCK(ezcb_mtx);
+    assert(inst != NULL);
+
+    ezcb_executor_t* ex = inst->executor;
+    if (!ex) return;
+
+    assert(ezcb_exec_self == NULL || ezcb_exec_self->ex != ex);
+
+    mtx_lock(&ex->mtx);
+    while (atomic_load(&ex->pending) != 0)
+    {
+        cnd_wait(&ex->idle, &ex->mtx);
+    }
+    mtx_unlock(&ex->mtx);
 }
 
-/****************************************************************
- * Allocation
- ****************************************************************/
+int ezcb_post_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    void* data
+)
+{
+    assert(inst != NULL);
+    assert(trigger != NULL);
+
+    ezcb_task_t task = { trigger, NULL, data, NULL };
+    return ezcb_executor_post(inst->executor, &task);
+}
 
-static ezcb_node_t* ezcb_node_alloc(void)
+int ezcb_post_h(
+    ezcb_handle_t handle,
+    void* data
+)
 {
-#ifdef EZCB_NO_MALLOC
-    if (!ezcb_free_list)
+    assert(handle != NULL);
+
+    ezcb_task_t task = { NULL, handle, data, NULL };
+    ezcb_executor_t* ex = handle->shard->inst->executor;
+
+#ifdef EZCB_ENABLE_COALESCING
+    ezcb_coalesce_t* c = &handle->coalesce;
+
+    if (c->on)
     {
-        ezcb_unlock();
-        return NULL;
+        atomic_store_explicit(&c->post_data, data, memory_order_relaxed);
+        if (atomic_exchange_explicit(&c->post_pending, true, memory_order_acq_rel)) return 0;
+
+        if (ezcb_executor_post(ex, &task) != 0)
+        {
+            atomic_store_explicit(&c->post_pending, false, memory_order_release);
+            return -1;
+        }
+        return 0;
     }
-    
-    ezcb_node_t* n = ezcb_free_list;
-    ezcb_free_list = n->next;
-    
-    return n;
-#else
-    return (ezcb_node_t*) malloc(sizeof(ezcb_node_t));
 #endif
+
+    return ezcb_executor_post(ex, &task);
 }
 
-static void ezcb_node_free(
-    ezcb_node_t *n
+#ifdef EZCB_FANOUT
+int ezcb_register_parallel_ex(
+    ezcb_ctx_t* inst,
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool join
 )
 {
-#ifdef EZCB_NO_MALLOC
-    ezcb_lock();
-    
-    n->next = ezcb_free_list;
-    ezcb_free_list = n;
-    
-    ezcb_unlock();
-#else
-    free(n->trigger);
-    n->trigger = NULL;
-    free(n);
-#endif
+    return ezcb_register_internal(inst, trigger, priority, fn, ctx,
+                                  (uint8_t)(EZCB_CB_PARALLEL | (join ? 0 : EZCB_CB_DETACHED)));
 }
+#endif
+
+#endif /* EZCB_ENABLE_EXECUTOR */
 
 /****************************************************************
- * Resize
+ * Statistics
  ****************************************************************/
+#ifdef EZCB_ENABLE_STATS
 
-#ifndef EZCB_NO_MALLOC
-static int ezcb_resize(
-    size_t new_size
+static void ezcb_stats_read(
+    const ezcb_entry_t* e,
+    ezcb_trigger_stats_t* out
 )
 {
-    ezcb_node_t** new_table = calloc(new_size, sizeof(*new_table));
-    if (!new_table) return -1;
+    out->fires = EZCB_STAT_GET(e->stats.fires);
+    out->invocations = EZCB_STAT_GET(e->stats.invocations);
+    out->chain_max = EZCB_STAT_GET(e->stats.chain_max);
+    out->chain_total = EZCB_STAT_GET(e->stats.chain_total);
+}
+
+#ifdef EZCB_OPEN_ADDRESSING
+/* Longest probe sequence, in slots, among slots from `first` on */
+static uint32_t ezcb_probe_longest(
+    const ezcb_table_t* table,
+    size_t first
+)
+{
+    size_t mask = table->capacity - 1;
+    uint32_t longest = 0;
 
-    for (size_t i = 0; i < ezcb_buckets; i++)
+    for (size_t i = first; i < table->capacity; i++)
     {
-        ezcb_node_t* n = ezcb_table[i];
-        while (n)
+        if (table->ctrl[i] & EZCB_CTRL_EMPTY) continue;
+
+        uint32_t length = (uint32_t)((i - table->entries[i]->hash) & mask) + 1;
+        if (length > longest) longest = length;
+    }
+    return longest;
+}
+#else
+static uint32_t ezcb_chain_longest(
+    ezcb_slot_t* table,
+    size_t buckets
+)
+{
+    uint32_t longest = 0;
+
+    for (size_t j = 0; j < buckets; j++)
+    {
+        uint32_t length = 0;
+
+        for (ezcb_entry_t* e = EZCB_LOAD(table[j]); e; e = EZCB_LOAD(e->next))
         {
-            ezcb_node_t* next = n->next;
-            uint32_t idx = ezcb_hash(n->trigger) % new_size;
-            n->next = new_table[idx];
-            new_table[idx] = n;
-            n = next;
+            length++;
         }
-    }
 
-    free(ezcb_table);
-    ezcb_table = new_table;
-    ezcb_buckets = new_size;
-    return 0;
+        if (length > longest) longest = length;
+    }
+    return longest;
 }
+#endif  /* EZCB_OPEN_ADDRESSING */
+
+/* Longest bucket chain, or longest probe sequence in slots; call with the shard mutex held */
+static uint32_t ezcb_table_longest(
+    ezcb_shard_t* s
+)
+{
+#ifdef EZCB_OPEN_ADDRESSING
+    uint32_t longest = ezcb_probe_longest(EZCB_LOAD(s->table), 0);
+#else
+    uint32_t longest = ezcb_chain_longest(EZCB_LOAD(s->table), EZCB_LOAD(s->buckets));
 #endif
 
-/****************************************************************
- * Initialize
- ****************************************************************/
+#ifdef EZCB_REHASH
+    /* Entries still in the old table are looked up there */
+    if (EZCB_LOAD(s->old_table))
+    {
+#ifdef EZCB_OPEN_ADDRESSING
+        uint32_t old = ezcb_probe_longest(s->old_table, s->rehash_pos);
+#else
+        uint32_t old = ezcb_chain_longest(EZCB_LOAD(s->old_table), EZCB_LOAD(s->old_buckets));
+#endif
+        if (old > longest) longest = old;
+    }
+#endif
+    return longest;
+}
 
-void ezcb_init(void)
+void ezcb_stats_get_ex(
+    ezcb_ctx_t* inst,
+    ezcb_stats_t* out
+)
 {
-    if (ezcb_table) return;
-    
-    EZCB_MUTEX_INIT(ezcb_mtx);
-    
-#ifdef EZCB_NO_MALLOC
-    ezcb_buckets = EZCB_MAX_BUCKETS;
-    ezcb_table = ezcb_table_static;
-    memset(ezcb_table, 0, sizeof(ezcb_table_static));
+    assert(inst != NULL);
+    assert(out != NULL);
+
+    memset(out, 0, sizeof(*out));
+
+#ifdef EZCB_ENABLE_ISR
+    out->queue_high_water = atomic_load_explicit(&inst->evt_high_water, memory_order_relaxed);
+    out->queue_drops = atomic_load_explicit(&inst->evt_drops, memory_order_relaxed);
+#endif
 
-    ezcb_lock();
-    
-    ezcb_free_list = NULL;
-    for (size_t i = 0; i < EZCB_MAX_NODES; i++)
+    if (!inst->ready) return;
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
     {
-        ezcb_nodes[i].next = ezcb_free_list;
-        ezcb_free_list = &ezcb_nodes[i];
-    }
-    
-    ezcb_unlock();
-    
-#else
-    ezcb_buckets = 16;
-    ezcb_table = calloc(ezcb_buckets, sizeof(*ezcb_table));
+        ezcb_shard_t* s = &inst->shards[i];
+
+        ezcb_lock(s);
+
+        ezcb_iter_t it = { 0, NULL };
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            ezcb_trigger_stats_t ts;
+            ezcb_stats_read(e, &ts);
+
+            out->triggers++;
+            out->callbacks += (uint32_t) e->count;
+#ifdef EZCB_STATIC_HANDLERS
+            out->callbacks += (uint32_t) e->nstatics;
 #endif
-    ezcb_count = 0;
+            out->fires += ts.fires;
+            out->invocations += ts.invocations;
+            out->chain_total += ts.chain_total;
+            if (ts.chain_max > out->chain_max) out->chain_max = ts.chain_max;
+        }
+
+        uint32_t longest = ezcb_table_longest(s);
+        if (longest > out->bucket_max) out->bucket_max = longest;
+        out->resizes += s->resizes;
+
+        ezcb_unlock(s);
+    }
 }
 
-/****************************************************************
- * Deinitialize
- ****************************************************************/
+void ezcb_stats_foreach_ex(
+    ezcb_ctx_t* inst,
+    ezcb_stats_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+    assert(fn != NULL);
 
-void ezcb_deinit(void)
+    if (!inst->ready) return;
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
+    {
+        ezcb_shard_t* s = &inst->shards[i];
+
+        ezcb_lock(s);
+
+        ezcb_iter_t it = { 0, NULL };
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
+        {
+            ezcb_trigger_stats_t ts;
+            ezcb_stats_read(e, &ts);
+            fn(ctx, e->trigger, &ts);
+        }
+
+        ezcb_unlock(s);
+    }
+}
+
+void ezcb_stats_reset_ex(
+    ezcb_ctx_t* inst
+)
 {
-    if (!ezcb_table)
+    assert(inst != NULL);
+
+#ifdef EZCB_ENABLE_ISR
+    atomic_store_explicit(&inst->evt_high_water, 0, memory_order_relaxed);
+    atomic_store_explicit(&inst->evt_drops, 0, memory_order_relaxed);
+#ifdef EZCB_ENABLE_LATENCY
+    atomic_store_explicit(&inst->evt_wait_max, 0, memory_order_relaxed);
+    for (size_t i = 0; i < EZCB_LATENCY_BUCKETS; i++)
     {
-        EZCB_MUTEX_DESTROY(ezcb_mtx);
-        return;
+        atomic_store_explicit(&inst->evt_wait[i], 0, memory_order_relaxed);
     }
+#endif
+#endif
+
+    if (!inst->ready) return;
 
-    ezcb_lock();
-    
-    for (size_t i = 0; i < ezcb_buckets; i++)
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
     {
-        ezcb_node_t* n = ezcb_table[i];
-        while (n)
+        ezcb_shard_t* s = &inst->shards[i];
+
+        ezcb_lock(s);
+
+        ezcb_iter_t it = { 0, NULL };
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
         {
-            ezcb_node_t* next = n->next;
-#ifdef EZCB_NO_MALLOC
-            n->next = ezcb_free_list;
-            ezcb_free_list = n;
-#else
-            free(n);
-#endif
-            n = next;
+            ezcb_entry_stats_clear(e);
         }
-        ezcb_table[i] = NULL;
+
+        s->resizes = 0;
+
+        ezcb_unlock(s);
     }
+}
 
-#ifndef EZCB_NO_MALLOC
-    free(ezcb_table);
-#endif  /* EZCB_NO_MALLOC */
+void ezcb_set_hooks_ex(
+    ezcb_ctx_t* inst,
+    ezcb_hook_fn_t pre,
+    ezcb_hook_fn_t post,
+    void* ctx
+)
+{
+    assert(inst != NULL);
 
-    ezcb_table   = NULL;
-    ezcb_buckets = 0;
-    ezcb_count   = 0;
+    inst->hook_pre = pre;
+    inst->hook_post = post;
+    inst->hook_ctx = ctx;
+}
 
-#ifdef EZCB_ENABLE_ISR
-    ezcb_evt_head = 0;
-    ezcb_evt_tail = 0;
-#endif  /* EZCB_ENABLE_ISR */
+#ifdef EZCB_ENABLE_LATENCY
+void ezcb_latency_add(
+    ezcb_latency_t* h,
+    uint32_t ticks
+)
+{
+    assert(h != NULL);
 
-    ezcb_unlock();
-    EZCB_MUTEX_DESTROY(ezcb_mtx);
+    h->count++;
+    h->buckets[ezcb_latency_bucket(ticks)]++;
+    if (ticks > h->max) h->max = ticks;
 }
 
-/****************************************************************
- * Register
- ****************************************************************/
+uint32_t ezcb_latency_bound(
+    size_t bucket
+)
+{
+    assert(bucket < EZCB_LATENCY_BUCKETS);
 
-static int ezcb_register_internal(
-    const char* trigger,
-    uint8_t priority,
-    ezcb_fn_t fn,
-    void* ctx,
-    bool once
+    if (bucket < (1u << EZCB_LATENCY_PRECISION)) return (uint32_t) bucket;
+
+    unsigned top = (unsigned)(bucket >> EZCB_LATENCY_PRECISION) + EZCB_LATENCY_PRECISION - 1;
+    uint32_t sub = (uint32_t)(bucket & ((1u << EZCB_LATENCY_PRECISION) - 1));
+    return (1u << top) | (sub << (top - EZCB_LATENCY_PRECISION));
+}
+
+uint32_t ezcb_latency_percentile(
+    const ezcb_latency_t* h,
+    double q
 )
 {
-    assert(trigger != NULL);
-    assert(fn != NULL);
-    
-	ezcb_lock();
-	
-    if (!ezcb_table)
+    assert(h != NULL);
+
+    if (h->count == 0) return 0;
+
+    /* Rank of the sample sought, 1-based and rounded up */
+    double want = (q < 0.0 ? 0.0 : q > 1.0 ? 1.0 : q) * h->count;
+    uint32_t rank = (uint32_t) want;
+    if (rank < want) rank++;
+    if (rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for (size_t b = 0; b < EZCB_LATENCY_BUCKETS; b++)
     {
-        ezcb_init();
+        seen += h->buckets[b];
+        if (seen < rank) continue;
+
+        uint32_t high = b + 1 < EZCB_LATENCY_BUCKETS ? ezcb_latency_bound(b + 1) - 1 : UINT32_MAX;
+        return high < h->max ? high : h->max;
     }
+    return h->max;
+}
 
-#ifdef EZCB_NO_MALLOC
-    size_t trigger_length = strlen(trigger);
-    
-    if (trigger_length >= EZCB_MAX_TRIGGER_LENGTH)
-	{
-		ezcb_unlock();
-		return -1;
-	}
-#else
-    
-    if (ezcb_count * 4 >= ezcb_buckets * 3)
+void ezcb_latency_foreach_ex(
+    ezcb_ctx_t* inst,
+    ezcb_latency_fn_t fn,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+    assert(fn != NULL);
+
+    if (!inst->ready) return;
+
+    for (size_t i = 0; i < EZCB_SHARDS; i++)
     {
-        if (ezcb_resize(ezcb_buckets * 2) != 0)
+        ezcb_shard_t* s = &inst->shards[i];
+
+        ezcb_lock(s);
+
+        ezcb_iter_t it = { 0, NULL };
+        for (ezcb_entry_t* e; (e = ezcb_iter_next(s, &it)) != NULL;)
         {
-            ezcb_unlock();
-            return -1;
+            ezcb_latency_t h;
+
+            h.count = 0;
+            h.max = EZCB_STAT_GET(e->stats.latency_max);
+            for (size_t b = 0; b < EZCB_LATENCY_BUCKETS; b++)
+            {
+                h.buckets[b] = EZCB_STAT_GET(e->stats.latency[b]);
+                h.count += h.buckets[b];
+            }
+
+            if (h.count) fn(ctx, e->trigger, &h);
         }
-    }
-	
-#endif
 
-    ezcb_node_t* node = ezcb_node_alloc();
-    if (!node)
-	{
-		ezcb_unlock();
-		return -1;
-	}
+        ezcb_unlock(s);
+    }
+}
 
-#ifdef EZCB_NO_MALLOC
-    strncpy(node->trigger, trigger, trigger_length);
-    node->trigger[trigger_length] = '\0';
-#else
-    node->trigger = strdup(trigger);
-#endif
-    node->priority = priority;
-    node->once = once;
-    node->fn = fn;
-    node->ctx = ctx;
-    
-    uint32_t idx = ezcb_hash(trigger) % ezcb_buckets;
-    ezcb_node_t** cur = &ezcb_table[idx];
+#ifdef EZCB_ENABLE_ISR
+void ezcb_latency_queue_ex(
+    ezcb_ctx_t* inst,
+    ezcb_latency_t* out
+)
+{
+    assert(inst != NULL);
+    assert(out != NULL);
 
-    while (*cur)
+    out->count = 0;
+    out->max = atomic_load_explicit(&inst->evt_wait_max, memory_order_relaxed);
+    for (size_t b = 0; b < EZCB_LATENCY_BUCKETS; b++)
     {
-        if (strcmp((*cur)->trigger, trigger) == 0 && (*cur)->priority < priority)
-        {
-            break;
-        }
-        cur = &(*cur)->next;
+        out->buckets[b] = atomic_load_explicit(&inst->evt_wait[b], memory_order_relaxed);
+        out->count += out->buckets[b];
     }
+}
+#endif  /* EZCB_ENABLE_ISR */
 
-    node->next = *cur;
-    *cur = node;
-    ezcb_count++;
-    
-    ezcb_unlock();
-    return 0;
+void ezcb_set_callback_hook_ex(
+    ezcb_ctx_t* inst,
+    ezcb_cb_hook_fn_t hook,
+    void* ctx
+)
+{
+    assert(inst != NULL);
+
+    inst->cb_hook = hook;
+    inst->cb_hook_ctx = ctx;
+}
+#endif  /* EZCB_ENABLE_LATENCY */
+
+#endif /* EZCB_ENABLE_STATS */
+
+/****************************************************************
+ * Default instance
+ ****************************************************************/
+
+ezcb_handle_t ezcb_resolve(
+    const char* trigger
+)
+{
+    return ezcb_resolve_ex(&ezcb_default, trigger);
 }
 
 int ezcb_register(
@@ -635,7 +9352,7 @@ int ezcb_register(
     void* ctx
 )
 {
-    return ezcb_register_internal(trigger, priority, fn, ctx, false);
+    return ezcb_register_ex(&ezcb_default, trigger, priority, fn, ctx);
 }
 
 int ezcb_register_once(
@@ -645,12 +9362,18 @@ int ezcb_register_once(
     void* ctx
 )
 {
-    return ezcb_register_internal(trigger, priority, fn, ctx, true);
+    return ezcb_register_once_ex(&ezcb_default, trigger, priority, fn, ctx);
 }
 
-/****************************************************************
- * Unregister
- ****************************************************************/
+int ezcb_register_batch(
+    const char* trigger,
+    uint8_t priority,
+    ezcb_batch_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_batch_ex(&ezcb_default, trigger, priority, fn, ctx);
+}
 
 int ezcb_unregister(
     const char* trigger,
@@ -658,158 +9381,257 @@ int ezcb_unregister(
     void* ctx
 )
 {
-    ezcb_lock();
-	
-    if (!ezcb_table)
-	{
-		ezcb_unlock();
-		return 0;
-	}
+    return ezcb_unregister_ex(&ezcb_default, trigger, fn, ctx);
+}
 
-    int removed = 0;
+int ezcb_unregister_batch(
+    const char* trigger,
+    ezcb_batch_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_unregister_batch_ex(&ezcb_default, trigger, fn, ctx);
+}
 
-    if (trigger)
-    {
-        uint32_t idx = ezcb_hash(trigger) % ezcb_buckets;
-        ezcb_node_t** cur = &ezcb_table[idx];
+int ezcb_register_many(
+    const ezcb_reg_t* regs,
+    size_t n
+)
+{
+    return ezcb_register_many_ex(&ezcb_default, regs, n);
+}
 
-        while (*cur)
-        {
-            ezcb_node_t* n = *cur;
+int ezcb_unregister_many(
+    const ezcb_reg_t* regs,
+    size_t n
+)
+{
+    return ezcb_unregister_many_ex(&ezcb_default, regs, n);
+}
 
-            if (strcmp(n->trigger, trigger) == 0 &&
-                (fn  == NULL || n->fn  == fn) &&
-                (ctx == NULL || n->ctx == ctx))
-            {
-                *cur = n->next;
-                ezcb_node_free(n);
-                ezcb_count--;
-                removed++;
-                continue;
-            }
+size_t ezcb_snapshot(
+    void* buf,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    return ezcb_snapshot_ex(&ezcb_default, buf, size, symbols, nsymbols);
+}
 
-            cur = &(*cur)->next;
-        }
+int ezcb_restore(
+    const void* blob,
+    size_t size,
+    const ezcb_symbol_t* symbols,
+    size_t nsymbols
+)
+{
+    return ezcb_restore_ex(&ezcb_default, blob, size, symbols, nsymbols);
+}
 
-        ezcb_unlock();
-        return removed;
-    }
+void ezcb_trigger(
+    const char* trigger,
+    void* data
+)
+{
+    ezcb_trigger_ex(&ezcb_default, trigger, data);
+}
 
-    for (size_t i = 0; i < ezcb_buckets; i++)
-    {
-        ezcb_node_t** cur = &ezcb_table[i];
+void ezcb_trigger_hashed(
+    const char* trigger,
+    size_t length,
+    uint32_t hash,
+    void* data
+)
+{
+    ezcb_trigger_hashed_ex(&ezcb_default, trigger, length, hash, data);
+}
 
-        while (*cur)
-        {
-            ezcb_node_t* n = *cur;
+void ezcb_synchronize(void)
+{
+    ezcb_synchronize_ex(&ezcb_default);
+}
 
-            if ((fn  == NULL || n->fn  == fn) &&
-                (ctx == NULL || n->ctx == ctx))
-            {
-                *cur = n->next;
-                ezcb_node_free(n);
-                ezcb_count--;
-                removed++;
-                continue;
-            }
+int ezcb_reserve(
+    size_t triggers
+)
+{
+    return ezcb_reserve_ex(&ezcb_default, triggers);
+}
 
-            cur = &(*cur)->next;
-        }
-    }
+void ezcb_compact(void)
+{
+    ezcb_compact_ex(&ezcb_default);
+}
 
-    ezcb_unlock();
-    return removed;
+#ifdef EZCB_ENABLE_ISR
+int ezcb_trigger_isr(
+    const char* trigger,
+    void* data
+)
+{
+    return ezcb_trigger_isr_ex(&ezcb_default, trigger, data);
 }
 
+int ezcb_trigger_isr_prio(
+    const char* trigger,
+    void* data,
+    uint8_t priority
+)
+{
+    return ezcb_trigger_isr_prio_ex(&ezcb_default, trigger, data, priority);
+}
 
-/****************************************************************
- * Trigger
- ****************************************************************/
+void ezcb_dispatch(void)
+{
+    ezcb_dispatch_ex(&ezcb_default);
+}
 
-void ezcb_trigger(
-    const char* trigger,
-    void* data
+size_t ezcb_dispatch_batch(
+    size_t max_events
 )
 {
-    assert(trigger != NULL);
-    
-	ezcb_lock();
-	
-    if (!ezcb_table)
-	{
-		ezcb_unlock();
-		return;
-	}
-
-    uint32_t idx = ezcb_hash(trigger) % ezcb_buckets;
-    ezcb_node_t** cur = &ezcb_table[idx];
+    return ezcb_dispatch_batch_ex(&ezcb_default, max_events);
+}
 
-    while (*cur)
-    {
-        ezcb_node_t* n = *cur;
+size_t ezcb_dispatch_budget(
+    size_t max_events,
+    uint32_t max_ticks
+)
+{
+    return ezcb_dispatch_budget_ex(&ezcb_default, max_events, max_ticks);
+}
+#endif  /* EZCB_ENABLE_ISR */
 
-        if (strcmp(n->trigger, trigger) == 0)
-        {
-            ezcb_result_t r = n->fn(n->ctx, data);
+#ifdef EZCB_ENABLE_EXECUTOR
+int ezcb_executor_start(
+    size_t workers
+)
+{
+    return ezcb_executor_start_ex(&ezcb_default, workers);
+}
 
-            if (n->once)
-            {
-                *cur = n->next;
-#ifdef EZCB_NO_MALLOC
-                n->next = ezcb_free_list;
-                ezcb_free_list = n;
-#else
-                free(n->trigger);
-                free(n);
-#endif
-                ezcb_count--;
-                if (r == EZCB_STOP) break;
-                continue; 
-            }
+void ezcb_executor_stop(void)
+{
+    ezcb_executor_stop_ex(&ezcb_default);
+}
 
-            if (r == EZCB_STOP) break;
-        }
+void ezcb_executor_wait(void)
+{
+    ezcb_executor_wait_ex(&ezcb_default);
+}
 
-        cur = &(*cur)->next;
-    }
+int ezcb_post(
+    const char* trigger,
+    void* data
+)
+{
+    return ezcb_post_ex(&ezcb_default, trigger, data);
+}
 
-    ezcb_unlock();
+#ifdef EZCB_FANOUT
+int ezcb_register_parallel(
+    const char* trigger,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx,
+    bool join
+)
+{
+    return ezcb_register_parallel_ex(&ezcb_default, trigger, priority, fn, ctx, join);
 }
+#endif
+#endif  /* EZCB_ENABLE_EXECUTOR */
 
+#ifdef EZCB_ENABLE_PATTERNS
+int ezcb_register_pattern(
+    const char* pattern,
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_register_pattern_ex(&ezcb_default, pattern, priority, fn, ctx);
+}
 
-/****************************************************************
- * ISR support
- ****************************************************************/
-#ifdef EZCB_ENABLE_ISR
+int ezcb_unregister_pattern(
+    const char* pattern,
+    ezcb_fn_t fn,
+    void* ctx
+)
+{
+    return ezcb_unregister_pattern_ex(&ezcb_default, pattern, fn, ctx);
+}
+#endif  /* EZCB_ENABLE_PATTERNS */
 
-int ezcb_trigger_isr(
+#ifdef EZCB_ENABLE_REVERSE_INDEX
+ezcb_token_t ezcb_register_token(
     const char* trigger,
-    void* data
+    uint8_t priority,
+    ezcb_fn_t fn,
+    void* ctx
 )
 {
-    assert(trigger != NULL);
-    
-    uint8_t next = (ezcb_evt_head + 1) % EZCB_EVENT_QUEUE_SIZE;
+    return ezcb_register_token_ex(&ezcb_default, trigger, priority, fn, ctx);
+}
+#endif  /* EZCB_ENABLE_REVERSE_INDEX */
 
-    if (next == ezcb_evt_tail) return -1;
+#ifdef EZCB_ENABLE_STATS
+void ezcb_stats_get(
+    ezcb_stats_t* out
+)
+{
+    ezcb_stats_get_ex(&ezcb_default, out);
+}
 
-    ezcb_evt_queue[ezcb_evt_head].trigger = trigger;
-    ezcb_evt_queue[ezcb_evt_head].data = data;
-    ezcb_evt_head = next;
-    return 0;
+void ezcb_stats_foreach(
+    ezcb_stats_fn_t fn,
+    void* ctx
+)
+{
+    ezcb_stats_foreach_ex(&ezcb_default, fn, ctx);
 }
 
-void ezcb_dispatch(void)
+void ezcb_stats_reset(void)
 {
-    while (ezcb_evt_tail != ezcb_evt_head)
-    {
-        ezcb_evt_t evt = ezcb_evt_queue[ezcb_evt_tail];
-        ezcb_evt_tail = (ezcb_evt_tail + 1) % EZCB_EVENT_QUEUE_SIZE;
+    ezcb_stats_reset_ex(&ezcb_default);
+}
 
-        ezcb_trigger(evt.trigger, evt.data);
-    }
+void ezcb_set_hooks(
+    ezcb_hook_fn_t pre,
+    ezcb_hook_fn_t post,
+    void* ctx
+)
+{
+    ezcb_set_hooks_ex(&ezcb_default, pre, post, ctx);
 }
 
-#endif /* EZCB_ENABLE_ISR */
+#ifdef EZCB_ENABLE_LATENCY
+void ezcb_latency_foreach(
+    ezcb_latency_fn_t fn,
+    void* ctx
+)
+{
+    ezcb_latency_foreach_ex(&ezcb_default, fn, ctx);
+}
+
+#ifdef EZCB_ENABLE_ISR
+void ezcb_latency_queue(
+    ezcb_latency_t* out
+)
+{
+    ezcb_latency_queue_ex(&ezcb_default, out);
+}
+#endif
+
+void ezcb_set_callback_hook(
+    ezcb_cb_hook_fn_t hook,
+    void* ctx
+)
+{
+    ezcb_set_callback_hook_ex(&ezcb_default, hook, ctx);
+}
+#endif  /* EZCB_ENABLE_LATENCY */
+#endif  /* EZCB_ENABLE_STATS */
 
 #endif /* EZCB_IMPLEMENTATION */